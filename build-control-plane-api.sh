@@ -9,5 +9,6 @@ bazel build //api/meta_protocol_proxy/v1alpha:pkg_go_proto
 bazel build //api/meta_protocol_proxy/admin/v1alpha:pkg_go_proto
 bazel build //api/meta_protocol_proxy/filters/router/v1alpha:pkg_go_proto
 bazel build //api/meta_protocol_proxy/filters/local_ratelimit/v1alpha:pkg_go_proto
+bazel build //api/meta_protocol_proxy/filters/adaptive_concurrency/v1alpha:pkg_go_proto
 bazel build //api/meta_protocol_proxy/filters/global_ratelimit/v1alpha:pkg_go_proto
 bazel build //api/meta_protocol_proxy/config/route/v1alpha:pkg_go_proto
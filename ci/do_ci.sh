@@ -199,6 +199,7 @@ case $CI_TARGET in
 	bazel build "${BAZEL_BUILD_OPTIONS[@]}" -c fastbuild //api/meta_protocol_proxy/admin/v1alpha:pkg_go_proto && \
 	bazel build "${BAZEL_BUILD_OPTIONS[@]}" -c fastbuild //api/meta_protocol_proxy/filters/router/v1alpha:pkg_go_proto && \
 	bazel build "${BAZEL_BUILD_OPTIONS[@]}" -c fastbuild //api/meta_protocol_proxy/filters/local_ratelimit/v1alpha:pkg_go_proto && \
+	bazel build "${BAZEL_BUILD_OPTIONS[@]}" -c fastbuild //api/meta_protocol_proxy/filters/adaptive_concurrency/v1alpha:pkg_go_proto && \
 	bazel build "${BAZEL_BUILD_OPTIONS[@]}" -c fastbuild //api/meta_protocol_proxy/filters/global_ratelimit/v1alpha:pkg_go_proto && \
 	bazel build "${BAZEL_BUILD_OPTIONS[@]}" -c fastbuild //api/meta_protocol_proxy/filters/metadata_exchange/v1alpha:pkg_go_proto && \
 	bazel build "${BAZEL_BUILD_OPTIONS[@]}" -c fastbuild //api/meta_protocol_proxy/filters/istio_stats/v1alpha:pkg_go_proto && \
@@ -13,19 +13,35 @@ namespace NetworkFilters {
 namespace MetaProtocolProxy {
 namespace Brpc {
 
-MetaProtocolProxy::DecodeStatus BrpcCodec::decode(Buffer::Instance& buffer,
-                                                  MetaProtocolProxy::Metadata& metadata) {
+MetaProtocolProxy::DecodeStatus BrpcDecoder::decode(Buffer::Instance& buffer,
+                                                    MetaProtocolProxy::Metadata& metadata) {
   ENVOY_LOG(debug, "Brpc decoder: {} bytes available, msg type: {}", buffer.length(),
             static_cast<int>(metadata.getMessageType()));
   messageType_ = metadata.getMessageType();
   ASSERT(messageType_ == MetaProtocolProxy::MessageType::Request ||
          messageType_ == MetaProtocolProxy::MessageType::Response);
 
+  // Wait until the whole message is buffered, so the header and the body are decoded in one pass
+  switch (BrpcFramer::check(buffer)) {
+  case BrpcFramer::Status::WaitForData:
+    ENVOY_LOG(debug, "continue {}", buffer.length());
+    return DecodeStatus::WaitForData;
+  case BrpcFramer::Status::Invalid:
+    onDecodeError("brpc header invalid");
+    return DecodeStatus::Error;
+  case BrpcFramer::Status::Complete:
+    break;
+  }
+
   while (decode_status != BrpcDecodeStatus::DecodeDone) {
     decode_status = handleState(buffer);
     if (decode_status == BrpcDecodeStatus::WaitForData) {
       return DecodeStatus::WaitForData;
     }
+    if (decode_status == BrpcDecodeStatus::DecodeError) {
+      decode_status = BrpcDecodeStatus::DecodeHeader;
+      return DecodeStatus::Error;
+    }
   }
 
   // fill the metadata with the headers exacted from the message
@@ -35,8 +51,8 @@ MetaProtocolProxy::DecodeStatus BrpcCodec::decode(Buffer::Instance& buffer,
   return DecodeStatus::Done;
 }
 
-void BrpcCodec::encode(const MetaProtocolProxy::Metadata& metadata,
-                       const MetaProtocolProxy::Mutation& mutation, Buffer::Instance& buffer) {
+void BrpcEncoder::encode(const MetaProtocolProxy::Metadata& metadata,
+                         const MetaProtocolProxy::Mutation& mutation, Buffer::Instance& buffer) {
   // TODO we don't need to implement encode for now.
   // This method only need to be implemented if we want to modify the respose message
   (void)metadata;
@@ -44,8 +60,8 @@ void BrpcCodec::encode(const MetaProtocolProxy::Metadata& metadata,
   (void)buffer;
 }
 
-void BrpcCodec::onError(const MetaProtocolProxy::Metadata& /*metadata*/,
-                        const MetaProtocolProxy::Error& /*error*/, Buffer::Instance& /*buffer*/) {
+void BrpcEncoder::onError(const MetaProtocolProxy::Metadata& /*metadata*/,
+                          const MetaProtocolProxy::Error& /*error*/, Buffer::Instance& /*buffer*/) {
   // BrpcHeader response;
   // // Make sure to set the request id if the application protocol has one, otherwise MetaProtocol
   // framework will
@@ -63,7 +79,7 @@ void BrpcCodec::onError(const MetaProtocolProxy::Metadata& /*metadata*/,
   // response.encode(buffer);
 }
 
-BrpcDecodeStatus BrpcCodec::handleState(Buffer::Instance& buffer) {
+BrpcDecodeStatus BrpcDecoder::handleState(Buffer::Instance& buffer) {
   switch (decode_status) {
   case BrpcDecodeStatus::DecodeHeader:
     return decodeHeader(buffer);
@@ -75,7 +91,13 @@ BrpcDecodeStatus BrpcCodec::handleState(Buffer::Instance& buffer) {
   return BrpcDecodeStatus::DecodeDone;
 }
 
-BrpcDecodeStatus BrpcCodec::decodeHeader(Buffer::Instance& buffer) {
+BrpcDecodeStatus BrpcDecoder::onDecodeError(std::string detail) {
+  ENVOY_LOG(debug, "brpc decoder: {}", detail);
+  error_detail_ = std::move(detail);
+  return BrpcDecodeStatus::DecodeError;
+}
+
+BrpcDecodeStatus BrpcDecoder::decodeHeader(Buffer::Instance& buffer) {
   ENVOY_LOG(debug, "decode brpc header: {}", buffer.length());
   // Wait for more data if the header is not complete
   if (buffer.length() < BrpcHeader::HEADER_SIZE) {
@@ -84,22 +106,27 @@ BrpcDecodeStatus BrpcCodec::decodeHeader(Buffer::Instance& buffer) {
   }
 
   if (!brpc_header_.decode(buffer)) {
-    throw EnvoyException(fmt::format("brpc header invalid"));
+    return onDecodeError("brpc header invalid");
+  }
+  if (brpc_header_.get_meta_len() > brpc_header_.get_body_len()) {
+    return onDecodeError(fmt::format("brpc meta size {} larger than body size {}",
+                                     brpc_header_.get_meta_len(), brpc_header_.get_body_len()));
   }
 
   return BrpcDecodeStatus::DecodePayload;
 }
 
-BrpcDecodeStatus BrpcCodec::decodeBody(Buffer::Instance& buffer) {
+BrpcDecodeStatus BrpcDecoder::decodeBody(Buffer::Instance& buffer) {
   // Wait for more data if the buffer is not a complete message
   if (buffer.length() < BrpcHeader::HEADER_SIZE + brpc_header_.get_body_len()) {
     return BrpcDecodeStatus::WaitForData;
   }
 
-  meta_.ParseFromArray(static_cast<uint8_t*>(buffer.linearize(BrpcHeader::HEADER_SIZE +
-                                                              brpc_header_.get_meta_len())) +
-                           BrpcHeader::HEADER_SIZE,
-                       brpc_header_.get_meta_len());
+  const uint32_t meta_len = brpc_header_.get_meta_len();
+  const auto* data = static_cast<uint8_t*>(buffer.linearize(BrpcHeader::HEADER_SIZE + meta_len));
+  if (!meta_.ParseFromArray(data + BrpcHeader::HEADER_SIZE, meta_len)) {
+    return onDecodeError("brpc meta invalid");
+  }
   ENVOY_LOG(debug, "brpc meta: {}", meta_.DebugString());
 
   // move the decoded message out of the buffer
@@ -109,7 +136,7 @@ BrpcDecodeStatus BrpcCodec::decodeBody(Buffer::Instance& buffer) {
   return BrpcDecodeStatus::DecodeDone;
 }
 
-void BrpcCodec::toMetadata(MetaProtocolProxy::Metadata& metadata) {
+void BrpcDecoder::toMetadata(MetaProtocolProxy::Metadata& metadata) {
   // metadata.setRequestId(brpc_header_.get_pack_flow());
   // metadata.putString("cmd", std::to_string(brpc_header_.get_req_cmd()));
   metadata.originMessage().move(*origin_msg_);
@@ -22,28 +22,30 @@ enum class BrpcDecodeStatus {
   DecodePayload,
   DecodeDone,
   WaitForData,
+  DecodeError,
 };
 
 /**
- * Codec for Brpc protocol.
+ * Decoder for Brpc protocol.
  */
-class BrpcCodec : public MetaProtocolProxy::Codec,
-                  public Logger::Loggable<Logger::Id::misc> {
+class BrpcDecoder : public MetaProtocolProxy::ProtocolDecoder,
+                    public Logger::Loggable<Logger::Id::misc> {
 public:
-  BrpcCodec() {};
-  ~BrpcCodec() override = default;
+  BrpcDecoder() {};
+  ~BrpcDecoder() override = default;
 
   MetaProtocolProxy::DecodeStatus decode(Buffer::Instance& buffer,
                                          MetaProtocolProxy::Metadata& metadata) override;
-  void encode(const MetaProtocolProxy::Metadata& metadata,
-              const MetaProtocolProxy::Mutation& mutation, Buffer::Instance& buffer) override;
-  void onError(const MetaProtocolProxy::Metadata& metadata, const MetaProtocolProxy::Error& error,
-               Buffer::Instance& buffer) override;
+  uint64_t frameLength(const Buffer::Instance& buffer) override {
+    return BrpcFramer::frameLength(buffer);
+  }
+  std::string errorDetail() const override { return error_detail_; }
 
 protected:
   BrpcDecodeStatus handleState(Buffer::Instance& buffer);
   BrpcDecodeStatus decodeHeader(Buffer::Instance& buffer);
   BrpcDecodeStatus decodeBody(Buffer::Instance& buffer);
+  BrpcDecodeStatus onDecodeError(std::string detail);
   void toMetadata(MetaProtocolProxy::Metadata& metadata);
 
 private:
@@ -52,6 +54,18 @@ private:
   BrpcHeader brpc_header_;
   aeraki::meta_protocol::brpc::RpcMeta meta_;
   std::unique_ptr<Buffer::OwnedImpl> origin_msg_;
+  std::string error_detail_;
+};
+
+/**
+ * Encoder for Brpc protocol.
+ */
+class BrpcEncoder : public MetaProtocolProxy::Encoder, public Logger::Loggable<Logger::Id::misc> {
+public:
+  void encode(const MetaProtocolProxy::Metadata& metadata,
+              const MetaProtocolProxy::Mutation& mutation, Buffer::Instance& buffer) override;
+  void onError(const MetaProtocolProxy::Metadata& metadata, const MetaProtocolProxy::Error& error,
+               Buffer::Instance& buffer) override;
 };
 
 } // namespace Brpc
@@ -10,8 +10,12 @@ namespace NetworkFilters {
 namespace MetaProtocolProxy {
 namespace Brpc {
 
-MetaProtocolProxy::CodecPtr BrpcCodecConfig::createCodec(const Protobuf::Message&) {
-  return std::make_unique<Brpc::BrpcCodec>();
+MetaProtocolProxy::ProtocolDecoderPtr BrpcCodecConfig::createDecoder(const Protobuf::Message&) {
+  return std::make_unique<Brpc::BrpcDecoder>();
+};
+
+MetaProtocolProxy::EncoderSharedPtr BrpcCodecConfig::createEncoder(const Protobuf::Message&) {
+  return std::make_shared<Brpc::BrpcEncoder>();
 };
 
 /**
@@ -14,7 +14,8 @@ class BrpcCodecConfig
     : public MetaProtocolProxy::CodecFactoryBase<aeraki::meta_protocol::codec::BrpcCodec> {
 public:
   BrpcCodecConfig() : CodecFactoryBase("aeraki.meta_protocol.codec.brpc") {}
-  MetaProtocolProxy::CodecPtr createCodec(const Protobuf::Message& config) override;
+  MetaProtocolProxy::ProtocolDecoderPtr createDecoder(const Protobuf::Message& config) override;
+  MetaProtocolProxy::EncoderSharedPtr createEncoder(const Protobuf::Message& config) override;
 };
 
 } // namespace Brpc
@@ -17,7 +17,7 @@ bool BrpcHeader::decode(Buffer::Instance& buffer) {
 
   uint32_t pos = 0;
 
-  // todo : Check MAGIC
+  // the magic number has been checked by BrpcFramer
   pos += sizeof(uint32_t);
 
   _body_len = buffer.peekBEInt<uint32_t>(pos);
@@ -3,6 +3,8 @@
 #include "source/common/buffer/buffer_impl.h"
 #include "source/common/common/logger.h"
 
+#include "src/meta_protocol_proxy/codec/length_prefixed_framer.h"
+
 namespace Envoy {
 namespace Extensions {
 namespace NetworkFilters {
@@ -29,6 +31,9 @@ struct BrpcHeader : public Logger::Loggable<Logger::Id::filter> {
   void set_meta_len(uint32_t meta_len) {_meta_len = meta_len;};   
 };
 
+// "PRPC"(4) + body size(4) + meta size(4), the body size counts the meta but not the header
+using BrpcFramer = LengthPrefixedFramer<uint32_t, 0x50525043, 12, 4, uint32_t, 12>;
+
 } // namespace Brpc
 } // namespace MetaProtocolProxy
 } // namespace NetworkFilters
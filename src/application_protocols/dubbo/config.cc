@@ -10,8 +10,12 @@ namespace NetworkFilters {
 namespace MetaProtocolProxy {
 namespace Dubbo {
 
-MetaProtocolProxy::CodecPtr DubboCodecConfig::createCodec(const Protobuf::Message&) {
-  return std::make_unique<Dubbo::DubboCodec>();
+MetaProtocolProxy::ProtocolDecoderPtr DubboCodecConfig::createDecoder(const Protobuf::Message&) {
+  return std::make_unique<Dubbo::DubboDecoder>();
+};
+
+MetaProtocolProxy::EncoderSharedPtr DubboCodecConfig::createEncoder(const Protobuf::Message&) {
+  return std::make_shared<Dubbo::DubboEncoder>();
 };
 
 /**
@@ -14,7 +14,8 @@ class DubboCodecConfig
     : public MetaProtocolProxy::CodecFactoryBase<aeraki::meta_protocol::codec::DubboCodec> {
 public:
   DubboCodecConfig() : CodecFactoryBase("aeraki.meta_protocol.codec.dubbo") {}
-  MetaProtocolProxy::CodecPtr createCodec(const Protobuf::Message& config) override;
+  MetaProtocolProxy::ProtocolDecoderPtr createDecoder(const Protobuf::Message& config) override;
+  MetaProtocolProxy::EncoderSharedPtr createEncoder(const Protobuf::Message& config) override;
 };
 
 } // namespace Dubbo
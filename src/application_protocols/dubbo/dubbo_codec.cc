@@ -16,18 +16,29 @@ namespace NetworkFilters {
 namespace MetaProtocolProxy {
 namespace Dubbo {
 
-MetaProtocolProxy::DecodeStatus DubboCodec::decode(Buffer::Instance& buffer,
-                                                   MetaProtocolProxy::Metadata& metadata) {
+MetaProtocolProxy::DecodeStatus DubboDecoder::decode(Buffer::Instance& buffer,
+                                                     MetaProtocolProxy::Metadata& metadata) {
   ENVOY_LOG(debug, "dubbo decoder: {} bytes available", buffer.length());
 
   if (!decode_started_) {
+    // Don't start the state machine before the whole message has arrived
+    switch (DubboFramer::check(buffer)) {
+    case DubboFramer::Status::WaitForData:
+      ENVOY_LOG(debug, "dubbo decoder: wait for data");
+      return DecodeStatus::WaitForData;
+    case DubboFramer::Status::Invalid:
+      onInvalidHeader(buffer);
+      return DecodeStatus::Error;
+    case DubboFramer::Status::Complete:
+      break;
+    }
     start();
   }
 
   ENVOY_LOG(debug, "dubbo decoder: protocol {}, state {}, {} bytes available", protocol_->name(),
-            ProtocolStateNameValues::name(state_machine_->currentState()), buffer.length());
+            ProtocolStateNameValues::name(state_machine_.currentState()), buffer.length());
 
-  ProtocolState state = state_machine_->run(buffer);
+  ProtocolState state = state_machine_.run(buffer);
   if (state == ProtocolState::WaitForData) {
     ENVOY_LOG(debug, "dubbo decoder: wait for data");
     return DecodeStatus::WaitForData;
@@ -35,25 +46,37 @@ MetaProtocolProxy::DecodeStatus DubboCodec::decode(Buffer::Instance& buffer,
 
   ASSERT(state == ProtocolState::Done);
 
-  toMetadata(*(state_machine_->messageMetadata()), *(state_machine_->messageContext()), metadata);
+  toMetadata(*(state_machine_.messageMetadata()), *(state_machine_.messageContext()), metadata);
 
   // Reset for next request.
   complete();
   return DecodeStatus::Done;
 }
 
-void DubboCodec::start() {
-  state_machine_ = std::make_unique<DecoderStateMachine>(*protocol_);
+void DubboDecoder::onInvalidHeader(const Buffer::Instance& buffer) {
+  // the framer rejects a message either for its magic number or for its body size
+  const int32_t body_size = DubboFramer::peek<int32_t>(buffer, 12);
+  if (body_size < 0 || body_size > DubboProtocolImpl::MaxBodySize) {
+    error_detail_ = fmt::format("invalid dubbo message size {}", body_size);
+  } else {
+    error_detail_ = fmt::format("invalid dubbo message magic number {}",
+                                DubboFramer::peek<uint16_t>(buffer, 0));
+  }
+  ENVOY_LOG(debug, "dubbo decoder: {}", error_detail_);
+}
+
+void DubboDecoder::start() {
+  state_machine_.reset();
   decode_started_ = true;
 }
 
-void DubboCodec::complete() {
-  state_machine_ = nullptr;
+void DubboDecoder::complete() {
+  state_machine_.clear();
   decode_started_ = false;
 }
 
-void DubboCodec::encode(const MetaProtocolProxy::Metadata& metadata,
-                        const MetaProtocolProxy::Mutation& mutation, Buffer::Instance& buffer) {
+void DubboEncoder::encode(const MetaProtocolProxy::Metadata& metadata,
+                          const MetaProtocolProxy::Mutation& mutation, Buffer::Instance& buffer) {
   ENVOY_LOG(debug, "dubbo: codec server real address: {} ",
             metadata.getString(ReservedHeaders::RealServerAddress));
 
@@ -78,9 +101,9 @@ void DubboCodec::encode(const MetaProtocolProxy::Metadata& metadata,
   }
 }
 
-void DubboCodec::encodeResponse(const MetaProtocolProxy::Metadata& metadata,
-                                const MetaProtocolProxy::Mutation& mutation,
-                                Buffer::Instance& buffer) {
+void DubboEncoder::encodeResponse(const MetaProtocolProxy::Metadata& metadata,
+                                  const MetaProtocolProxy::Mutation& mutation,
+                                  Buffer::Instance& buffer) {
 
   MessageMetadata msgMetadata;
   toMsgMetadata(metadata, msgMetadata);
@@ -127,8 +150,8 @@ void DubboCodec::encodeResponse(const MetaProtocolProxy::Metadata& metadata,
   }
 }
 
-void DubboCodec::onError(const MetaProtocolProxy::Metadata& metadata,
-                         const MetaProtocolProxy::Error& error, Buffer::Instance& buffer) {
+void DubboEncoder::onError(const MetaProtocolProxy::Metadata& metadata,
+                           const MetaProtocolProxy::Error& error, Buffer::Instance& buffer) {
   ASSERT(buffer.length() == 0);
   MessageMetadata msgMetadata;
   toMsgMetadata(metadata, msgMetadata);
@@ -143,6 +166,9 @@ void DubboCodec::onError(const MetaProtocolProxy::Metadata& metadata,
   case MetaProtocolProxy::ErrorType::BadResponse:
     status = ResponseStatus::BadResponse;
     break;
+  case MetaProtocolProxy::ErrorType::ServerBusy:
+    status = ResponseStatus::ServerThreadpoolExhaustedError;
+    break;
   default:
     status = ResponseStatus::ServerError;
   }
@@ -154,8 +180,8 @@ void DubboCodec::onError(const MetaProtocolProxy::Metadata& metadata,
   }
 }
 
-void DubboCodec::toMetadata(const MessageMetadata& msgMetadata,
-                            MetaProtocolProxy::Metadata& metadata) {
+void DubboDecoder::toMetadata(const MessageMetadata& msgMetadata,
+                              MetaProtocolProxy::Metadata& metadata) {
   if (msgMetadata.hasInvocationInfo()) {
     auto* invo = const_cast<RpcInvocationImpl*>(
         dynamic_cast<const RpcInvocationImpl*>(&msgMetadata.invocationInfo()));
@@ -225,21 +251,23 @@ void DubboCodec::toMetadata(const MessageMetadata& msgMetadata,
   if (msgMetadata.hasResponseStatus()) {
     if (msgMetadata.responseStatus() == ResponseStatus::Ok) {
       metadata.setResponseStatus(MetaProtocolProxy::ResponseStatus::Ok);
+    } else if (msgMetadata.responseStatus() == ResponseStatus::ServerThreadpoolExhaustedError) {
+      metadata.setResponseStatus(MetaProtocolProxy::ResponseStatus::ServerBusy);
     } else {
       metadata.setResponseStatus(MetaProtocolProxy::ResponseStatus::Error);
     }
   }
 }
-void DubboCodec::toMetadata(const MessageMetadata& msgMetadata, Context& context,
-                            MetaProtocolProxy::Metadata& metadata) {
-  DubboCodec::toMetadata(msgMetadata, metadata);
+void DubboDecoder::toMetadata(const MessageMetadata& msgMetadata, Context& context,
+                              MetaProtocolProxy::Metadata& metadata) {
+  DubboDecoder::toMetadata(msgMetadata, metadata);
   metadata.setHeaderSize(context.headerSize());
   metadata.setBodySize(context.bodySize());
   metadata.originMessage().move(context.originMessage());
 }
 
-void DubboCodec::toMsgMetadata(const MetaProtocolProxy::Metadata& metadata,
-                               MessageMetadata& msgMetadata) {
+void DubboEncoder::toMsgMetadata(const MetaProtocolProxy::Metadata& metadata,
+                                 MessageMetadata& msgMetadata) {
   msgMetadata.setRequestId(metadata.getRequestId());
   auto ref = metadata.getByKey("InvocationInfo");
   if (ref.has_value()) {
@@ -288,8 +316,8 @@ void DubboCodec::toMsgMetadata(const MetaProtocolProxy::Metadata& metadata,
   }
 }
 
-void DubboCodec::encodeHeartbeat(const MetaProtocolProxy::Metadata& metadata,
-                                 Buffer::Instance& buffer) {
+void DubboEncoder::encodeHeartbeat(const MetaProtocolProxy::Metadata& metadata,
+                                   Buffer::Instance& buffer) {
   MessageMetadata msgMetadata;
   toMsgMetadata(metadata, msgMetadata);
   msgMetadata.setResponseStatus(ResponseStatus::Ok);
@@ -300,9 +328,9 @@ void DubboCodec::encodeHeartbeat(const MetaProtocolProxy::Metadata& metadata,
   }
 }
 
-void DubboCodec::encodeRequest(const MetaProtocolProxy::Metadata& metadata,
-                               const MetaProtocolProxy::Mutation& mutation,
-                               Buffer::Instance& buffer) {
+void DubboEncoder::encodeRequest(const MetaProtocolProxy::Metadata& metadata,
+                                 const MetaProtocolProxy::Mutation& mutation,
+                                 Buffer::Instance& buffer) {
   MessageMetadata msgMetadata;
   toMsgMetadata(metadata, msgMetadata);
   if (msgMetadata.hasInvocationInfo()) {
@@ -10,6 +10,7 @@
 #include "source/common/common/logger.h"
 #include "src/meta_protocol_proxy/codec/codec.h"
 #include "src/application_protocols/dubbo/protocol.h"
+#include "src/application_protocols/dubbo/dubbo_protocol_impl.h"
 
 namespace Envoy {
 namespace Extensions {
@@ -47,8 +48,26 @@ private:
 class DecoderStateMachine : public Logger::Loggable<Logger::Id::dubbo> {
 public:
   DecoderStateMachine(Protocol& protocol)
-      : protocol_(protocol), state_(ProtocolState::OnDecodeStreamHeader) {
-    metadata_ = std::make_shared<MessageMetadata>();
+      : protocol_(protocol), metadata_(std::make_shared<MessageMetadata>()),
+        state_(ProtocolState::OnDecodeStreamHeader) {}
+
+  /**
+   * Prepare the state machine for the next message. The state machine and the message metadata are
+   * owned by the decoder and reused for all the messages of a connection.
+   */
+  void reset() {
+    state_ = ProtocolState::OnDecodeStreamHeader;
+    *metadata_ = MessageMetadata();
+    context_.reset();
+  }
+
+  /**
+   * Release the decoded message once it has been handed over to the framework. The invocation and
+   * the result are shared with the framework's metadata, the message metadata itself is kept.
+   */
+  void clear() {
+    *metadata_ = MessageMetadata();
+    context_.reset();
   }
 
   /**
@@ -93,38 +112,62 @@ private:
   ProtocolState state_;
 };
 
-using DecoderStateMachinePtr = std::unique_ptr<DecoderStateMachine>;
-
 /**
- * Codec for Dubbo protocol.
+ * Decoder for Dubbo protocol.
  */
-class DubboCodec : public MetaProtocolProxy::Codec, public Logger::Loggable<Logger::Id::dubbo> {
+class DubboDecoder : public MetaProtocolProxy::ProtocolDecoder,
+                     public Logger::Loggable<Logger::Id::dubbo> {
 public:
-  DubboCodec() {
-    protocol_ = NamedProtocolConfigFactory::getFactory(ProtocolType::Dubbo)
-                    .createProtocol(SerializationType::Hessian2);
-  };
-  ~DubboCodec() override { ENVOY_LOG(trace, "********** DubboCodec destructed ***********"); };
+  DubboDecoder()
+      : protocol_(NamedProtocolConfigFactory::getFactory(ProtocolType::Dubbo)
+                      .createProtocol(SerializationType::Hessian2)),
+        state_machine_(*protocol_) {}
+  ~DubboDecoder() override { ENVOY_LOG(trace, "********** DubboDecoder destructed ***********"); };
 
   MetaProtocolProxy::DecodeStatus decode(Buffer::Instance& buffer,
                                          MetaProtocolProxy::Metadata& metadata) override;
-  void encode(const MetaProtocolProxy::Metadata& metadata,
-              const MetaProtocolProxy::Mutation& mutation, Buffer::Instance& buffer) override;
-  void onError(const MetaProtocolProxy::Metadata& metadata, const MetaProtocolProxy::Error& error,
-               Buffer::Instance& buffer) override;
+  uint64_t frameLength(const Buffer::Instance& buffer) override {
+    return DubboFramer::frameLength(buffer);
+  }
+  std::string errorDetail() const override { return error_detail_; }
 
 private:
   void toMetadata(const MessageMetadata& msgMetadata, MetaProtocolProxy::Metadata& metadata);
 
   void toMetadata(const MessageMetadata& msgMetadata, Context& context,
                   MetaProtocolProxy::Metadata& metadata);
-  void toMsgMetadata(const MetaProtocolProxy::Metadata& metadata, MessageMetadata& msgMetadata);
+
+  void onInvalidHeader(const Buffer::Instance& buffer);
 
   void start();
 
   void complete();
 
+  ProtocolPtr protocol_;
+  DecoderStateMachine state_machine_;
+  bool decode_started_{false};
+  std::string error_detail_;
+};
+
+/**
+ * Encoder for Dubbo protocol. The Dubbo protocol and the Hessian2 serializer don't keep any state
+ * while encoding, so a single encoder can be shared by all the connections of a worker.
+ */
+class DubboEncoder : public MetaProtocolProxy::Encoder, public Logger::Loggable<Logger::Id::dubbo> {
+public:
+  DubboEncoder() {
+    protocol_ = NamedProtocolConfigFactory::getFactory(ProtocolType::Dubbo)
+                    .createProtocol(SerializationType::Hessian2);
+  };
+
+  void encode(const MetaProtocolProxy::Metadata& metadata,
+              const MetaProtocolProxy::Mutation& mutation, Buffer::Instance& buffer) override;
+  void onError(const MetaProtocolProxy::Metadata& metadata, const MetaProtocolProxy::Error& error,
+               Buffer::Instance& buffer) override;
+
 private:
+  void toMsgMetadata(const MetaProtocolProxy::Metadata& metadata, MessageMetadata& msgMetadata);
+
   void encodeHeartbeat(const MetaProtocolProxy::Metadata& metadata, Buffer::Instance& buffer);
   void encodeRequest(const MetaProtocolProxy::Metadata& metadata,
                      const MetaProtocolProxy::Mutation& mutation, Buffer::Instance& buffer);
@@ -132,8 +175,6 @@ private:
                       const MetaProtocolProxy::Mutation& mutation, Buffer::Instance& buffer);
 
   ProtocolPtr protocol_;
-  DecoderStateMachinePtr state_machine_;
-  bool decode_started_{false};
 };
 
 } // namespace Dubbo
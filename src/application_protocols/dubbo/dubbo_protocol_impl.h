@@ -1,5 +1,6 @@
 #pragma once
 
+#include "src/meta_protocol_proxy/codec/length_prefixed_framer.h"
 #include "src/application_protocols/dubbo/protocol.h"
 
 namespace Envoy {
@@ -34,6 +35,12 @@ private:
                          const Context& context);
 };
 
+// magic number(2) + flag(1) + status(1) + request id(8) + body size(4)
+using DubboFramer =
+    LengthPrefixedFramer<uint16_t, 0xdabb, DubboProtocolImpl::MessageSize, 12, uint32_t,
+                         DubboProtocolImpl::MessageSize,
+                         DubboProtocolImpl::MessageSize + DubboProtocolImpl::MaxBodySize>;
+
 } // namespace Dubbo
 } // namespace MetaProtocolProxy
 } // namespace NetworkFilters
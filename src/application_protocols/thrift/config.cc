@@ -10,8 +10,12 @@ namespace NetworkFilters {
 namespace MetaProtocolProxy {
 namespace Thrift {
 
-MetaProtocolProxy::CodecPtr ThriftCodecConfig::createCodec(const Protobuf::Message&) {
-  return std::make_unique<Thrift::ThriftCodec>();
+MetaProtocolProxy::ProtocolDecoderPtr ThriftCodecConfig::createDecoder(const Protobuf::Message&) {
+  return std::make_unique<Thrift::ThriftDecoder>();
+};
+
+MetaProtocolProxy::EncoderSharedPtr ThriftCodecConfig::createEncoder(const Protobuf::Message&) {
+  return std::make_shared<Thrift::ThriftEncoder>();
 };
 
 /**
@@ -14,7 +14,8 @@ class ThriftCodecConfig
     : public MetaProtocolProxy::CodecFactoryBase<aeraki::meta_protocol::codec::ThriftCodec> {
 public:
   ThriftCodecConfig() : CodecFactoryBase("aeraki.meta_protocol.codec.thrift") {}
-  MetaProtocolProxy::CodecPtr createCodec(const Protobuf::Message& config) override;
+  MetaProtocolProxy::ProtocolDecoderPtr createDecoder(const Protobuf::Message& config) override;
+  MetaProtocolProxy::EncoderSharedPtr createEncoder(const Protobuf::Message& config) override;
 };
 
 } // namespace Thrift
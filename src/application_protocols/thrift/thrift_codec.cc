@@ -15,8 +15,12 @@ namespace NetworkFilters {
 namespace MetaProtocolProxy {
 namespace Thrift {
 
-MetaProtocolProxy::DecodeStatus ThriftCodec::decode(Buffer::Instance& data,
-                                                    MetaProtocolProxy::Metadata& metadata) {
+static const std::string TransportTypeKey = "TransportType";
+static const std::string ProtocolTypeKey = "ProtocolType";
+static const std::string TApplicationException = "TApplicationException";
+
+MetaProtocolProxy::DecodeStatus ThriftDecoder::decode(Buffer::Instance& data,
+                                                      MetaProtocolProxy::Metadata& metadata) {
 
   ENVOY_LOG(debug, "thrift: {} bytes available", data.length());
 
@@ -44,10 +48,11 @@ MetaProtocolProxy::DecodeStatus ThriftCodec::decode(Buffer::Instance& data,
         ENVOY_LOG(debug, "thrift: {} transport forced {} protocol", transport_->name(),
                   protocol_->name());
       } else if (metadata_->protocol() != protocol_->type()) {
-        throw EnvoyException(
+        error_detail_ =
             fmt::format("transport reports protocol {}, but configured for {}",
                         ThriftProxy::ProtocolNames::get().fromType(metadata_->protocol()),
-                        ThriftProxy::ProtocolNames::get().fromType(protocol_->type())));
+                        ThriftProxy::ProtocolNames::get().fromType(protocol_->type()));
+        return DecodeStatus::Error;
       }
     }
     if (metadata_->hasAppException()) {
@@ -55,20 +60,19 @@ MetaProtocolProxy::DecodeStatus ThriftCodec::decode(Buffer::Instance& data,
       std::string ex_msg = metadata_->appExceptionMessage();
       // Force new metadata if we get called again.
       metadata_.reset();
-      throw EnvoyException(fmt::format("thrift AppException: type: {}, message: {}",
-			                                             static_cast<int>(ex_type), ex_msg));
+      error_detail_ = fmt::format("thrift AppException: type: {}, message: {}",
+                                  static_cast<int>(ex_type), ex_msg);
+      return DecodeStatus::Error;
     }
 
     frame_started_ = true;
-    state_machine_ = std::make_unique<DecoderStateMachine>(*protocol_, *metadata_);
+    state_machine_.reset(*metadata_);
   }
 
-  ASSERT(state_machine_ != nullptr);
-
   ENVOY_LOG(debug, "thrift: protocol {}, state {}, {} bytes available", protocol_->name(),
-            ProtocolStateNameValues::name(state_machine_->currentState()), data.length());
+            ProtocolStateNameValues::name(state_machine_.currentState()), data.length());
 
-  ProtocolState rv = state_machine_->run(data);
+  ProtocolState rv = state_machine_.run(data);
   if (rv == ProtocolState::WaitForData) {
     ENVOY_LOG(debug, "thrift: wait for data");
     return DecodeStatus::WaitForData;
@@ -95,14 +99,13 @@ MetaProtocolProxy::DecodeStatus ThriftCodec::decode(Buffer::Instance& data,
   return DecodeStatus::Done;
 }
 
-void ThriftCodec::complete() {
-  state_machine_ = nullptr;
+void ThriftDecoder::complete() {
   frame_started_ = false;
   frame_ended_ = false;
 }
 
-void ThriftCodec::encode(const MetaProtocolProxy::Metadata& metadata,
-                         const MetaProtocolProxy::Mutation& mutation, Buffer::Instance& buffer) {
+void ThriftEncoder::encode(const MetaProtocolProxy::Metadata& metadata,
+                           const MetaProtocolProxy::Mutation& mutation, Buffer::Instance& buffer) {
   (void)buffer;
   for (const auto& keyValue : mutation) {
     ENVOY_LOG(debug, "thrift: codec mutation {} : {}", keyValue.first, keyValue.second);
@@ -131,13 +134,13 @@ void ThriftCodec::encode(const MetaProtocolProxy::Metadata& metadata,
   }
 }
 
-static const std::string TApplicationException = "TApplicationException";
+
 static const std::string MessageField = "message";
 static const std::string TypeField = "type";
 static const std::string StopField = "";
 
-void ThriftCodec::onError(const MetaProtocolProxy::Metadata& metadata,
-                          const MetaProtocolProxy::Error& error, Buffer::Instance& buffer) {
+void ThriftEncoder::onError(const MetaProtocolProxy::Metadata& metadata,
+                            const MetaProtocolProxy::Error& error, Buffer::Instance& buffer) {
   ASSERT(buffer.length() == 0);
 
   ThriftProxy::MessageMetadata msgMetadata;
@@ -154,29 +157,32 @@ void ThriftCodec::onError(const MetaProtocolProxy::Metadata& metadata,
 
   msgMetadata.setMessageType(ThriftProxy::MessageType::Exception);
 
+  ThriftProxy::Protocol& proto = protocol(metadata);
   Buffer::OwnedImpl response_buffer;
 
-  protocol_->writeMessageBegin(response_buffer, msgMetadata);
-  protocol_->writeStructBegin(response_buffer, TApplicationException);
+  proto.writeMessageBegin(response_buffer, msgMetadata);
+  proto.writeStructBegin(response_buffer, TApplicationException);
 
-  protocol_->writeFieldBegin(response_buffer, MessageField, ThriftProxy::FieldType::String, 1);
-  protocol_->writeString(response_buffer, error.message);
-  protocol_->writeFieldEnd(response_buffer);
+  proto.writeFieldBegin(response_buffer, MessageField, ThriftProxy::FieldType::String, 1);
+  proto.writeString(response_buffer, error.message);
+  proto.writeFieldEnd(response_buffer);
 
-  protocol_->writeFieldBegin(response_buffer, TypeField, ThriftProxy::FieldType::I32, 2);
-  protocol_->writeInt32(response_buffer, static_cast<int32_t>(ThriftProxy::AppExceptionType::InternalError));
-  protocol_->writeFieldEnd(response_buffer);
+  proto.writeFieldBegin(response_buffer, TypeField, ThriftProxy::FieldType::I32, 2);
+  proto.writeInt32(response_buffer,
+                   static_cast<int32_t>(ThriftProxy::AppExceptionType::InternalError));
+  proto.writeFieldEnd(response_buffer);
 
-  protocol_->writeFieldBegin(response_buffer, StopField, ThriftProxy::FieldType::Stop, 0);
+  proto.writeFieldBegin(response_buffer, StopField, ThriftProxy::FieldType::Stop, 0);
 
-  protocol_->writeStructEnd(response_buffer);
-  protocol_->writeMessageEnd(response_buffer);
+  proto.writeStructEnd(response_buffer);
+  proto.writeMessageEnd(response_buffer);
 
   // frame process
-  transport_->encodeFrame(buffer, msgMetadata, response_buffer);
+  transport(metadata).encodeFrame(buffer, msgMetadata, response_buffer);
 }
 
-void ThriftCodec::toMetadata(const ThriftProxy::MessageMetadata& msgMetadata, Metadata& metadata) {
+void ThriftDecoder::toMetadata(const ThriftProxy::MessageMetadata& msgMetadata,
+                               Metadata& metadata) {
   if (msgMetadata.hasMethodName()) {
     metadata.putString("method", msgMetadata.methodName());
   }
@@ -206,11 +212,15 @@ void ThriftCodec::toMetadata(const ThriftProxy::MessageMetadata& msgMetadata, Me
     PANIC("not reachec");
   }
 
-  transport_->encodeFrame(metadata.originMessage(), msgMetadata, state_machine_->originalMessage());
+  // The encoder needs the detected transport and protocol to build a local reply
+  metadata.put(TransportTypeKey, transport_->type());
+  metadata.put(ProtocolTypeKey, protocol_->type());
+
+  transport_->encodeFrame(metadata.originMessage(), msgMetadata, state_machine_.originalMessage());
 }
 
-void ThriftCodec::toMsgMetadata(const Metadata& metadata,
-                                ThriftProxy::MessageMetadata& msgMetadata) {
+void ThriftEncoder::toMsgMetadata(const Metadata& metadata,
+                                  ThriftProxy::MessageMetadata& msgMetadata) {
   auto method = metadata.getString("method");
   // TODO we should use a more appropriate method to tell if metadata contains a specific key
   if (method != "") {
@@ -219,6 +229,36 @@ void ThriftCodec::toMsgMetadata(const Metadata& metadata,
   msgMetadata.setSequenceId(metadata.getRequestId());
 }
 
+ThriftProxy::Transport& ThriftEncoder::transport(const Metadata& metadata) {
+  auto type = ThriftProxy::TransportType::Framed;
+  auto ref = metadata.getByKey(TransportTypeKey);
+  if (ref.has_value() &&
+      std::any_cast<ThriftProxy::TransportType>(ref.value()) != ThriftProxy::TransportType::Auto) {
+    type = std::any_cast<ThriftProxy::TransportType>(ref.value());
+  }
+
+  auto& transport = transports_[static_cast<size_t>(type)];
+  if (transport == nullptr) {
+    transport = ThriftProxy::NamedTransportConfigFactory::getFactory(type).createTransport();
+  }
+  return *transport;
+}
+
+ThriftProxy::Protocol& ThriftEncoder::protocol(const Metadata& metadata) {
+  auto type = ThriftProxy::ProtocolType::Binary;
+  auto ref = metadata.getByKey(ProtocolTypeKey);
+  if (ref.has_value() &&
+      std::any_cast<ThriftProxy::ProtocolType>(ref.value()) != ThriftProxy::ProtocolType::Auto) {
+    type = std::any_cast<ThriftProxy::ProtocolType>(ref.value());
+  }
+
+  auto& protocol = protocols_[static_cast<size_t>(type)];
+  if (protocol == nullptr) {
+    protocol = ThriftProxy::NamedProtocolConfigFactory::getFactory(type).createProtocol();
+  }
+  return *protocol;
+}
+
 // PassthroughData -> PassthroughData
 // PassthroughData -> MessageEnd (all body bytes received)
 ProtocolState DecoderStateMachine::passthroughData(Buffer::Instance& buffer) {
@@ -233,7 +273,7 @@ ProtocolState DecoderStateMachine::passthroughData(Buffer::Instance& buffer) {
 // MessageBegin -> StructBegin
 ProtocolState DecoderStateMachine::messageBegin(Buffer::Instance& buffer) {
   const auto total = buffer.length();
-  if (!proto_.readMessageBegin(buffer, metadata_)) {
+  if (!proto_.readMessageBegin(buffer, *metadata_)) {
     return ProtocolState::WaitForData;
   }
 
@@ -241,11 +281,11 @@ ProtocolState DecoderStateMachine::messageBegin(Buffer::Instance& buffer) {
   stack_.emplace_back(Frame(ProtocolState::MessageEnd));
 
   if (passthrough_enabled_) {
-    body_bytes_ = metadata_.frameSize() - (total - buffer.length());
+    body_bytes_ = metadata_->frameSize() - (total - buffer.length());
     return ProtocolState::PassthroughData;
   }
 
-  proto_.writeMessageBegin(origin_message_, metadata_);
+  proto_.writeMessageBegin(origin_message_, *metadata_);
   return ProtocolState::StructBegin;
 }
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <any>
+#include <array>
 #include <string>
 
 #include "envoy/buffer/buffer.h"
@@ -70,8 +71,21 @@ private:
  */
 class DecoderStateMachine : public Logger::Loggable<Logger::Id::thrift> {
 public:
-  DecoderStateMachine(ThriftProxy::Protocol& proto, ThriftProxy::MessageMetadata& metadata)
-      : proto_(proto), metadata_(metadata), state_(ProtocolState::MessageBegin) {}
+  DecoderStateMachine(ThriftProxy::Protocol& proto)
+      : proto_(proto), state_(ProtocolState::MessageBegin) {}
+
+  /**
+   * Prepare the state machine for the next frame. The state machine is owned by the decoder and
+   * reused for all the frames of a connection, so the stack keeps its capacity across frames.
+   *
+   * @param metadata the metadata of the frame, it must outlive the decoding of the frame
+   */
+  void reset(ThriftProxy::MessageMetadata& metadata) {
+    metadata_ = &metadata;
+    state_ = ProtocolState::MessageBegin;
+    stack_.clear();
+    body_bytes_ = 0;
+  }
 
   /**
    * Consumes as much data from the configured Buffer as possible and executes the decoding state
@@ -167,7 +181,7 @@ private:
   ProtocolState popReturnState();
 
   ThriftProxy::Protocol& proto_;
-  ThriftProxy::MessageMetadata& metadata_;
+  ThriftProxy::MessageMetadata* metadata_{};
   ProtocolState state_;
   std::vector<Frame> stack_;
   uint32_t body_bytes_{};
@@ -175,42 +189,67 @@ private:
   Buffer::OwnedImpl origin_message_;
 };
 
-using DecoderStateMachinePtr = std::unique_ptr<DecoderStateMachine>;
-
 /**
- * Codec for Thrift protocol.
+ * Decoder for Thrift protocol.
  */
-class ThriftCodec : public MetaProtocolProxy::Codec, public Logger::Loggable<Logger::Id::filter> {
+class ThriftDecoder : public MetaProtocolProxy::ProtocolDecoder,
+                      public Logger::Loggable<Logger::Id::filter> {
 public:
-  ThriftCodec() {
-    transport_ =
-        ThriftProxy::NamedTransportConfigFactory::getFactory(ThriftProxy::TransportType::Auto)
-            .createTransport();
-    protocol_ = ThriftProxy::NamedProtocolConfigFactory::getFactory(ThriftProxy::ProtocolType::Auto)
-                    .createProtocol();
-  };
-  ~ThriftCodec() override = default;
+  ThriftDecoder()
+      : transport_(
+            ThriftProxy::NamedTransportConfigFactory::getFactory(ThriftProxy::TransportType::Auto)
+                .createTransport()),
+        protocol_(
+            ThriftProxy::NamedProtocolConfigFactory::getFactory(ThriftProxy::ProtocolType::Auto)
+                .createProtocol()),
+        state_machine_(*protocol_) {}
+  ~ThriftDecoder() override = default;
 
   MetaProtocolProxy::DecodeStatus decode(Buffer::Instance& buffer,
                                          MetaProtocolProxy::Metadata& metadata) override;
-  void encode(const MetaProtocolProxy::Metadata& metadata,
-              const MetaProtocolProxy::Mutation& mutation, Buffer::Instance& buffer) override;
-  void onError(const MetaProtocolProxy::Metadata& metadata, const MetaProtocolProxy::Error& error,
-               Buffer::Instance& buffer) override;
+  std::string errorDetail() const override { return error_detail_; }
 
 private:
   void toMetadata(const ThriftProxy::MessageMetadata& msgMetadata, Metadata& metadata);
 
-  void toMsgMetadata(const Metadata& metadata, ThriftProxy::MessageMetadata& msgMetadata);
-
   void complete();
 
   ThriftProxy::TransportPtr transport_;
   ThriftProxy::ProtocolPtr protocol_;
   ThriftProxy::MessageMetadataSharedPtr metadata_;
-  DecoderStateMachinePtr state_machine_;
+  DecoderStateMachine state_machine_;
   bool frame_started_{false};
   bool frame_ended_{false};
+  std::string error_detail_;
+};
+
+/**
+ * Encoder for Thrift protocol.
+ *
+ * The transport and the protocol of a connection are auto detected by the decoder, which records
+ * them in the metadata. The encoder picks the matching transport and protocol from the metadata,
+ * they're created the first time a type is used and then reused by the worker.
+ */
+class ThriftEncoder : public MetaProtocolProxy::Encoder,
+                      public Logger::Loggable<Logger::Id::filter> {
+public:
+  void encode(const MetaProtocolProxy::Metadata& metadata,
+              const MetaProtocolProxy::Mutation& mutation, Buffer::Instance& buffer) override;
+  void onError(const MetaProtocolProxy::Metadata& metadata, const MetaProtocolProxy::Error& error,
+               Buffer::Instance& buffer) override;
+
+private:
+  void toMsgMetadata(const Metadata& metadata, ThriftProxy::MessageMetadata& msgMetadata);
+
+  ThriftProxy::Transport& transport(const Metadata& metadata);
+  ThriftProxy::Protocol& protocol(const Metadata& metadata);
+
+  std::array<ThriftProxy::TransportPtr,
+             static_cast<size_t>(ThriftProxy::TransportType::LastTransportType) + 1>
+      transports_;
+  std::array<ThriftProxy::ProtocolPtr,
+             static_cast<size_t>(ThriftProxy::ProtocolType::LastProtocolType) + 1>
+      protocols_;
 };
 
 } // namespace Thrift
@@ -17,10 +17,23 @@ namespace Trpc {
 CodecChecker::DecodeStage CodecChecker::onData(Buffer::Instance& buffer) {
   ENVOY_LOG(debug, "decoder onData: {}", buffer.length());
 
+  // 等待完整的数据帧后再开始解析, 之后的各个阶段都不需要再等待数据
+  if (decode_stage_ == DecodeStage::kDecodeFixedHeader) {
+    switch (TrpcFramer::check(buffer)) {
+    case TrpcFramer::Status::WaitForData:
+      ENVOY_LOG(debug, "continue {}", buffer.length());
+      return DecodeStage::kWaitForData;
+    case TrpcFramer::Status::Invalid:
+      return onError("protocol invalid");
+    case TrpcFramer::Status::Complete:
+      break;
+    }
+  }
+
   while (decode_stage_ != DecodeStage::kDecodeDone) {
     auto state = handleState(buffer);
-    if (state == DecodeStage::kWaitForData) {
-      return DecodeStage::kWaitForData;
+    if (state == DecodeStage::kWaitForData || state == DecodeStage::kDecodeError) {
+      return state;
     }
     decode_stage_ = state;
   }
@@ -48,6 +61,13 @@ CodecChecker::DecodeStage CodecChecker::handleState(Buffer::Instance& buffer) {
   return DecodeStage::kDecodeDone;
 }
 
+CodecChecker::DecodeStage CodecChecker::onError(absl::string_view detail) {
+  ENVOY_LOG(debug, "trpc decoder: {}", detail);
+  error_detail_ = std::string(detail);
+  reset();
+  return DecodeStage::kDecodeError;
+}
+
 CodecChecker::DecodeStage CodecChecker::decodeFixedHeader(Buffer::Instance& buffer) {
   ENVOY_LOG(debug, "decoder FixedHeader: {}", buffer.length());
   if (buffer.length() < TrpcFixedHeader::TRPC_PROTO_PREFIX_SPACE) {
@@ -57,7 +77,7 @@ CodecChecker::DecodeStage CodecChecker::decodeFixedHeader(Buffer::Instance& buff
 
   std::unique_ptr<TrpcFixedHeader> fixed_header = std::make_unique<TrpcFixedHeader>();
   if (!fixed_header->decode(buffer, false)) {
-    throw EnvoyException(fmt::format("protocol invalid"));
+    return onError("protocol invalid");
   }
 
   total_size_ = fixed_header->data_frame_size;
@@ -86,7 +106,7 @@ CodecChecker::DecodeStage CodecChecker::decodeUnaryProtocolHeader(Buffer::Instan
   buffer.copyOut(TrpcFixedHeader::TRPC_PROTO_PREFIX_SPACE, protocol_header_size_, &(header_raw[0]));
 
   if (!call_backs_.onUnaryHeader(std::move(header_raw))) {
-    throw EnvoyException("parse header failed");
+    return onError("parse header failed");
   }
 
   return DecodeStage::kDecodePayload;
@@ -107,7 +127,7 @@ CodecChecker::DecodeStage CodecChecker::decodeStreamFrame(Buffer::Instance& buff
   buffer.copyOut(TrpcFixedHeader::TRPC_PROTO_PREFIX_SPACE, frame_size, &(header_raw[0]));
 
   if (!call_backs_.onStreamFrame(std::move(header_raw))) {
-    throw EnvoyException("parse header failed");
+    return onError("parse header failed");
   }
 
   return DecodeStage::kDecodePayload;
@@ -10,6 +10,8 @@
 #include "envoy/network/filter.h"
 #include "envoy/server/filter_config.h"
 
+#include "absl/strings/string_view.h"
+
 #include "src/application_protocols/trpc/protocol.h"
 #include "src/application_protocols/trpc/trpc.pb.h"
 
@@ -64,7 +66,8 @@ public:
     KDecodeStreamFrame,
     kDecodePayload,
     kDecodeDone,
-    kWaitForData
+    kWaitForData,
+    kDecodeError
   };
 
 public:
@@ -72,12 +75,17 @@ public:
   ~CodecChecker() = default;
 
   /**
-   * 对外提供的接口，如果不是trpc协议，则throw EnvoyException。
+   * 对外提供的接口，如果不是trpc协议，则返回kDecodeError, 错误原因见errorDetail()。
    * @param data 输入数据。
    * @return DecodeStage
    */
   DecodeStage onData(Buffer::Instance& data);
 
+  /**
+   * @return 最近一次kDecodeError的错误原因
+   */
+  const std::string& errorDetail() const { return error_detail_; }
+
 private:
   /**
    *
@@ -86,6 +94,13 @@ private:
    */
   DecodeStage handleState(Buffer::Instance& buffer);
 
+  /**
+   * 记录错误原因并重置状态。
+   * @param detail 错误原因
+   * @return kDecodeError
+   */
+  DecodeStage onError(absl::string_view detail);
+
   /**
    * 检查帧头。
    * @param buffer 输入数据
@@ -132,6 +147,8 @@ private:
   uint16_t protocol_header_size_{0};
   // 回调函数
   CodecCheckerCallBacks& call_backs_;
+  // 错误原因
+  std::string error_detail_;
 };
 
 } // namespace Trpc
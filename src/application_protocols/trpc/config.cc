@@ -10,8 +10,12 @@ namespace NetworkFilters {
 namespace MetaProtocolProxy {
 namespace Trpc {
 
-MetaProtocolProxy::CodecPtr TrpcCodecConfig::createCodec(const Protobuf::Message&) {
-  return std::make_unique<Trpc::TrpcCodec>();
+MetaProtocolProxy::ProtocolDecoderPtr TrpcCodecConfig::createDecoder(const Protobuf::Message&) {
+  return std::make_unique<Trpc::TrpcDecoder>();
+};
+
+MetaProtocolProxy::EncoderSharedPtr TrpcCodecConfig::createEncoder(const Protobuf::Message&) {
+  return std::make_shared<Trpc::TrpcEncoder>();
 };
 
 /**
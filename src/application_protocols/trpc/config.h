@@ -14,7 +14,8 @@ class TrpcCodecConfig
     : public MetaProtocolProxy::CodecFactoryBase<aeraki::meta_protocol::codec::TrpcCodec> {
 public:
   TrpcCodecConfig() : CodecFactoryBase("aeraki.meta_protocol.codec.trpc") {}
-  MetaProtocolProxy::CodecPtr createCodec(const Protobuf::Message& config) override;
+  MetaProtocolProxy::ProtocolDecoderPtr createDecoder(const Protobuf::Message& config) override;
+  MetaProtocolProxy::EncoderSharedPtr createEncoder(const Protobuf::Message& config) override;
 };
 
 } // namespace Trpc
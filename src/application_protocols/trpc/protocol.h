@@ -7,6 +7,7 @@
 #include "source/common/common/logger.h"
 
 #include "src/meta_protocol_proxy/codec/codec.h"
+#include "src/meta_protocol_proxy/codec/length_prefixed_framer.h"
 #include "src/application_protocols/trpc/metadata.h"
 #include "src/application_protocols/trpc/trpc.pb.h"
 
@@ -88,6 +89,21 @@ struct TrpcFixedHeader : public Logger::Loggable<Logger::Id::filter> {
   [[nodiscard]] uint32_t getPayloadSize() const { return data_frame_size - getHeaderSize(); }
 };
 
+// 固定帧头中各字段的偏移:
+// 魔数(2) + 帧类型(1) + 流式帧类型(1) + 数据帧总大小(4) + 包头大小(2) + 流id(4) + 保留字段(2)
+struct TrpcHeaderOffset {
+  static constexpr uint64_t MAGIC = 0;
+  static constexpr uint64_t DATA_FRAME_TYPE = 2;
+  static constexpr uint64_t STREAM_FRAME_TYPE = 3;
+  static constexpr uint64_t DATA_FRAME_SIZE = 4;
+  static constexpr uint64_t PB_HEADER_SIZE = 8;
+  static constexpr uint64_t STREAM_ID = 10;
+};
+
+// tRPC数据帧的分帧器: 16字节固定帧头, 数据帧总大小包含固定帧头
+using TrpcFramer = LengthPrefixedFramer<uint16_t, trpc::TrpcMagic::TRPC_MAGIC_VALUE, 16,
+                                        TrpcHeaderOffset::DATA_FRAME_SIZE, uint32_t>;
+
 template <typename T> class Protocol : public Logger::Loggable<Logger::Id::filter> {
 public:
   Protocol() = default;
@@ -171,7 +187,7 @@ inline unsigned int to_uint(char ch)
 }
   /**
    * 修改 Header
-   * @param buff
+   * @param buff 完整的消息, 或者包体边收边转发的请求的头部(帧头 + pb协议头), 包体长度保持不变
    */
   bool mutateHeader(Buffer::Instance& buff, const MetaProtocolProxy::Mutation& mutation) {
     auto ptr_size = buff.length();
@@ -182,10 +198,11 @@ inline unsigned int to_uint(char ch)
       return false;
     }
 
-    if (ptr_size < fixed_header_.data_frame_size) {
-      ENVOY_LOG(error, "decode ptr_size:{} < {}.", ptr_size, fixed_header_.data_frame_size);
+    if (ptr_size < fixed_header_.getHeaderSize()) {
+      ENVOY_LOG(error, "decode ptr_size:{} < {}.", ptr_size, fixed_header_.getHeaderSize());
       return false;
     }
+    const uint32_t payload_size = fixed_header_.getPayloadSize();
 
     // 解析 protocol header
     std::string header_raw;
@@ -199,9 +216,9 @@ inline unsigned int to_uint(char ch)
       return false;
     }
 
-    // 保留 body
+    // 保留 body (可能还没有收到)
     Buffer::OwnedImpl body;
-    body.move(buff, static_cast<uint64_t>(fixed_header_.getPayloadSize()));
+    body.move(buff);
     
     // 修改/添加消息头
     auto trans_info = protocol_header_.mutable_trans_info();
@@ -211,7 +228,7 @@ inline unsigned int to_uint(char ch)
     
     // 修改 fixed header 中的协议头长度
     fixed_header_.pb_header_size = protocol_header_.ByteSizeLong();
-    fixed_header_.data_frame_size = fixed_header_.getHeaderSize() + body.length();
+    fixed_header_.data_frame_size = fixed_header_.getHeaderSize() + payload_size;
 
     // 编码修改后的消息 
     fixed_header_.encode(buff);
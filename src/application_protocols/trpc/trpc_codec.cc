@@ -4,6 +4,9 @@
 
 #include "source/common/common/logger.h"
 
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/wire_format_lite.h"
+
 #include "src/meta_protocol_proxy/codec/codec.h"
 #include "src/application_protocols/trpc/trpc_codec.h"
 #include "src/application_protocols/trpc/protocol.h"
@@ -13,9 +16,55 @@ namespace Extensions {
 namespace NetworkFilters {
 namespace MetaProtocolProxy {
 namespace Trpc {
+namespace {
+
+// 解析流式帧头之后的pb数据, 不修改buffer
+template <typename T>
+bool parseStreamFrameMeta(const Buffer::Instance& buffer, uint64_t length, T& meta) {
+  std::string meta_raw(length, '\0');
+  buffer.copyOut(TrpcFramer::headerSize(), length, &(meta_raw[0]));
+  return meta.ParseFromString(meta_raw);
+}
+
+// 反馈帧的pb数据通常只有窗口增量一个字段, 拷贝到栈上直接读取, 不需要分配内存和构造pb消息
+constexpr uint64_t MaxInlineFeedbackMetaSize = 32;
+
+bool parseWindowSizeIncrement(const Buffer::Instance& buffer, uint64_t length,
+                              uint32_t& increment) {
+  if (length > MaxInlineFeedbackMetaSize) {
+    trpc::TrpcStreamFeedBackMeta feedback_meta;
+    if (!parseStreamFrameMeta(buffer, length, feedback_meta)) {
+      return false;
+    }
+    increment = feedback_meta.window_size_increment();
+    return true;
+  }
+
+  using google::protobuf::internal::WireFormatLite;
+  const uint32_t window_size_increment_tag =
+      WireFormatLite::MakeTag(trpc::TrpcStreamFeedBackMeta::kWindowSizeIncrementFieldNumber,
+                              WireFormatLite::WIRETYPE_VARINT);
+
+  uint8_t meta_raw[MaxInlineFeedbackMetaSize];
+  buffer.copyOut(TrpcFramer::headerSize(), length, meta_raw);
+  google::protobuf::io::CodedInputStream input(meta_raw, static_cast<int>(length));
+  increment = 0;
+  while (const uint32_t tag = input.ReadTag()) {
+    if (tag == window_size_increment_tag) {
+      if (!input.ReadVarint32(&increment)) {
+        return false;
+      }
+    } else if (!WireFormatLite::SkipField(&input, tag)) {
+      return false;
+    }
+  }
+  return input.ConsumedEntireMessage();
+}
+
+} // namespace
 
-MetaProtocolProxy::DecodeStatus TrpcCodec::decode(Buffer::Instance& buffer,
-                                                  MetaProtocolProxy::Metadata& metadata) {
+MetaProtocolProxy::DecodeStatus TrpcDecoder::decode(Buffer::Instance& buffer,
+                                                    MetaProtocolProxy::Metadata& metadata) {
   ENVOY_LOG(debug, "trpc decoder: {} bytes available", buffer.length());
   messageType_ = metadata.getMessageType();
   ASSERT(messageType_ == MetaProtocolProxy::MessageType::Request ||
@@ -27,13 +76,123 @@ MetaProtocolProxy::DecodeStatus TrpcCodec::decode(Buffer::Instance& buffer,
     ENVOY_LOG(debug, "trpc decoder: wait for data");
     return DecodeStatus::WaitForData;
   }
+  if (state == CodecChecker::DecodeStage::kDecodeError) {
+    return DecodeStatus::Error;
+  }
   ASSERT(state == CodecChecker::DecodeStage::kDecodeDone);
   toMetadata(metadata);
   return DecodeStatus::Done;
 }
 
-void TrpcCodec::encode(const MetaProtocolProxy::Metadata& metadata,
-                       const MetaProtocolProxy::Mutation& mutation, Buffer::Instance& buffer) {
+uint64_t TrpcDecoder::decodeHead(Buffer::Instance& buffer, MetaProtocolProxy::Metadata& metadata) {
+  // 只有一元请求的包体可以边收边转发, 流式帧都很小
+  if (metadata.getMessageType() != MetaProtocolProxy::MessageType::Request) {
+    return 0;
+  }
+  auto fixed_header = std::make_unique<TrpcFixedHeader>();
+  if (!fixed_header->decode(buffer, false) ||
+      fixed_header->stream_frame_type != trpc::TrpcStreamFrameType::TRPC_UNARY ||
+      buffer.length() < fixed_header->getHeaderSize()) {
+    return 0;
+  }
+
+  std::string header_raw;
+  header_raw.resize(fixed_header->pb_header_size);
+  buffer.copyOut(TrpcFixedHeader::TRPC_PROTO_PREFIX_SPACE, fixed_header->pb_header_size,
+                 &(header_raw[0]));
+  if (!requestHeader_.ParseFromString(header_raw)) {
+    // 交给decode在收到完整的消息后报错
+    return 0;
+  }
+
+  ENVOY_LOG(debug, "trpc decoder: decoded the head of a {} bytes request",
+            fixed_header->data_frame_size);
+  const uint64_t head_length = fixed_header->getHeaderSize();
+  messageType_ = MetaProtocolProxy::MessageType::Request;
+  fixed_header_ = std::move(fixed_header);
+  origin_msg_ = std::make_unique<Buffer::OwnedImpl>();
+  origin_msg_->move(buffer, head_length);
+  toMetadata(metadata);
+  return head_length;
+}
+
+absl::optional<uint64_t> TrpcDecoder::headLength(const Buffer::Instance& buffer) {
+  if (buffer.length() < TrpcFramer::headerSize()) {
+    return 0;
+  }
+  // 只有一元请求的包体可以边收边转发, 流式帧都很小
+  if (TrpcFramer::peek<uint8_t>(buffer, TrpcHeaderOffset::STREAM_FRAME_TYPE) !=
+      trpc::TrpcStreamFrameType::TRPC_UNARY) {
+    return absl::nullopt;
+  }
+  return TrpcFramer::headerSize() +
+         TrpcFramer::peek<uint16_t>(buffer, TrpcHeaderOffset::PB_HEADER_SIZE);
+}
+
+bool TrpcDecoder::isStreamDataFrame(const Buffer::Instance& buffer) {
+  // 数据帧和反馈帧不改变流的状态, 不需要解码
+  if (buffer.length() < TrpcFramer::headerSize() ||
+      TrpcFramer::peek<uint8_t>(buffer, TrpcHeaderOffset::DATA_FRAME_TYPE) !=
+          trpc::TrpcDataFrameType::TRPC_STREAM_FRAME) {
+    return false;
+  }
+  const uint8_t stream_frame_type =
+      TrpcFramer::peek<uint8_t>(buffer, TrpcHeaderOffset::STREAM_FRAME_TYPE);
+  return stream_frame_type == trpc::TrpcStreamFrameType::TRPC_STREAM_FRAME_DATA ||
+         stream_frame_type == trpc::TrpcStreamFrameType::TRPC_STREAM_FRAME_FEEDBACK;
+}
+
+MetaProtocolProxy::StreamFrameCredit
+TrpcDecoder::streamFrameCredit(const Buffer::Instance& buffer) {
+  MetaProtocolProxy::StreamFrameCredit credit;
+  const uint64_t frame_length = TrpcFramer::frameLength(buffer);
+  if (frame_length == 0 || buffer.length() < frame_length ||
+      TrpcFramer::peek<uint8_t>(buffer, TrpcHeaderOffset::DATA_FRAME_TYPE) !=
+          trpc::TrpcDataFrameType::TRPC_STREAM_FRAME) {
+    return credit;
+  }
+
+  // 流式帧 = 固定帧头 + 数据帧的业务数据或其它帧的pb数据
+  const uint64_t body_length = frame_length - TrpcFramer::headerSize();
+  switch (TrpcFramer::peek<uint8_t>(buffer, TrpcHeaderOffset::STREAM_FRAME_TYPE)) {
+  case trpc::TrpcStreamFrameType::TRPC_STREAM_FRAME_INIT: {
+    // 接收端在INIT帧中通告初始窗口, 0表示不做流控
+    trpc::TrpcStreamInitMeta init_meta;
+    if (parseStreamFrameMeta(buffer, body_length, init_meta)) {
+      credit.initial_window = init_meta.init_window_size();
+    }
+    break;
+  }
+  case trpc::TrpcStreamFrameType::TRPC_STREAM_FRAME_FEEDBACK: {
+    // 反馈帧在流控生效时每个窗口都会收到一个, 避免每次都分配内存
+    uint32_t window_increment;
+    if (parseWindowSizeIncrement(buffer, body_length, window_increment)) {
+      credit.window_increment = window_increment;
+    }
+    break;
+  }
+  case trpc::TrpcStreamFrameType::TRPC_STREAM_FRAME_DATA:
+    credit.consumed = body_length;
+    break;
+  default:
+    break;
+  }
+  return credit;
+}
+
+absl::optional<uint64_t> TrpcDecoder::streamId(const Buffer::Instance& buffer) {
+  if (buffer.length() < TrpcFramer::headerSize() ||
+      TrpcFramer::peek<uint16_t>(buffer, TrpcHeaderOffset::MAGIC) !=
+          trpc::TrpcMagic::TRPC_MAGIC_VALUE ||
+      TrpcFramer::peek<uint8_t>(buffer, TrpcHeaderOffset::DATA_FRAME_TYPE) !=
+          trpc::TrpcDataFrameType::TRPC_STREAM_FRAME) {
+    return absl::nullopt;
+  }
+  return TrpcFramer::peek<uint32_t>(buffer, TrpcHeaderOffset::STREAM_ID);
+}
+
+void TrpcEncoder::encode(const MetaProtocolProxy::Metadata& metadata,
+                         const MetaProtocolProxy::Mutation& mutation, Buffer::Instance& buffer) {
   if (mutation.size() < 1) {
     return;
   }
@@ -53,13 +212,16 @@ void TrpcCodec::encode(const MetaProtocolProxy::Metadata& metadata,
   }
 }
 
-void TrpcCodec::onError(const MetaProtocolProxy::Metadata& metadata,
-                        const MetaProtocolProxy::Error& error, Buffer::Instance& buffer) {
+void TrpcEncoder::onError(const MetaProtocolProxy::Metadata& metadata,
+                          const MetaProtocolProxy::Error& error, Buffer::Instance& buffer) {
   int32_t errCode;
   switch (error.type) {
   case MetaProtocolProxy::ErrorType::RouteNotFound:
     errCode = trpc::TRPC_SERVER_NOSERVICE_ERR;
     break;
+  case MetaProtocolProxy::ErrorType::ServerBusy:
+    errCode = trpc::TRPC_SERVER_OVERLOAD_ERR;
+    break;
   default:
     errCode = trpc::TRPC_SERVER_SYSTEM_ERR;
   }
@@ -94,12 +256,12 @@ void TrpcCodec::onError(const MetaProtocolProxy::Metadata& metadata,
   }
 }
 
-void TrpcCodec::onFixedHeaderDecoded(std::unique_ptr<TrpcFixedHeader> fixed_header) {
+void TrpcDecoder::onFixedHeaderDecoded(std::unique_ptr<TrpcFixedHeader> fixed_header) {
   fixed_header_ = std::move(fixed_header);
   ENVOY_LOG(debug, "trpc decoder: stream id {}", fixed_header_->stream_id);
 }
 
-bool TrpcCodec::onUnaryHeader(std::string&& header_raw) {
+bool TrpcDecoder::onUnaryHeader(std::string&& header_raw) {
   ASSERT(fixed_header_->stream_frame_type == trpc::TrpcStreamFrameType::TRPC_UNARY);
   if (messageType_ == MetaProtocolProxy::MessageType::Request) {
     return requestHeader_.ParseFromString(header_raw);
@@ -107,7 +269,7 @@ bool TrpcCodec::onUnaryHeader(std::string&& header_raw) {
   return responseHeader_.ParseFromString(header_raw);
 }
 
-bool TrpcCodec::onStreamFrame(std::string&& header_raw) {
+bool TrpcDecoder::onStreamFrame(std::string&& header_raw) {
   ASSERT(fixed_header_->stream_frame_type == trpc::TrpcStreamFrameType::TRPC_STREAM_FRAME_INIT ||
          fixed_header_->stream_frame_type == trpc::TrpcStreamFrameType::TRPC_STREAM_FRAME_CLOSE ||
          fixed_header_->stream_frame_type ==
@@ -127,11 +289,11 @@ bool TrpcCodec::onStreamFrame(std::string&& header_raw) {
   return true;
 }
 
-void TrpcCodec::onCompleted(std::unique_ptr<Buffer::OwnedImpl> buffer) {
+void TrpcDecoder::onCompleted(std::unique_ptr<Buffer::OwnedImpl> buffer) {
   origin_msg_ = std::move(buffer);
 }
 
-void TrpcCodec::toMetadata(MetaProtocolProxy::Metadata& metadata) {
+void TrpcDecoder::toMetadata(MetaProtocolProxy::Metadata& metadata) {
   metadata.setHeaderSize(fixed_header_->getHeaderSize());
   metadata.setBodySize(fixed_header_->getPayloadSize());
 
@@ -152,6 +314,10 @@ void TrpcCodec::toMetadata(MetaProtocolProxy::Metadata& metadata) {
     } else {
       metadata.setRequestId(responseHeader_.request_id());
       metadata.putString("error_msg", responseHeader_.error_msg());
+      if (responseHeader_.ret() == trpc::TRPC_SERVER_OVERLOAD_ERR ||
+          responseHeader_.ret() == trpc::TRPC_SERVER_LIMITED_ERR) {
+        metadata.setResponseStatus(MetaProtocolProxy::ResponseStatus::ServerBusy);
+      }
       for (auto const& kv : responseHeader_.trans_info()) {
         metadata.putString(kv.first, kv.second);
       }
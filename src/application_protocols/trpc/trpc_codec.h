@@ -21,21 +21,27 @@ namespace MetaProtocolProxy {
 namespace Trpc {
 
 /**
- * Codec for Trpc protocol.
+ * Decoder for Trpc protocol.
  */
-class TrpcCodec : public MetaProtocolProxy::Codec,
-                  public CodecCheckerCallBacks,
-                  public Logger::Loggable<Logger::Id::misc> {
+class TrpcDecoder : public MetaProtocolProxy::ProtocolDecoder,
+                    public CodecCheckerCallBacks,
+                    public Logger::Loggable<Logger::Id::misc> {
 public:
-  TrpcCodec() : decoder_base_(*this), messageType_(MetaProtocolProxy::MessageType::Request){};
-  ~TrpcCodec() override = default;
+  TrpcDecoder() : decoder_base_(*this), messageType_(MetaProtocolProxy::MessageType::Request){};
+  ~TrpcDecoder() override = default;
 
   MetaProtocolProxy::DecodeStatus decode(Buffer::Instance& buffer,
                                          MetaProtocolProxy::Metadata& metadata) override;
-  void encode(const MetaProtocolProxy::Metadata& metadata,
-              const MetaProtocolProxy::Mutation& mutation, Buffer::Instance& buffer) override;
-  void onError(const MetaProtocolProxy::Metadata& metadata, const MetaProtocolProxy::Error& error,
-               Buffer::Instance& buffer) override;
+  uint64_t frameLength(const Buffer::Instance& buffer) override {
+    return TrpcFramer::frameLength(buffer);
+  }
+  std::string errorDetail() const override { return decoder_base_.errorDetail(); }
+  uint64_t decodeHead(Buffer::Instance& buffer, MetaProtocolProxy::Metadata& metadata) override;
+  absl::optional<uint64_t> headLength(const Buffer::Instance& buffer) override;
+  bool isStreamDataFrame(const Buffer::Instance& buffer) override;
+  MetaProtocolProxy::StreamFrameCredit
+  streamFrameCredit(const Buffer::Instance& buffer) override;
+  absl::optional<uint64_t> streamId(const Buffer::Instance& buffer) override;
   void onFixedHeaderDecoded(std::unique_ptr<TrpcFixedHeader> fixed_header) override;
   bool onUnaryHeader(std::string&& header_raw) override;
   bool onStreamFrame(std::string&& header_raw) override;
@@ -55,6 +61,18 @@ private:
   MetaProtocolProxy::MessageType messageType_;
 };
 
+/**
+ * Encoder for Trpc protocol. It only rewrites the header of the message being forwarded or builds
+ * an error response, nothing is kept between calls.
+ */
+class TrpcEncoder : public MetaProtocolProxy::Encoder, public Logger::Loggable<Logger::Id::misc> {
+public:
+  void encode(const MetaProtocolProxy::Metadata& metadata,
+              const MetaProtocolProxy::Mutation& mutation, Buffer::Instance& buffer) override;
+  void onError(const MetaProtocolProxy::Metadata& metadata, const MetaProtocolProxy::Error& error,
+               Buffer::Instance& buffer) override;
+};
+
 } // namespace Trpc
 } // namespace MetaProtocolProxy
 } // namespace NetworkFilters
@@ -0,0 +1,211 @@
+#include "src/meta_protocol_proxy/access_log/binary_access_log.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+#include "envoy/upstream/upstream.h"
+
+#include "source/common/common/utility.h"
+
+#include "source/common/protobuf/utility.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+
+BinaryLogRecordRing::BinaryLogRecordRing(uint32_t size)
+    : records_(1ULL << (64 - __builtin_clzll(std::max<uint64_t>(size, 2) - 1))),
+      mask_(records_.size() - 1) {}
+
+BinaryAccessLog::BinaryAccessLog(
+    const aeraki::meta_protocol_proxy::v1alpha::BinaryAccessLog& config, Api::Api& api,
+    ThreadLocal::SlotAllocator& tls, Stats::Counter& dropped)
+    : path_(config.path()),
+      flush_interval_(PROTOBUF_GET_MS_OR_DEFAULT(config, flush_interval, 1000)), api_(api),
+      time_source_(api.timeSource()), dropped_(dropped),
+      registry_(std::make_shared<RingRegistry>()), tls_(tls.allocateSlot()) {
+  const uint32_t ring_buffer_size = PROTOBUF_GET_WRAPPED_OR_DEFAULT(config, ring_buffer_size, 4096);
+  tls_->set([registry = registry_, size = ring_buffer_size](
+                Event::Dispatcher&) -> ThreadLocal::ThreadLocalObjectSharedPtr {
+    auto ring = std::make_shared<BinaryLogRecordRing>(size);
+    absl::MutexLock lock(&registry->lock_);
+    registry->rings_.push_back(ring);
+    return std::make_shared<ThreadLocalRing>(std::move(ring));
+  });
+  writer_thread_ = api_.threadFactory().createThread([this]() { writerLoop(); });
+}
+
+BinaryAccessLog::~BinaryAccessLog() {
+  {
+    absl::MutexLock lock(&wakeup_lock_);
+    shutdown_ = true;
+  }
+  writer_thread_->join();
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+void BinaryAccessLog::log(const Metadata& request, const Metadata* response, int response_code,
+                          const StreamInfo::StreamInfo& stream_info) {
+  auto& ring = *tls_->getTyped<ThreadLocalRing>().ring_;
+  BinaryLogRecord* record = ring.tail();
+  if (record == nullptr) {
+    dropped_.inc();
+    return;
+  }
+
+  record->start_time_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                              stream_info.startTime().time_since_epoch())
+                              .count();
+  record->duration_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                            time_source_.monotonicTime() - stream_info.startTimeMonotonic())
+                            .count();
+  record->request_id = request.getRequestId();
+  record->request_size = request.getMessageSize();
+  record->response_size = response != nullptr ? response->getMessageSize() : 0;
+  record->response_code = response_code;
+  record->message_type = static_cast<uint8_t>(request.getMessageType());
+
+  const std::string operation_name = request.getOperationName();
+  BinaryAccessLogFormat::setString(record->operation_name, record->operation_name_length,
+                                   operation_name.data(), operation_name.size());
+  record->cluster_name_length = 0;
+  const auto& cluster_info = stream_info.upstreamClusterInfo();
+  if (cluster_info.has_value() && cluster_info.value() != nullptr) {
+    const std::string& cluster_name = cluster_info.value()->name();
+    BinaryAccessLogFormat::setString(record->cluster_name, record->cluster_name_length,
+                                     cluster_name.data(), cluster_name.size());
+  }
+  record->upstream_host_length = 0;
+  if (stream_info.upstreamInfo() && stream_info.upstreamInfo()->upstreamHost()) {
+    const absl::string_view host =
+        stream_info.upstreamInfo()->upstreamHost()->address()->asStringView();
+    BinaryAccessLogFormat::setString(record->upstream_host, record->upstream_host_length,
+                                     host.data(), host.size());
+  }
+
+  // The ring would overflow before the end of the flush interval under a high request rate, so the
+  // writer is woken up once it's half full. It takes a lock, but only once per half ring.
+  if (ring.push() == ring.capacity() / 2) {
+    requestFlush();
+  }
+}
+
+void BinaryAccessLog::requestFlush() {
+  absl::MutexLock lock(&wakeup_lock_);
+  flush_requested_ = true;
+}
+
+void BinaryAccessLog::writerLoop() {
+  while (true) {
+    bool shutdown;
+    {
+      absl::MutexLock lock(&wakeup_lock_);
+      wakeup_lock_.AwaitWithTimeout(absl::Condition(this, &BinaryAccessLog::wakeupRequested),
+                                    absl::FromChrono(flush_interval_));
+      shutdown = shutdown_;
+      flush_requested_ = false;
+    }
+    // the last flush writes what the workers have logged before the shutdown
+    flush();
+    if (shutdown) {
+      return;
+    }
+  }
+}
+
+void BinaryAccessLog::flush() {
+  std::vector<BinaryLogRecordRingSharedPtr> rings;
+  {
+    absl::MutexLock lock(&registry_->lock_);
+    rings = registry_->rings_;
+  }
+
+  batch_.clear();
+  uint64_t records = 0;
+  for (const auto& ring : rings) {
+    ring->drain([this, &records](const BinaryLogRecord& record) {
+      BinaryAccessLogFormat::appendRecord(batch_, record);
+      records++;
+    });
+  }
+  if (records == 0 && pending_.empty()) {
+    return;
+  }
+
+  // The file is retried at the next flush if it can't be opened, e.g. a named pipe without a
+  // reader.
+  if (fd_ < 0 && !openFile()) {
+    dropped_.add(records);
+    return;
+  }
+  // The rest of the previous batch goes first so the records are never split. The new records are
+  // dropped while the collector hasn't read it.
+  if (!writePending()) {
+    dropped_.add(records);
+    return;
+  }
+  pending_.swap(batch_);
+  if (!writePending() && fd_ < 0) {
+    dropped_.add(records);
+  }
+}
+
+bool BinaryAccessLog::openFile() {
+  // Opening a named pipe without a reader fails with ENXIO instead of blocking, and writing to a
+  // full pipe fails with EAGAIN. O_NONBLOCK has no effect on regular files.
+  const int fd =
+      ::open(path_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_NONBLOCK | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    ENVOY_LOG(error, "meta protocol binary access log: failed to open {}: {}", path_,
+              errorDetails(errno));
+    return false;
+  }
+
+  // The header is only written at the start of a file, the records are appended otherwise. A
+  // named pipe starts anew each time it's opened.
+  struct stat file_stat;
+  if (::fstat(fd, &file_stat) == 0 && (S_ISFIFO(file_stat.st_mode) || file_stat.st_size == 0)) {
+    pending_.clear();
+    BinaryAccessLogFormat::appendFileHeader(pending_);
+  }
+  fd_ = fd;
+  return true;
+}
+
+bool BinaryAccessLog::writePending() {
+  size_t written = 0;
+  while (written < pending_.size()) {
+    const ssize_t result = ::write(fd_, pending_.data() + written, pending_.size() - written);
+    if (result >= 0) {
+      written += result;
+      continue;
+    }
+    if (errno == EINTR) {
+      continue;
+    }
+    if (errno != EAGAIN) {
+      ENVOY_LOG(error, "meta protocol binary access log: failed to write {}: {}", path_,
+                errorDetails(errno));
+      // reopen the file at the next flush, e.g. the collector reading a named pipe may have
+      // restarted
+      ::close(fd_);
+      fd_ = -1;
+      pending_.clear();
+      return false;
+    }
+    break;
+  }
+  pending_.erase(0, written);
+  return pending_.empty();
+}
+
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
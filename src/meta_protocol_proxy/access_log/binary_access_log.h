@@ -0,0 +1,165 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "api/meta_protocol_proxy/v1alpha/meta_protocol_proxy.pb.h"
+
+#include "envoy/api/api.h"
+#include "envoy/stats/stats.h"
+#include "envoy/stream_info/stream_info.h"
+#include "envoy/thread/thread.h"
+#include "envoy/thread_local/thread_local.h"
+
+#include "source/common/common/logger.h"
+
+#include "src/meta_protocol_proxy/access_log/binary_access_log_format.h"
+#include "src/meta_protocol_proxy/codec/codec.h"
+
+#include "absl/synchronization/mutex.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+
+using BinaryLogRecord = BinaryAccessLogFormat::BinaryLogRecord;
+
+/**
+ * A bounded single-producer single-consumer queue of records. The producer is the worker which
+ * owns the ring, and the consumer is the writer thread of the binary access log, so neither of
+ * them takes a lock. The records are preallocated and filled in place.
+ */
+class BinaryLogRecordRing {
+public:
+  // the size is rounded up to a power of two so the positions wrap with a mask
+  explicit BinaryLogRecordRing(uint32_t size);
+
+  /**
+   * Called by the producer.
+   * @return the record to fill at the tail of the ring, nullptr if the ring is full.
+   */
+  BinaryLogRecord* tail() {
+    const uint64_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == records_.size()) {
+      return nullptr;
+    }
+    return &records_[tail & mask_];
+  }
+
+  /**
+   * Called by the producer after filling the record returned by tail() to publish it.
+   * @return the number of records in the ring, including the published one.
+   */
+  uint64_t push() {
+    const uint64_t tail = tail_.load(std::memory_order_relaxed) + 1;
+    tail_.store(tail, std::memory_order_release);
+    return tail - head_.load(std::memory_order_relaxed);
+  }
+
+  uint64_t capacity() const { return records_.size(); }
+
+  /**
+   * Called by the consumer to pass the published records to the callback and free their slots.
+   */
+  template <typename Callback> void drain(Callback callback) {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    const uint64_t tail = tail_.load(std::memory_order_acquire);
+    for (; head != tail; head++) {
+      callback(records_[head & mask_]);
+    }
+    head_.store(head, std::memory_order_release);
+  }
+
+private:
+  std::vector<BinaryLogRecord> records_;
+  const uint64_t mask_;
+  // the positions only increase, they are kept on separate cache lines so the producer and the
+  // consumer don't invalidate each other's
+  alignas(64) std::atomic<uint64_t> head_{0};
+  alignas(64) std::atomic<uint64_t> tail_{0};
+};
+
+using BinaryLogRecordRingSharedPtr = std::shared_ptr<BinaryLogRecordRing>;
+
+/**
+ * BinaryAccessLog writes a fixed-layout binary record per request, @see BinaryAccessLogFormat.
+ * The workers append the records to their own ring buffers, and a background thread drains the
+ * rings and writes the records to the file in batches every flush interval, or as soon as a ring
+ * is half full under a high request rate. A record is dropped if the ring of its worker is full,
+ * or if the file can't be written.
+ *
+ * The file is opened in non-blocking mode, so a named pipe without a reader or a collector which
+ * doesn't keep up never blocks the writer thread, and the access log can always be destroyed.
+ */
+class BinaryAccessLog : public Logger::Loggable<Logger::Id::filter> {
+public:
+  BinaryAccessLog(const aeraki::meta_protocol_proxy::v1alpha::BinaryAccessLog& config,
+                  Api::Api& api, ThreadLocal::SlotAllocator& tls, Stats::Counter& dropped);
+  ~BinaryAccessLog();
+
+  /**
+   * Append the record of a request to the ring of the current worker.
+   * @param request the request.
+   * @param response the response, nullptr if there isn't one.
+   * @param response_code the response code of the request.
+   * @param stream_info the stream info of the request.
+   */
+  void log(const Metadata& request, const Metadata* response, int response_code,
+           const StreamInfo::StreamInfo& stream_info);
+
+private:
+  // The rings of the workers. It's shared with the thread local objects, so the rings can be
+  // registered after the access log has gone.
+  struct RingRegistry {
+    absl::Mutex lock_;
+    std::vector<BinaryLogRecordRingSharedPtr> rings_ ABSL_GUARDED_BY(lock_);
+  };
+  using RingRegistrySharedPtr = std::shared_ptr<RingRegistry>;
+
+  struct ThreadLocalRing : public ThreadLocal::ThreadLocalObject {
+    ThreadLocalRing(BinaryLogRecordRingSharedPtr ring) : ring_(std::move(ring)) {}
+    const BinaryLogRecordRingSharedPtr ring_;
+  };
+
+  void writerLoop();
+  // wake the writer thread up before the end of the flush interval
+  void requestFlush();
+  bool wakeupRequested() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(wakeup_lock_) {
+    return shutdown_ || flush_requested_;
+  }
+  void flush();
+  bool openFile();
+  // Write pending_ to the file. Returns false if it couldn't be written completely, either because
+  // the named pipe is full or because of an error, in which case the file is closed.
+  bool writePending();
+
+  const std::string path_;
+  const std::chrono::milliseconds flush_interval_;
+  Api::Api& api_;
+  TimeSource& time_source_;
+  Stats::Counter& dropped_;
+  const RingRegistrySharedPtr registry_;
+  ThreadLocal::SlotPtr tls_;
+
+  // only accessed by the writer thread
+  int fd_{-1};
+  std::string batch_;
+  // the bytes not written yet, e.g. the rest of a batch a slow collector didn't read
+  std::string pending_;
+
+  absl::Mutex wakeup_lock_;
+  bool shutdown_ ABSL_GUARDED_BY(wakeup_lock_){false};
+  bool flush_requested_ ABSL_GUARDED_BY(wakeup_lock_){false};
+  Thread::ThreadPtr writer_thread_;
+};
+
+using BinaryAccessLogSharedPtr = std::shared_ptr<BinaryAccessLog>;
+
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
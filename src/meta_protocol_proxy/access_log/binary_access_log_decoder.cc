@@ -0,0 +1,102 @@
+// Converts a binary access log of the meta protocol proxy to JSON, one object per line.
+//
+// Usage: binary_access_log_decoder <path>, or read from the standard input if there is no path.
+
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+#include "src/meta_protocol_proxy/access_log/binary_access_log_format.h"
+
+namespace {
+
+using Envoy::Extensions::NetworkFilters::MetaProtocolProxy::BinaryAccessLogFormat::
+    BinaryLogRecord;
+namespace Format = Envoy::Extensions::NetworkFilters::MetaProtocolProxy::BinaryAccessLogFormat;
+
+void appendJsonString(std::string& out, const char* data, size_t size) {
+  out.push_back('"');
+  for (size_t i = 0; i < size; i++) {
+    const unsigned char c = data[i];
+    if (c == '"' || c == '\\') {
+      out.push_back('\\');
+      out.push_back(c);
+    } else if (c < 0x20) {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      out.append(escaped);
+    } else {
+      out.push_back(c);
+    }
+  }
+  out.push_back('"');
+}
+
+std::string toJson(const BinaryLogRecord& record) {
+  char fixed_fields[256];
+  snprintf(fixed_fields, sizeof(fixed_fields),
+           "{\"start_time_us\":%" PRIu64 ",\"duration_us\":%" PRIu64 ",\"request_id\":%" PRIu64
+           ",\"request_size\":%" PRIu32 ",\"response_size\":%" PRIu32
+           ",\"response_code\":%" PRId32 ",\"message_type\":%u",
+           record.start_time_us, record.duration_us, record.request_id, record.request_size,
+           record.response_size, record.response_code,
+           static_cast<unsigned int>(record.message_type));
+  std::string json(fixed_fields);
+  json.append(",\"operation_name\":");
+  appendJsonString(json, record.operation_name, record.operation_name_length);
+  json.append(",\"cluster_name\":");
+  appendJsonString(json, record.cluster_name, record.cluster_name_length);
+  json.append(",\"upstream_host\":");
+  appendJsonString(json, record.upstream_host, record.upstream_host_length);
+  json.push_back('}');
+  return json;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  if (argc > 2) {
+    std::cerr << "usage: " << argv[0] << " [binary access log]" << std::endl;
+    return 1;
+  }
+
+  std::string data;
+  if (argc == 2) {
+    std::ifstream file(argv[1], std::ios::binary);
+    if (!file) {
+      std::cerr << "failed to open " << argv[1] << std::endl;
+      return 1;
+    }
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  } else {
+    data.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+  }
+
+  const auto* bytes = reinterpret_cast<const uint8_t*>(data.data());
+  if (!Format::checkFileHeader(bytes, data.size())) {
+    std::cerr << "not a binary access log, or an unsupported version" << std::endl;
+    return 1;
+  }
+
+  // A header is written each time the proxy opens an empty log, e.g. a named pipe whose collector
+  // records it across restarts of the proxy, so headers may appear between the records.
+  size_t pos = Format::FileHeaderSize;
+  BinaryLogRecord record;
+  while (pos < data.size()) {
+    if (Format::checkFileHeader(bytes + pos, data.size() - pos)) {
+      pos += Format::FileHeaderSize;
+      continue;
+    }
+    const size_t consumed = Format::readRecord(bytes + pos, data.size() - pos, record);
+    if (consumed == 0) {
+      std::cerr << "truncated or corrupted record at offset " << pos << std::endl;
+      return 1;
+    }
+    std::cout << toJson(record) << '\n';
+    pos += consumed;
+  }
+  return 0;
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace BinaryAccessLogFormat {
+
+/**
+ * The format of the binary access log. It's shared by the proxy and the offline decoder, so it
+ * only depends on the standard library.
+ *
+ * The file starts with an 8 bytes header: the magic "MPBL", the format version (uint16) and two
+ * reserved bytes. It's followed by the records, each of them prefixed with its length (uint16, not
+ * counting the prefix itself). A record is made of the fixed fields of BinaryLogRecord in their
+ * declaration order, then the strings, each of them prefixed with its length (uint8). All the
+ * integers are little-endian.
+ *
+ * New fields are appended to the records, so a decoder skips the trailing bytes it doesn't know.
+ */
+constexpr char Magic[4] = {'M', 'P', 'B', 'L'};
+constexpr uint16_t Version = 1;
+constexpr size_t FileHeaderSize = 8;
+
+constexpr size_t MaxOperationNameLength = 128;
+constexpr size_t MaxClusterNameLength = 64;
+constexpr size_t MaxUpstreamHostLength = 64;
+
+/**
+ * A request as it's copied into the ring buffer of a worker. The strings are truncated to fixed
+ * sizes so the records can be preallocated.
+ */
+struct BinaryLogRecord {
+  // the wall clock time the request was received, in microseconds since the epoch
+  uint64_t start_time_us;
+  // the time from receiving the request to logging it, in microseconds
+  uint64_t duration_us;
+  uint64_t request_id;
+  uint32_t request_size;
+  uint32_t response_size;
+  int32_t response_code;
+  uint8_t message_type;
+
+  uint8_t operation_name_length;
+  uint8_t cluster_name_length;
+  uint8_t upstream_host_length;
+  char operation_name[MaxOperationNameLength];
+  char cluster_name[MaxClusterNameLength];
+  char upstream_host[MaxUpstreamHostLength];
+};
+
+// the size of the fixed fields of an encoded record
+constexpr size_t FixedFieldsSize = 8 + 8 + 8 + 4 + 4 + 4 + 1;
+
+/**
+ * Copy a string into a field of a record, truncating it to the size of the field.
+ */
+template <size_t N>
+inline void setString(char (&field)[N], uint8_t& length, const char* data, size_t size) {
+  static_assert(N <= UINT8_MAX, "the length of a string must fit in a byte");
+  length = static_cast<uint8_t>(std::min(size, N));
+  memcpy(field, data, length);
+}
+
+template <typename T> inline void appendInt(std::string& out, T value) {
+  for (size_t i = 0; i < sizeof(T); i++) {
+    out.push_back(static_cast<char>((static_cast<uint64_t>(value) >> (i * 8)) & 0xff));
+  }
+}
+
+template <typename T> inline T readInt(const uint8_t* data) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < sizeof(T); i++) {
+    value |= static_cast<uint64_t>(data[i]) << (i * 8);
+  }
+  return static_cast<T>(value);
+}
+
+inline void appendFileHeader(std::string& out) {
+  out.append(Magic, sizeof(Magic));
+  appendInt<uint16_t>(out, Version);
+  appendInt<uint16_t>(out, 0);
+}
+
+/**
+ * @return true if the data starts with the header of a binary access log of a known version.
+ */
+inline bool checkFileHeader(const uint8_t* data, size_t size) {
+  return size >= FileHeaderSize && memcmp(data, Magic, sizeof(Magic)) == 0 &&
+         readInt<uint16_t>(data + sizeof(Magic)) == Version;
+}
+
+/**
+ * Append the length-prefixed encoding of a record.
+ */
+inline void appendRecord(std::string& out, const BinaryLogRecord& record) {
+  const size_t length = FixedFieldsSize + 3 + record.operation_name_length +
+                        record.cluster_name_length + record.upstream_host_length;
+  appendInt<uint16_t>(out, static_cast<uint16_t>(length));
+  appendInt(out, record.start_time_us);
+  appendInt(out, record.duration_us);
+  appendInt(out, record.request_id);
+  appendInt(out, record.request_size);
+  appendInt(out, record.response_size);
+  appendInt(out, record.response_code);
+  appendInt(out, record.message_type);
+  out.push_back(static_cast<char>(record.operation_name_length));
+  out.append(record.operation_name, record.operation_name_length);
+  out.push_back(static_cast<char>(record.cluster_name_length));
+  out.append(record.cluster_name, record.cluster_name_length);
+  out.push_back(static_cast<char>(record.upstream_host_length));
+  out.append(record.upstream_host, record.upstream_host_length);
+}
+
+/**
+ * Decode the record at the head of the data.
+ * @return the number of bytes consumed, 0 if the data doesn't hold a whole record or the record
+ * is corrupted.
+ */
+inline size_t readRecord(const uint8_t* data, size_t size, BinaryLogRecord& record) {
+  if (size < 2) {
+    return 0;
+  }
+  const size_t length = readInt<uint16_t>(data);
+  if (length < FixedFieldsSize || size < 2 + length) {
+    return 0;
+  }
+  const uint8_t* pos = data + 2;
+  const uint8_t* end = pos + length;
+  record.start_time_us = readInt<uint64_t>(pos);
+  record.duration_us = readInt<uint64_t>(pos + 8);
+  record.request_id = readInt<uint64_t>(pos + 16);
+  record.request_size = readInt<uint32_t>(pos + 24);
+  record.response_size = readInt<uint32_t>(pos + 28);
+  record.response_code = readInt<int32_t>(pos + 32);
+  record.message_type = readInt<uint8_t>(pos + 36);
+  pos += FixedFieldsSize;
+
+  auto read_string = [&pos, end](char* field, size_t field_size, uint8_t& field_length) {
+    if (pos >= end || pos + 1 + *pos > end || *pos > field_size) {
+      return false;
+    }
+    field_length = *pos;
+    memcpy(field, pos + 1, field_length);
+    pos += 1 + field_length;
+    return true;
+  };
+  if (!read_string(record.operation_name, MaxOperationNameLength, record.operation_name_length) ||
+      !read_string(record.cluster_name, MaxClusterNameLength, record.cluster_name_length) ||
+      !read_string(record.upstream_host, MaxUpstreamHostLength, record.upstream_host_length)) {
+    return 0;
+  }
+  return 2 + length;
+}
+
+} // namespace BinaryAccessLogFormat
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
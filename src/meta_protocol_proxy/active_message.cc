@@ -14,12 +14,13 @@ namespace MetaProtocolProxy {
 // class ActiveResponseDecoder
 ActiveResponseDecoder::ActiveResponseDecoder(ActiveMessage& parent, MetaProtocolProxyStats& stats,
                                              Network::Connection& connection,
-                                             std::string applicationProtocol, CodecPtr&& codec,
-                                             Metadata& requestMetadata)
+                                             std::string applicationProtocol,
+                                             ProtocolDecoderPtr&& protocol_decoder,
+                                             Encoder& encoder, Metadata& requestMetadata)
     : parent_(parent), stats_(stats), downstream_connection_(connection),
-      application_protocol_(applicationProtocol), codec_(std::move(codec)),
-      request_metadata_(requestMetadata),
-      decoder_(std::make_unique<ResponseDecoder>(*codec_, *this)), complete_(false),
+      application_protocol_(applicationProtocol), protocol_decoder_(std::move(protocol_decoder)),
+      encoder_(encoderFor(*protocol_decoder_, encoder)), request_metadata_(requestMetadata),
+      decoder_(std::make_unique<ResponseDecoder>(*protocol_decoder_, *this)), complete_(false),
       response_status_(UpstreamResponseStatus::MoreData) {}
 
 UpstreamResponseStatus ActiveResponseDecoder::onData(Buffer::Instance& data) {
@@ -27,7 +28,10 @@ UpstreamResponseStatus ActiveResponseDecoder::onData(Buffer::Instance& data) {
             application_protocol_, data.length());
 
   bool underflow = false;
-  decoder_->onData(data, underflow);
+  if (!decoder_->onData(data, underflow)) {
+    parent_.onResponseDecodingError(decoder_->errorDetail());
+    return UpstreamResponseStatus::Reset;
+  }
   // decoder return underflow in th following two cases:
   // 1. decoder needs more data to complete the decoding of the current response, in this case,
   // the buffer contains part of the incomplete response.
@@ -62,7 +66,7 @@ void ActiveResponseDecoder::onMessageDecoded(MetadataSharedPtr metadata,
   // put real server ip in the response
   metadata_->putString(ReservedHeaders::RealServerAddress,
                        request_metadata_.getString(ReservedHeaders::RealServerAddress));
-  codec_->encode(*metadata_, *mutation, metadata->originMessage());
+  encoder_.encode(*metadata_, *mutation, metadata->originMessage());
   downstream_connection_.write(metadata->originMessage(), false);
   ENVOY_LOG(debug,
             "meta protocol {} response: the upstream response message has been forwarded to the "
@@ -79,6 +83,9 @@ void ActiveResponseDecoder::onMessageDecoded(MetadataSharedPtr metadata,
   case ResponseStatus::Ok:
     stats_.response_success_.inc();
     break;
+  case ResponseStatus::ServerBusy:
+    stats_.response_server_busy_.inc();
+    FALLTHRU;
   default:
     stats_.response_error_.inc();
     ENVOY_LOG(error, "meta protocol {} response status: {}", application_protocol_,
@@ -180,13 +187,25 @@ void ActiveMessageDecoderFilter::resetDownstreamConnection() {
   activeMessage_.resetDownstreamConnection();
 }
 
-CodecPtr ActiveMessageDecoderFilter::createCodec() { return activeMessage_.createCodec(); }
+ProtocolDecoderPtr ActiveMessageDecoderFilter::createDecoder() {
+  return activeMessage_.createDecoder();
+}
+
+const EncoderSharedPtr& ActiveMessageDecoderFilter::encoder() { return activeMessage_.encoder(); }
+
+CodecFactory& ActiveMessageDecoderFilter::configCodecFactory() {
+  return activeMessage_.configCodecFactory();
+}
 
 void ActiveMessageDecoderFilter::setUpstreamConnection(
     Tcp::ConnectionPool::ConnectionDataPtr conn) {
   return activeMessage_.setUpstreamConnection(std::move(conn));
 }
 
+void ActiveMessageDecoderFilter::setUpstreamHandler(UpstreamHandlerSharedPtr upstream_handler) {
+  activeMessage_.setUpstreamHandler(std::move(upstream_handler));
+}
+
 Tracing::MetaProtocolTracerSharedPtr ActiveMessageDecoderFilter::tracer() {
   return activeMessage_.tracer();
 }
@@ -203,6 +222,10 @@ const std::vector<AccessLog::InstanceSharedPtr>& ActiveMessageDecoderFilter::acc
   return activeMessage_.accessLogs();
 }
 
+BinaryAccessLog* ActiveMessageDecoderFilter::binaryAccessLog() {
+  return activeMessage_.binaryAccessLog();
+}
+
 GetUpstreamHandlerResult
 ActiveMessageDecoderFilter::getUpstreamHandler(const std::string& cluster_name,
                                                Upstream::LoadBalancerContext& context) {
@@ -215,6 +238,16 @@ void ActiveMessageDecoderFilter::onUpstreamResponse() {
   return activeMessage_.onUpstreamResponse();
 }
 
+bool ActiveMessageDecoderFilter::bodyStreaming() { return activeMessage_.bodyStreaming(); }
+
+void ActiveMessageDecoderFilter::setMessageBodyCallbacks(MessageBodyCallbacks& callbacks) {
+  activeMessage_.setMessageBodyCallbacks(callbacks);
+}
+
+void ActiveMessageDecoderFilter::readDisableDownstream(bool disable) {
+  activeMessage_.readDisableDownstream(disable);
+}
+
 // class ActiveMessageEncoderFilter
 ActiveMessageEncoderFilter::ActiveMessageEncoderFilter(ActiveMessage& parent,
                                                        EncoderFilterSharedPtr filter,
@@ -245,7 +278,8 @@ ActiveMessage::ActiveMessage(ConnectionManager& connection_manager)
       stream_info_(std::make_unique<StreamInfo::StreamInfoImpl>(
           connection_manager.timeSystem(),
           connection_manager.connection().connectionInfoProviderSharedPtr())),
-      pending_stream_decoded_(false), local_response_sent_(false) {
+      pending_stream_decoded_(false), local_response_sent_(false), body_streaming_(false),
+      body_complete_(false) {
   connection_manager.stats().request_active_.inc();
 }
 
@@ -310,14 +344,42 @@ void ActiveMessage::onMessageDecoded(MetadataSharedPtr metadata, MutationSharedP
   metadata->putString(ReservedHeaders::ApplicationProtocol,
                       connection_manager_.config().applicationProtocol());
 
+  // Under memory pressure, new requests and streams are answered with a "server busy" reply
+  // before any filter or upstream state is created for them.
+  if ((metadata->getMessageType() == MessageType::Request ||
+       metadata->getMessageType() == MessageType::Stream_Init) &&
+      connection_manager_.shouldRejectForOverload()) {
+    ENVOY_LOG(debug, "meta protocol {} request: overloaded, reject request, id is {}",
+              connection_manager_.config().applicationProtocol(), metadata->getRequestId());
+    metadata_ = metadata;
+    sendLocalReply(AppException(Error{ErrorType::ServerBusy,
+                                      "meta protocol: envoy overloaded, the request is rejected"}),
+                   false);
+    connection_manager_.deferredDeleteMessage(*this);
+    return;
+  }
+
   bool needApplyFilters = false;
   switch (metadata->getMessageType()) {
   case MessageType::Request:
     needApplyFilters = true;
     break;
   case MessageType::Stream_Init:
+    if (connection_manager_.tooManyStreams()) {
+      ENVOY_LOG(debug, "meta protocol {} request: too many streams, reject stream {}",
+                connection_manager_.config().applicationProtocol(), metadata->getStreamId());
+      connection_manager_.stats().stream_overflow_.inc();
+      metadata_ = metadata;
+      sendLocalReply(
+          AppException(Error{ErrorType::OverLimit,
+                             "meta protocol: too many concurrent streams on the connection"}),
+          false);
+      connection_manager_.deferredDeleteMessage(*this);
+      return;
+    }
     needApplyFilters = true;
-    connection_manager_.newActiveStream(metadata->getStreamId());
+    connection_manager_.newActiveStream(metadata->getStreamId())
+        .onClientFrame(metadata->originMessage());
     break;
   case MessageType::Stream_Data:
     needApplyFilters = false;
@@ -411,6 +473,15 @@ void ActiveMessage::setUpstreamConnection(Tcp::ConnectionPool::ConnectionDataPtr
   connection_manager_.getActiveStream(metadata_->getStreamId()).setUpstreamConn(std::move(conn));
 }
 
+void ActiveMessage::setUpstreamHandler(UpstreamHandlerSharedPtr upstream_handler) {
+  const uint64_t stream_id = metadata_->getStreamId();
+  if (!connection_manager_.streamExisted(stream_id)) {
+    // the stream has been reset while the upstream connection was being established
+    return;
+  }
+  connection_manager_.getActiveStream(stream_id).setUpstreamHandler(std::move(upstream_handler));
+}
+
 Tracing::MetaProtocolTracerSharedPtr ActiveMessage::tracer() {
   return connection_manager_.tracer();
 }
@@ -427,6 +498,8 @@ const std::vector<AccessLog::InstanceSharedPtr>& ActiveMessage::accessLogs() {
   return connection_manager_.accessLogs();
 }
 
+BinaryAccessLog* ActiveMessage::binaryAccessLog() { return connection_manager_.binaryAccessLog(); }
+
 GetUpstreamHandlerResult ActiveMessage::getUpstreamHandler(const std::string& cluster_name,
                                                            Upstream::LoadBalancerContext& context) {
   return connection_manager_.getUpstreamHandler(cluster_name, context);
@@ -436,6 +509,38 @@ bool ActiveMessage::multiplexing() { return connection_manager_.config().multipl
 
 void ActiveMessage::onUpstreamResponse() { connection_manager_.deferredDeleteMessage(*this); }
 
+void ActiveMessage::onMessageBodyStreaming() {
+  body_streaming_ = true;
+  connection_manager_.onMessageBodyStreaming(*this);
+}
+
+void ActiveMessage::onMessageBody(Buffer::Instance& data, bool end_of_message) {
+  ASSERT(body_streaming_ && !body_complete_);
+  body_complete_ = end_of_message;
+  if (body_callbacks_ != nullptr) {
+    body_callbacks_->onMessageBody(data, end_of_message);
+    return;
+  }
+  // the filter chain is paused before reaching the router
+  request_body_buffer_.move(data);
+}
+
+void ActiveMessage::setMessageBodyCallbacks(MessageBodyCallbacks& callbacks) {
+  ASSERT(body_streaming_ && body_callbacks_ == nullptr);
+  body_callbacks_ = &callbacks;
+  if (request_body_buffer_.length() > 0 || body_complete_) {
+    body_callbacks_->onMessageBody(request_body_buffer_, body_complete_);
+  }
+}
+
+void ActiveMessage::readDisableDownstream(bool disable) {
+  if (disable) {
+    connection_manager_.onUpstreamBodyBackpressure();
+  } else {
+    connection_manager_.onUpstreamBodyBackpressureRelieved();
+  }
+}
+
 void ActiveMessage::maybeDeferredDeleteMessage() {
   pending_stream_decoded_ = false;
   connection_manager_.stats().request_.inc();
@@ -549,12 +654,13 @@ void ActiveMessage::startUpstreamResponse(Metadata& requestMetadata) {
 
   ASSERT(response_decoder_ == nullptr);
 
-  CodecPtr codec = connection_manager_.config().createCodec();
+  ProtocolDecoderPtr protocol_decoder = connection_manager_.config().createDecoder();
 
   // Create a response message decoder.
   response_decoder_ = std::make_unique<ActiveResponseDecoder>(
       *this, connection_manager_.stats(), connection_manager_.connection(),
-      connection_manager_.config().applicationProtocol(), std::move(codec), requestMetadata);
+      connection_manager_.config().applicationProtocol(), std::move(protocol_decoder),
+      *connection_manager_.config().encoder(), requestMetadata);
 }
 
 UpstreamResponseStatus ActiveMessage::upstreamData(Buffer::Instance& buffer) {
@@ -595,11 +701,26 @@ UpstreamResponseStatus ActiveMessage::upstreamData(Buffer::Instance& buffer) {
   }
 }
 
+void ActiveMessage::onResponseDecodingError(const std::string& detail) {
+  ENVOY_CONN_LOG(error, "meta protocol {} response: protocol error ({})",
+                 connection_manager_.connection(),
+                 connection_manager_.config().applicationProtocol(), detail);
+  connection_manager_.stats().response_decoding_error_.inc();
+
+  onError(detail);
+}
+
 void ActiveMessage::resetDownstreamConnection() {
   connection_manager_.connection().close(Network::ConnectionCloseType::NoFlush);
 }
 
-CodecPtr ActiveMessage::createCodec() { return connection_manager_.config().createCodec(); }
+ProtocolDecoderPtr ActiveMessage::createDecoder() {
+  return connection_manager_.config().createDecoder();
+}
+
+const EncoderSharedPtr& ActiveMessage::encoder() { return connection_manager_.config().encoder(); }
+
+CodecFactory& ActiveMessage::configCodecFactory() { return connection_manager_.config(); }
 
 void ActiveMessage::resetStream() { connection_manager_.deferredDeleteMessage(*this); }
 
@@ -32,7 +32,8 @@ class ActiveResponseDecoder : public ResponseDecoderCallbacks,
 public:
   ActiveResponseDecoder(ActiveMessage& parent, MetaProtocolProxyStats& stats,
                         Network::Connection& connection, std::string applicationProtocol,
-                        CodecPtr&& codec, Metadata& requestMetadata);
+                        ProtocolDecoderPtr&& protocol_decoder, Encoder& encoder,
+                        Metadata& requestMetadata);
   ~ActiveResponseDecoder() override = default;
 
   UpstreamResponseStatus onData(Buffer::Instance& data);
@@ -53,7 +54,8 @@ private:
   MetaProtocolProxyStats& stats_;
   Network::Connection& downstream_connection_;
   std::string application_protocol_;
-  CodecPtr codec_;
+  ProtocolDecoderPtr protocol_decoder_;
+  Encoder& encoder_;
   Metadata& request_metadata_;
   ResponseDecoderPtr decoder_;
   MetadataSharedPtr metadata_;
@@ -103,16 +105,23 @@ public:
   void startUpstreamResponse(Metadata& requestMetadata) override;
   UpstreamResponseStatus upstreamData(Buffer::Instance& buffer) override;
   void resetDownstreamConnection() override;
-  CodecPtr createCodec() override;
+  ProtocolDecoderPtr createDecoder() override;
+  const EncoderSharedPtr& encoder() override;
+  CodecFactory& configCodecFactory() override;
   void setUpstreamConnection(Tcp::ConnectionPool::ConnectionDataPtr conn) override;
+  void setUpstreamHandler(UpstreamHandlerSharedPtr upstream_handler) override;
   Tracing::MetaProtocolTracerSharedPtr tracer() override;
   Tracing::TracingConfig* tracingConfig() override;
   RequestIDExtensionSharedPtr requestIDExtension() override;
   const std::vector<AccessLog::InstanceSharedPtr>& accessLogs() override;
+  BinaryAccessLog* binaryAccessLog() override;
   GetUpstreamHandlerResult getUpstreamHandler(const std::string& cluster_name,
                                               Upstream::LoadBalancerContext& context) override;
   bool multiplexing() override;
   void onUpstreamResponse() override;
+  bool bodyStreaming() override;
+  void setMessageBodyCallbacks(MessageBodyCallbacks& callbacks) override;
+  void readDisableDownstream(bool disable) override;
 
   DecoderFilterSharedPtr handler() { return handle_; }
 
@@ -174,6 +183,7 @@ public:
 
   // StreamHandler
   void onMessageDecoded(MetadataSharedPtr metadata, MutationSharedPtr mutation) override;
+  void onMessageBodyStreaming() override;
 
   // DecoderFilterCallbacks
   uint64_t requestId() const override;
@@ -186,20 +196,28 @@ public:
   void startUpstreamResponse(Metadata& requestMetadata) override;
   UpstreamResponseStatus upstreamData(Buffer::Instance& buffer) override;
   void resetDownstreamConnection() override;
-  CodecPtr createCodec() override;
+  ProtocolDecoderPtr createDecoder() override;
+  const EncoderSharedPtr& encoder() override;
+  CodecFactory& configCodecFactory() override;
   Event::Dispatcher& dispatcher() override;
   void resetStream() override;
   void setUpstreamConnection(Tcp::ConnectionPool::ConnectionDataPtr conn) override;
+  void setUpstreamHandler(UpstreamHandlerSharedPtr upstream_handler) override;
   Tracing::MetaProtocolTracerSharedPtr tracer() override;
   Tracing::TracingConfig* tracingConfig() override;
   RequestIDExtensionSharedPtr requestIDExtension() override;
   const std::vector<AccessLog::InstanceSharedPtr>& accessLogs() override;
+  BinaryAccessLog* binaryAccessLog() override;
   GetUpstreamHandlerResult getUpstreamHandler(const std::string& cluster_name,
                                               Upstream::LoadBalancerContext& context) override;
   bool multiplexing() override;
   void onUpstreamResponse() override;
+  bool bodyStreaming() override { return body_streaming_; }
+  void setMessageBodyCallbacks(MessageBodyCallbacks& callbacks) override;
+  void readDisableDownstream(bool disable) override;
 
   void createFilterChain();
+  void onMessageBody(Buffer::Instance& data, bool end_of_message);
   FilterStatus applyDecoderFilters(ActiveMessageDecoderFilter* filter,
                                    FilterIterationStartState state);
   FilterStatus applyEncoderFilters(ActiveMessageEncoderFilter* filter,
@@ -207,6 +225,7 @@ public:
   void maybeDeferredDeleteMessage();
   void onReset();
   void onError(const std::string& what);
+  void onResponseDecodingError(const std::string& detail);
   MetadataSharedPtr metadata() const { return metadata_; }
   // ContextSharedPtr context() const { return context_; }
   bool pendingStreamDecoded() const { return pending_stream_decoded_; }
@@ -233,9 +252,14 @@ private:
   uint64_t stream_id_;
   std::shared_ptr<StreamInfo::StreamInfo> stream_info_;
   Buffer::OwnedImpl response_buffer_;
+  // the body of a streamed request which has arrived before the body callbacks are set
+  Buffer::OwnedImpl request_body_buffer_;
+  MessageBodyCallbacks* body_callbacks_{};
 
   bool pending_stream_decoded_ : 1;
   bool local_response_sent_ : 1;
+  bool body_streaming_ : 1;
+  bool body_complete_ : 1;
 
   friend class ActiveResponseDecoder;
 };
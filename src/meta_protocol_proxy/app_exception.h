@@ -19,9 +19,10 @@ struct AppExceptionBase : public EnvoyException,
   AppExceptionBase(const AppExceptionBase& ex) = default;
   AppExceptionBase(const Error& error) : EnvoyException(error.message), error_(error) {}
 
-  ResponseType encode(Metadata& metadata, Codec& codec, Buffer::Instance& buffer) const override {
+  ResponseType encode(Metadata& metadata, Encoder& encoder,
+                      Buffer::Instance& buffer) const override {
     ASSERT(buffer.length() == 0);
-    codec.onError(metadata, error_, buffer);
+    encoder.onError(metadata, error_, buffer);
     return ResponseType::Exception;
   }
 
@@ -8,6 +8,8 @@
 #include "envoy/tracing/trace_context.h"
 #include "envoy/stream_info/stream_info.h"
 
+#include "absl/types/optional.h"
+
 namespace Envoy {
 namespace Extensions {
 namespace NetworkFilters {
@@ -30,8 +32,19 @@ enum class StreamType { Stream };
 enum class ResponseStatus {
   Ok = 0,
   Error = 1,
+  // The server rejected the request because it is overloaded, e.g. its thread pool is exhausted.
+  // The router uses it to steer traffic away from the host for a short while.
+  ServerBusy = 2,
 };
 
+/**
+ * The response code reported to the stats and the access logs. A busy server is reported with the
+ * code of Error, as it was before ServerBusy was introduced.
+ */
+inline int responseCode(ResponseStatus status) {
+  return static_cast<int>(status == ResponseStatus::ServerBusy ? ResponseStatus::Error : status);
+}
+
 using AnyOptConstRef = OptRef<const std::any>;
 
 // Reserved headers, don't override these headers in application protocols
@@ -76,6 +89,7 @@ public:
   virtual std::string getOperationName() const PURE;
   // Additional information about a completed request.
   virtual StreamInfo::StreamInfo& streamInfo() const PURE;
+  // The clones of a message share its bytes, so cloning a clone again doesn't copy the message.
   virtual std::shared_ptr<Metadata> clone() const PURE;
 
   /**
@@ -136,6 +150,8 @@ using MutationSharedPtr = std::shared_ptr<Mutation>;
 enum class DecodeStatus {
   WaitForData = 0,
   Done = 1,
+  // The data is not valid for the protocol, the decoder tells why in errorDetail().
+  Error = 2,
 };
 
 enum class ErrorType {
@@ -145,6 +161,8 @@ enum class ErrorType {
   BadResponse = 3,
   Unspecified = 4,
   OverLimit = 5,
+  // the proxy itself is overloaded and doesn't accept new requests
+  ServerBusy = 6,
 };
 
 struct Error {
@@ -153,11 +171,29 @@ struct Error {
 };
 
 /**
- * Codec is used to decode and encode messages of a specific protocol built on top of MetaProtocol.
+ * The credit based flow control information carried by a frame of a stream. Each receiver
+ * advertises a window when the stream is opened and returns credit as it consumes data, a sender
+ * must not send more data than the credit it has been given.
+ */
+struct StreamFrameCredit {
+  // the window advertised by the sender of the frame when it opens the stream, 0 if the frame
+  // doesn't open the stream or the sender doesn't use flow control
+  uint32_t initial_window{0};
+  // the credit returned by the sender of the frame to its peer
+  uint32_t window_increment{0};
+  // the credit of the receiver consumed by the data of the frame
+  uint32_t consumed{0};
+};
+
+/**
+ * ProtocolDecoder decodes the messages of a specific protocol built on top of MetaProtocol.
+ *
+ * A decoder keeps the state of a partially received message between calls, so a new decoder is
+ * created for each downstream connection and each upstream response.
  */
-class Codec {
+class ProtocolDecoder {
 public:
-  virtual ~Codec() = default;
+  virtual ~ProtocolDecoder() = default;
 
   /*
    * decodes the protocol message.
@@ -165,11 +201,122 @@ public:
    * @param buffer the currently buffered data.
    * @param metadata saves the meta data of the current message.
    * @return DecodeStatus::DONE if a complete message was successfully consumed,
-   * DecodeStatus::WaitForData if more data is required.
-   * @throws EnvoyException if the data is not valid for this protocol.
+   * DecodeStatus::WaitForData if more data is required, DecodeStatus::Error if the data is not
+   * valid for this protocol.
+   * @throws EnvoyException if the data is not valid for this protocol. Throwing is still supported,
+   * but decoders should prefer returning DecodeStatus::Error: a connection with a bad client or a
+   * scanner may fail every message, and unwinding an exception per message is expensive.
    */
   virtual DecodeStatus decode(Buffer::Instance& buffer, Metadata& metadata) PURE;
 
+  /*
+   * @return the reason of the last DecodeStatus::Error returned by decode. It's only called on
+   * the error path, for logging and for closing the connection.
+   */
+  virtual std::string errorDetail() const { return "invalid message"; }
+
+  /*
+   * peeks the fixed header of the next message to tell how many bytes the message takes. It's
+   * optional, but protocols with a length field should implement it: the framework doesn't call
+   * decode until the whole message has been buffered, which saves a decode attempt and a metadata
+   * allocation every time only a part of a large message has arrived.
+   *
+   * It's only called when the decoder is at a message boundary, i.e. before the first decode call
+   * of a message. The buffer must not be modified.
+   *
+   * @param buffer the currently buffered data.
+   * @return the length of the message including its header, the length of the fixed header if the
+   * header itself is not complete yet, or 0 if the length can't be told, in which case decode is
+   * always called.
+   */
+  virtual uint64_t frameLength(const Buffer::Instance&) { return 0; }
+
+  /*
+   * decodes only the head of a request whose body is still arriving, so the framework can route
+   * the request and forward the body to the upstream as it arrives instead of buffering the whole
+   * message. It's optional and only called for requests longer than the configured streaming
+   * threshold, with frameLength telling where the request ends and headLength telling that the
+   * head is complete.
+   *
+   * The head must carry everything needed for routing, and the encoder must be able to encode a
+   * buffer which holds only the head, keeping the length of the body unchanged.
+   *
+   * @param buffer the currently buffered data, at a message boundary.
+   * @param metadata saves the meta data of the current message. On success the head is moved into
+   * metadata.originMessage() and the body is left in the buffer.
+   * @return the length of the head moved out of the buffer, or 0 if the head is not complete yet or
+   * the message can't be streamed, in which case the framework falls back to buffering the whole
+   * message and calling decode. The buffer must not be modified when 0 is returned.
+   */
+  virtual uint64_t decodeHead(Buffer::Instance&, Metadata&) { return 0; }
+
+  /*
+   * peeks the fixed header of the next message to tell whether decodeHead can decode it and how
+   * long its head is, so the framework doesn't allocate a metadata and call decodeHead every time
+   * a part of a large message arrives. It must be implemented along with decodeHead, the messages
+   * of the protocols which don't implement it are always buffered.
+   *
+   * It's only called at a message boundary. The buffer must not be modified.
+   *
+   * @param buffer the currently buffered data.
+   * @return the length of the head, 0 if it can't be told yet, or absl::nullopt if the message
+   * can't be streamed.
+   */
+  virtual absl::optional<uint64_t> headLength(const Buffer::Instance&) { return absl::nullopt; }
+
+  /*
+   * peeks the fixed header of the next frame of an established stream to tell whether it only
+   * carries data. It's optional: such frames are forwarded as they are without calling decode, so
+   * they cost neither a metadata allocation nor parsing their header. The frames which change the
+   * state of the stream, e.g. the close frames, must still be decoded.
+   *
+   * It's only called at a message boundary, after frameLength has told that the whole frame is
+   * buffered. The buffer must not be modified.
+   *
+   * @param buffer the currently buffered data.
+   * @return true if the frame can be forwarded without being decoded.
+   */
+  virtual bool isStreamDataFrame(const Buffer::Instance&) { return false; }
+
+  /*
+   * peeks the flow control information of the next frame of a stream. It's optional, streams of
+   * the protocols which don't implement it are not flow controlled by the framework.
+   *
+   * It's called with a buffer holding at least one whole frame. The buffer must not be modified.
+   *
+   * @param buffer the currently buffered data.
+   * @return the credit advertised, returned or consumed by the frame.
+   */
+  virtual StreamFrameCredit streamFrameCredit(const Buffer::Instance&) { return {}; }
+
+  /*
+   * peeks the fixed header of the next message to tell which stream it belongs to. It's optional
+   * and needed to multiplex streams on the upstream connections shared with other requests: the
+   * frames of the streams are handed to their streams without being decoded.
+   *
+   * It's only called at a message boundary. The buffer must not be modified.
+   *
+   * @param buffer the currently buffered data.
+   * @return the id of the stream, or absl::nullopt if the message is not a stream frame or the
+   * header is not complete yet.
+   */
+  virtual absl::optional<uint64_t> streamId(const Buffer::Instance&) { return absl::nullopt; }
+};
+
+using ProtocolDecoderPtr = std::unique_ptr<ProtocolDecoder>;
+
+/**
+ * Encoder encodes the messages of a specific protocol built on top of MetaProtocol.
+ *
+ * An encoder must not keep any state between calls: everything it needs has to come from the
+ * metadata produced by the decoder. The framework creates one encoder per worker and shares it
+ * among all the connections and requests of that worker, so encoding a message doesn't allocate a
+ * codec. @see Codec for the application protocols which don't provide a separate encoder.
+ */
+class Encoder {
+public:
+  virtual ~Encoder() = default;
+
   /*
    * encodes the protocol message.
    *
@@ -193,8 +340,30 @@ public:
   virtual void onError(const Metadata& metadata, const Error& error, Buffer::Instance& buffer) PURE;
 };
 
+using EncoderSharedPtr = std::shared_ptr<Encoder>;
+
+/**
+ * Codec is used to decode and encode messages of a specific protocol built on top of MetaProtocol.
+ *
+ * Codec is kept for the application protocols which implement the decoder and the encoder in one
+ * class. Such a codec may keep decoding state which its encoding methods depend on, so the
+ * responses, the local replies and the heartbeat responses are encoded by the instance which
+ * decoded the message they answer. Only the requests sent upstream are encoded by the instance
+ * shared by the worker, which never decodes anything.
+ */
+class Codec : public ProtocolDecoder, public Encoder {};
+
 using CodecPtr = std::unique_ptr<Codec>;
 
+/**
+ * @return the encoder of the messages answering the ones decoded by decoder: the decoder itself if
+ * it is a legacy Codec, the shared encoder otherwise.
+ */
+inline Encoder& encoderFor(ProtocolDecoder& decoder, Encoder& shared_encoder) {
+  auto* codec = dynamic_cast<Codec*>(&decoder);
+  return codec != nullptr ? *codec : shared_encoder;
+}
+
 } // namespace MetaProtocolProxy
 } // namespace NetworkFilters
 } // namespace Extensions
@@ -22,11 +22,33 @@ public:
   ~NamedCodecConfigFactory() override = default;
 
   /**
-   * Create a codec for a particular application protocol.
+   * Create a decoder for a particular application protocol. A decoder is created for each
+   * downstream connection and each upstream response.
+   * @param config the configuration of the codec.
+   * @return protocol decoder pointer.
+   */
+  virtual ProtocolDecoderPtr createDecoder(const Protobuf::Message& config) {
+    return createCodec(config);
+  }
+
+  /**
+   * Create an encoder for a particular application protocol. An encoder is created for each worker
+   * and shared by all the connections of that worker.
+   * @param config the configuration of the codec.
+   * @return protocol encoder pointer.
+   */
+  virtual EncoderSharedPtr createEncoder(const Protobuf::Message& config) {
+    return createCodec(config);
+  }
+
+  /**
+   * Create a codec for a particular application protocol. Only needs to be implemented by the
+   * application protocols which don't override createDecoder and createEncoder. @see Codec for
+   * which instance encodes which messages.
    * @param config the configuration of the codec.
    * @return protocol codec pointer.
    */
-  virtual CodecPtr createCodec(const Protobuf::Message& config) PURE;
+  virtual CodecPtr createCodec(const Protobuf::Message&) { return nullptr; }
 
   std::string category() const override { return "aeraki.meta_protocol.codec"; }
 };
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+#include "envoy/buffer/buffer.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+
+enum class FrameByteOrder { BigEndian, LittleEndian };
+
+/**
+ * LengthPrefixedFramer splits the messages of a binary protocol whose messages start with a fixed
+ * size header carrying a magic number and the length of the message, which is the case of most
+ * in-house RPC protocols.
+ *
+ * The frame format is declared at compile time, so the offsets and widths are constants and the
+ * integer reads are unrolled by the compiler. For example, the Dubbo format:
+ *
+ *   using DubboFramer = LengthPrefixedFramer<uint16_t, 0xdabb, 16, 12, uint32_t, 16>;
+ *
+ * @tparam MagicType the unsigned integer type of the magic number at the start of the header.
+ * @tparam Magic the magic number.
+ * @tparam HeaderSize the size of the fixed header.
+ * @tparam LengthOffset the offset of the length field in the header.
+ * @tparam LengthType the unsigned integer type of the length field.
+ * @tparam LengthAdjustment added to the length field to get the length of the whole message, e.g.
+ *         the header size if the length field only counts the body.
+ * @tparam MaxFrameLength messages longer than this are treated as invalid.
+ * @tparam Order the byte order of the magic number and the length field.
+ */
+template <typename MagicType, MagicType Magic, uint64_t HeaderSize, uint64_t LengthOffset,
+          typename LengthType, uint64_t LengthAdjustment = 0,
+          uint64_t MaxFrameLength = std::numeric_limits<uint64_t>::max(),
+          FrameByteOrder Order = FrameByteOrder::BigEndian>
+class LengthPrefixedFramer {
+  static_assert(std::is_unsigned<MagicType>::value, "the magic number must be unsigned");
+  static_assert(std::is_unsigned<LengthType>::value, "the length field must be unsigned");
+  static_assert(sizeof(MagicType) <= HeaderSize, "the magic number must be inside the header");
+  static_assert(LengthOffset + sizeof(LengthType) <= HeaderSize,
+                "the length field must be inside the header");
+
+public:
+  enum class Status {
+    // the buffer doesn't hold the whole message yet
+    WaitForData,
+    // the header has a wrong magic number or an unreasonable length
+    Invalid,
+    // the buffer holds at least one whole message
+    Complete,
+  };
+
+  static constexpr uint64_t headerSize() { return HeaderSize; }
+
+  /**
+   * Peeks the header at the head of the buffer, it has the same semantics as
+   * ProtocolDecoder::frameLength so decoders can forward to it.
+   * @return the length of the message, HeaderSize if the header is not complete, or 0 if the header
+   * is invalid.
+   */
+  static uint64_t frameLength(const Buffer::Instance& buffer) {
+    if (buffer.length() < HeaderSize) {
+      return HeaderSize;
+    }
+    if (peek<MagicType>(buffer, 0) != Magic) {
+      return 0;
+    }
+    const uint64_t length = LengthAdjustment + peek<LengthType>(buffer, LengthOffset);
+    if (length < HeaderSize || length > MaxFrameLength) {
+      return 0;
+    }
+    return length;
+  }
+
+  /**
+   * @return the status of the message at the head of the buffer.
+   */
+  static Status check(const Buffer::Instance& buffer) {
+    const uint64_t length = frameLength(buffer);
+    if (length == 0) {
+      return Status::Invalid;
+    }
+    return buffer.length() < length ? Status::WaitForData : Status::Complete;
+  }
+
+  /**
+   * Reads an integer of the header in the byte order of the protocol without draining the buffer.
+   */
+  template <typename T> static T peek(const Buffer::Instance& buffer, uint64_t offset) {
+    uint8_t bytes[sizeof(T)];
+    buffer.copyOut(offset, sizeof(T), bytes);
+    T value = 0;
+    for (size_t i = 0; i < sizeof(T); i++) {
+      const size_t shift = Order == FrameByteOrder::BigEndian ? (sizeof(T) - 1 - i) * 8 : i * 8;
+      value |= static_cast<T>(static_cast<T>(bytes[i]) << shift);
+    }
+    return value;
+  }
+};
+
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -67,7 +67,7 @@ uint32_t MetadataImpl::getUint32(std::string key) const {
 
 MetadataSharedPtr MetadataImpl::clone() const {
   auto copy = std::make_shared<MetadataImpl>();
-  copy->originMessage().add(origin_message_);
+  copy->shareOriginMessage(sharedOriginMessage());
   copy->setMessageType(getMessageType());
   copy->setResponseStatus(getResponseStatus());
   copy->setBodySize(getBodySize());
@@ -81,6 +81,31 @@ MetadataSharedPtr MetadataImpl::clone() const {
   return copy;
 };
 
+std::shared_ptr<const std::string> MetadataImpl::sharedOriginMessage() const {
+  // The message of a clone references the bytes shared with the other clones, they can be shared
+  // again as long as the message hasn't been drained or appended to.
+  if (shared_message_ != nullptr && origin_message_.length() == shared_message_->size() &&
+      (shared_message_->empty() ||
+       origin_message_.frontSlice().mem_ == shared_message_->data())) {
+    return shared_message_;
+  }
+  return std::make_shared<const std::string>(origin_message_.toString());
+}
+
+void MetadataImpl::shareOriginMessage(std::shared_ptr<const std::string> message) {
+  ASSERT(origin_message_.length() == 0);
+  if (!message->empty()) {
+    // The fragment keeps the bytes alive until the buffer releases it.
+    auto* fragment = new Buffer::BufferFragmentImpl(
+        message->data(), message->size(),
+        [message](const void*, size_t, const Buffer::BufferFragmentImpl* fragment) {
+          delete fragment;
+        });
+    origin_message_.addBufferFragment(*fragment);
+  }
+  shared_message_ = std::move(message);
+}
+
 // Tracing::TraceContext
 void MetadataImpl::forEach(Envoy::Tracing::TraceContext::IterateCallback callback) const {
   for (const auto& [key, value] : properties_) {
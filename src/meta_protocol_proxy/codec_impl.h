@@ -72,8 +72,14 @@ public:
 
 private:
   const std::string* getStringPointer(std::string key) const;
+  // The bytes of the message as shared by clones, the first clone of a message copies them once.
+  std::shared_ptr<const std::string> sharedOriginMessage() const;
+  void shareOriginMessage(std::shared_ptr<const std::string> message);
+
   std::map<std::string, std::any> properties_;
   Buffer::OwnedImpl origin_message_;
+  // The immutable bytes origin_message_ references if it was created by clone()
+  std::shared_ptr<const std::string> shared_message_;
   MessageType message_type_{MessageType::Request};
   ResponseStatus response_status_{ResponseStatus::Ok};
   uint64_t request_id_{0};
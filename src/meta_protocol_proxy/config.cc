@@ -57,7 +57,9 @@ Network::FilterFactoryCb MetaProtocolProxyFilterConfigFactory::createFilterFacto
   return [singletons, filter_config, &context](Network::FilterManager& filter_manager) -> void {
     filter_manager.addReadFilter(std::make_shared<ConnectionManager>(
         *filter_config, context.serverFactoryContext().api().randomGenerator(),
-        context.serverFactoryContext().mainThreadDispatcher().timeSource(), context.serverFactoryContext().clusterManager()));
+        context.serverFactoryContext().mainThreadDispatcher().timeSource(),
+        context.serverFactoryContext().clusterManager(),
+        context.serverFactoryContext().overloadManager()));
   };
 }
 
@@ -77,14 +79,25 @@ ConfigImpl::ConfigImpl(const MetaProtocolProxyConfig& config,
       stats_prefix_(
           fmt::format("meta_protocol.{}.{}.", applicationProtocol(), config.stat_prefix())),
       stats_(MetaProtocolProxyStats::generateStats(stats_prefix_, context_.scope())),
-      route_config_provider_manager_(route_config_provider_manager) {
+      route_config_provider_manager_(route_config_provider_manager),
+      request_body_streaming_threshold_(config.request_body_streaming_threshold()),
+      per_connection_buffer_limit_bytes_(
+          PROTOBUF_GET_WRAPPED_OR_DEFAULT(config, per_connection_buffer_limit_bytes, UINT32_MAX)),
+      max_active_messages_per_connection_(config.max_active_messages_per_connection()),
+      max_concurrent_streams_per_connection_(config.max_concurrent_streams_per_connection()) {
   ENVOY_LOG(trace, "********** MetaProtocolProxy ConfigImpl constructor ***********");
+  resolveCodecFactory();
+
   // check idle_timer config
   if (config.has_idle_timeout()) {
     const uint64_t timeout = DurationUtil::durationToMilliseconds(config.idle_timeout());
     ENVOY_LOG(debug, "debug for idle_timeout-{}", timeout);
     idle_timeout_ = std::chrono::milliseconds(timeout);
   }
+  if (config.has_stream_idle_timeout()) {
+    stream_idle_timeout_ = std::chrono::milliseconds(
+        DurationUtil::durationToMilliseconds(config.stream_idle_timeout()));
+  }
 
   switch (config.route_specifier_case()) {
   case aeraki::meta_protocol_proxy::v1alpha::MetaProtocolProxy::RouteSpecifierCase::kRds:
@@ -156,15 +169,33 @@ ConfigImpl::ConfigImpl(const MetaProtocolProxyConfig& config,
     const uint32_t max_tag_length = PROTOBUF_GET_WRAPPED_OR_DEFAULT(
         tracing_config, max_tag_length, Envoy::Tracing::DefaultMaxPathTagLength);
 
+    const auto& metadata_tags_config = tracing_config.metadata_tags();
+    Tracing::MetadataTags metadata_tags(
+        metadata_tags_config.allow_all(),
+        {metadata_tags_config.allowed_keys().begin(), metadata_tags_config.allowed_keys().end()},
+        {metadata_tags_config.denied_keys().begin(), metadata_tags_config.denied_keys().end()});
+
     tracing_config_ = std::make_unique<Tracing::TracingConfigImpl>(
         tracing_operation_name, client_sampling, random_sampling, overall_sampling,
-        tracing_config.verbose(), max_tag_length);
+        tracing_config.verbose(), max_tag_length, std::move(metadata_tags));
+  }
+  if (config.request_id_format() ==
+      aeraki::meta_protocol_proxy::v1alpha::MetaProtocolProxy::BINARY) {
+    request_id_extension_ = std::make_shared<BinaryRequestIDExtension>(
+        context.serverFactoryContext().api().randomGenerator());
+  } else {
+    request_id_extension_ = std::make_shared<UUIDRequestIDExtension>(
+        context.serverFactoryContext().api().randomGenerator());
   }
-  request_id_extension_ = std::make_shared<UUIDRequestIDExtension>(context.serverFactoryContext().api().randomGenerator());
 
   for (const envoy::config::accesslog::v3::AccessLog& log_config : config.access_log()) {
     access_logs_.emplace_back(AccessLog::AccessLogFactory::fromProto(log_config, context));
   }
+  if (config.has_binary_access_log()) {
+    binary_access_log_ = std::make_unique<BinaryAccessLog>(
+        config.binary_access_log(), context.serverFactoryContext().api(),
+        context.serverFactoryContext().threadLocal(), stats_.binary_access_log_dropped_);
+  }
 }
 
 /**
@@ -203,13 +234,31 @@ Route::RouteConstSharedPtr ConfigImpl::route(const Metadata& metadata,
   // return route_matcher_->route(metadata, random_value);
 }
 
-CodecPtr ConfigImpl::createCodec() {
-  auto& factory = Envoy::Config::Utility::getAndCheckFactoryByName<NamedCodecConfigFactory>(
+ProtocolDecoderPtr ConfigImpl::createDecoder() {
+  ASSERT(codec_factory_ != nullptr);
+  return codec_factory_->createDecoder(*codec_proto_config_);
+}
+
+const EncoderSharedPtr& ConfigImpl::encoder() {
+  return encoder_tls_->getTyped<ThreadLocalEncoder>().encoder_;
+}
+
+void ConfigImpl::resolveCodecFactory() {
+  codec_factory_ = &Envoy::Config::Utility::getAndCheckFactoryByName<NamedCodecConfigFactory>(
       getCodecConfig().name());
-  ProtobufTypes::MessagePtr message = factory.createEmptyConfigProto();
-  Envoy::Config::Utility::translateOpaqueConfig(getCodecConfig().config(),
-                                                context_.messageValidationVisitor(), *message);
-  return factory.createCodec(*message);
+  codec_proto_config_ = codec_factory_->createEmptyConfigProto();
+  Envoy::Config::Utility::translateOpaqueConfig(
+      getCodecConfig().config(), context_.messageValidationVisitor(), *codec_proto_config_);
+  if (codec_factory_->createEncoder(*codec_proto_config_) == nullptr) {
+    throw EnvoyException(fmt::format("meta protocol codec {} doesn't provide an encoder",
+                                     getCodecConfig().name()));
+  }
+
+  encoder_tls_ = context_.serverFactoryContext().threadLocal().allocateSlot();
+  encoder_tls_->set([factory = codec_factory_, proto_config = codec_proto_config_.get()](
+                        Event::Dispatcher&) -> ThreadLocal::ThreadLocalObjectSharedPtr {
+    return std::make_shared<ThreadLocalEncoder>(factory->createEncoder(*proto_config));
+  });
 }
 
 void ConfigImpl::registerFilter(const MetaProtocolFilterConfig& proto_config) {
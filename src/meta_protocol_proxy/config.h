@@ -7,11 +7,14 @@
 #include "api/meta_protocol_proxy/v1alpha/meta_protocol_proxy.pb.validate.h"
 
 #include "envoy/access_log/access_log.h"
+#include "envoy/thread_local/thread_local.h"
 #include "envoy/tracing/trace_driver.h"
 
 #include "source/extensions/filters/network/common/factory_base.h"
 #include "source/extensions/filters/network/well_known_names.h"
 
+#include "src/meta_protocol_proxy/access_log/binary_access_log.h"
+#include "src/meta_protocol_proxy/codec/factory.h"
 #include "src/meta_protocol_proxy/conn_manager.h"
 #include "src/meta_protocol_proxy/filters/filter.h"
 #include "src/meta_protocol_proxy/route/route_config_provider_manager.h"
@@ -90,7 +93,8 @@ public:
   MetaProtocolProxyStats& stats() override { return stats_; }
   FilterChainFactory& filterFactory() override { return *this; }
   Route::Config& routerConfig() override { return *this; }
-  CodecPtr createCodec() override;
+  ProtocolDecoderPtr createDecoder() override;
+  const EncoderSharedPtr& encoder() override;
   std::string applicationProtocol() override {
     return application_protocol_config_.name().empty() ? application_protocol_
                                                        : application_protocol_config_.name();
@@ -102,7 +106,20 @@ public:
   const std::vector<AccessLog::InstanceSharedPtr>& accessLogs() const override {
     return access_logs_;
   }
+  BinaryAccessLog* binaryAccessLog() override { return binary_access_log_.get(); }
   bool multiplexing() override { return application_protocol_config_.multiplexing(); }
+  uint32_t requestBodyStreamingThreshold() override { return request_body_streaming_threshold_; }
+  uint64_t maxMessageLength() override { return application_protocol_config_.max_message_length(); }
+  uint32_t perConnectionBufferLimitBytes() override { return per_connection_buffer_limit_bytes_; }
+  uint32_t maxActiveMessagesPerConnection() override {
+    return max_active_messages_per_connection_;
+  }
+  uint32_t maxConcurrentStreamsPerConnection() override {
+    return max_concurrent_streams_per_connection_;
+  }
+  absl::optional<std::chrono::milliseconds> streamIdleTimeout() override {
+    return stream_idle_timeout_;
+  }
 
 private:
   void registerFilter(const MetaProtocolFilterConfig& proto_config);
@@ -113,24 +130,43 @@ private:
   const envoy::config::trace::v3::Tracing_Http*
   getPerFilterTracerConfig(const MetaProtocolProxyConfig& config);
 
+  struct ThreadLocalEncoder : public ThreadLocal::ThreadLocalObject {
+    ThreadLocalEncoder(EncoderSharedPtr encoder) : encoder_(std::move(encoder)) {}
+    const EncoderSharedPtr encoder_;
+  };
+
   const CodecConfig& getCodecConfig();
+  void resolveCodecFactory();
 
   Server::Configuration::FactoryContext& context_;
   // Router::RouteMatcherPtr route_matcher_;
   std::string application_protocol_;
   CodecConfig codecConfig_;
   ApplicationProtocolConfig application_protocol_config_;
+  // Decoders are created for every downstream connection and upstream response, so the codec
+  // factory and its typed config are resolved once when the config is loaded.
+  NamedCodecConfigFactory* codec_factory_{};
+  ProtobufTypes::MessagePtr codec_proto_config_;
+  // Encoders are stateless, each worker creates one and shares it among all its connections.
+  ThreadLocal::SlotPtr encoder_tls_;
   const std::string stats_prefix_;
   MetaProtocolProxyStats stats_;
   std::list<FilterFactoryCb> filter_factories_;
   Route::RouteConfigProviderSharedPtr route_config_provider_;
   Route::RouteConfigProviderManager& route_config_provider_manager_;
   absl::optional<std::chrono::milliseconds> idle_timeout_;
+  const uint32_t request_body_streaming_threshold_;
+  const uint32_t per_connection_buffer_limit_bytes_;
+  const uint32_t max_active_messages_per_connection_;
+  const uint32_t max_concurrent_streams_per_connection_;
+  absl::optional<std::chrono::milliseconds> stream_idle_timeout_;
   MetaProtocolProxy::Tracing::MetaProtocolTracerSharedPtr tracer_{
       std::make_shared<MetaProtocolProxy::Tracing::NullTracer>()};
   Tracing::TracingConfigPtr tracing_config_;
   RequestIDExtensionSharedPtr request_id_extension_;
   std::vector<AccessLog::InstanceSharedPtr> access_logs_;
+  // declared after stats_, the writer thread counts the dropped records until it's destroyed
+  std::unique_ptr<BinaryAccessLog> binary_access_log_;
 };
 
 } // namespace MetaProtocolProxy
@@ -15,15 +15,16 @@ namespace NetworkFilters {
 namespace MetaProtocolProxy {
 
 /**
- * Config is a configuration interface for ConnectionManager.
+ * Config is a configuration interface for ConnectionManager. As a CodecFactory, it creates the
+ * decoders of the downstream connections and the upstream responses, and provides the encoder of
+ * the current worker, which is shared by all the connections of the worker.
  */
-class Config {
+class Config : public CodecFactory {
 public:
-  virtual ~Config() = default;
+  ~Config() override = default;
 
   virtual FilterChainFactory& filterFactory() PURE;
   virtual MetaProtocolProxyStats& stats() PURE;
-  virtual CodecPtr createCodec() PURE;
   virtual Route::Config& routerConfig() PURE;
   virtual std::string applicationProtocol() PURE;
   virtual absl::optional<std::chrono::milliseconds> idleTimeout() PURE;
@@ -37,7 +38,37 @@ public:
   virtual Tracing::TracingConfig* tracingConfig() PURE;
   virtual RequestIDExtensionSharedPtr requestIDExtension() PURE;
   virtual const std::vector<AccessLog::InstanceSharedPtr>& accessLogs() const PURE;
+  /**
+   * @return BinaryAccessLog* the binary access log, nullptr if it's not enabled.
+   */
+  virtual BinaryAccessLog* binaryAccessLog() PURE;
   virtual bool multiplexing() PURE;
+  /**
+   * @return uint32_t the length above which the body of a request is forwarded while it's still
+   *         being received, 0 if requests are always buffered.
+   */
+  virtual uint32_t requestBodyStreamingThreshold() PURE;
+  /**
+   * @return uint64_t the maximum length of a request of the application protocol, 0 if it's
+   *         unlimited.
+   */
+  virtual uint64_t maxMessageLength() PURE;
+  /**
+   * @return uint32_t the buffer limit of a downstream connection, also the maximum length of an
+   *         undecoded request.
+   */
+  virtual uint32_t perConnectionBufferLimitBytes() PURE;
+  /**
+   * @return uint32_t the maximum number of active messages of a downstream connection, 0 if it's
+   *         unlimited.
+   */
+  virtual uint32_t maxActiveMessagesPerConnection() PURE;
+  /**
+   * @return uint32_t the maximum number of open streams of a downstream connection, 0 if it's
+   *         unlimited.
+   */
+  virtual uint32_t maxConcurrentStreamsPerConnection() PURE;
+  virtual absl::optional<std::chrono::milliseconds> streamIdleTimeout() PURE;
 };
 
 } // namespace MetaProtocolProxy
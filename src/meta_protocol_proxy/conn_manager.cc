@@ -5,6 +5,7 @@
 #include "envoy/common/exception.h"
 
 #include "source/common/common/fmt.h"
+#include "source/common/stats/timespan_impl.h"
 #include "src/meta_protocol_proxy/app_exception.h"
 #include "src/meta_protocol_proxy/heartbeat_response.h"
 #include "src/meta_protocol_proxy/codec_impl.h"
@@ -15,15 +16,27 @@ namespace Extensions {
 namespace NetworkFilters {
 namespace MetaProtocolProxy {
 
-constexpr uint32_t BufferLimit = UINT32_MAX;
-
 ConnectionManager::ConnectionManager(Config& config, Random::RandomGenerator& random_generator,
                                      TimeSource& time_system,
-                                     Upstream::ClusterManager& cluster_manager)
+                                     Upstream::ClusterManager& cluster_manager,
+                                     Server::OverloadManager& overload_manager)
     : config_(config), time_system_(time_system), stats_(config_.stats()),
-      random_generator_(random_generator), codec_(config.createCodec()),
-      decoder_(std::make_unique<RequestDecoder>(*codec_, *this)),
-      cluster_manager_(cluster_manager) {}
+      random_generator_(random_generator), protocol_decoder_(config.createDecoder()),
+      encoder_(encoderFor(*protocol_decoder_, *config.encoder())),
+      decoder_(std::make_unique<RequestDecoder>(*protocol_decoder_, *this)),
+      overload_stop_accepting_requests_ref_(
+          overload_manager.getThreadLocalOverloadState().getState(
+              Server::OverloadActionNames::get().StopAcceptingRequests)),
+      overload_disable_keepalive_ref_(overload_manager.getThreadLocalOverloadState().getState(
+          Server::OverloadActionNames::get().DisableHttpKeepAlive)),
+      cluster_manager_(cluster_manager) {
+  decoder_->setMaxMessageLength(config_.maxMessageLength());
+  // The body of a streamed request can't be interleaved with other requests on a multiplexed
+  // upstream connection.
+  if (!config_.multiplexing()) {
+    decoder_->setBodyStreamingThreshold(config_.requestBodyStreamingThreshold());
+  }
+}
 
 Network::FilterStatus ConnectionManager::onData(Buffer::Instance& data, bool end_stream) {
   ENVOY_LOG(debug, "meta protocol: read {} bytes", data.length());
@@ -43,10 +56,12 @@ Network::FilterStatus ConnectionManager::onData(Buffer::Instance& data, bool end
 }
 
 Network::FilterStatus ConnectionManager::onNewConnection() {
-  // init idle timer.
+  // init idle timer. It's a scaled timer so that the reduce_timeouts overload action shortens it,
+  // as it does for the idle timeout of HTTP downstream connections.
   if (config_.idleTimeout()) {
-    idle_timer_ =
-        read_callbacks_->connection().dispatcher().createTimer([this]() { this->onIdleTimeout(); });
+    idle_timer_ = read_callbacks_->connection().dispatcher().createScaledTimer(
+        Event::ScaledTimerType::HttpDownstreamIdleConnectionTimeout,
+        [this]() { this->onIdleTimeout(); });
     resetIdleTimer();
   }
   return Network::FilterStatus::Continue;
@@ -56,7 +71,7 @@ void ConnectionManager::initializeReadFilterCallbacks(Network::ReadFilterCallbac
   read_callbacks_ = &callbacks;
   read_callbacks_->connection().addConnectionCallbacks(*this);
   read_callbacks_->connection().enableHalfClose(true);
-  read_callbacks_->connection().setBufferLimits(BufferLimit);
+  read_callbacks_->connection().setBufferLimits(config_.perConnectionBufferLimitBytes());
 }
 
 void ConnectionManager::onEvent(Network::ConnectionEvent event) {
@@ -64,22 +79,83 @@ void ConnectionManager::onEvent(Network::ConnectionEvent event) {
   if (event == Network::ConnectionEvent::LocalClose) {
     disableIdleTimer();
     resetAllMessages(true);
+    clearStream();
     resetUpstreamHandlerManager();
   } else if (event == Network::ConnectionEvent::RemoteClose) {
     disableIdleTimer();
     resetAllMessages(false);
+    clearStream();
     resetUpstreamHandlerManager();
   }
 }
 
 void ConnectionManager::onAboveWriteBufferHighWatermark() {
   ENVOY_CONN_LOG(debug, "onAboveWriteBufferHighWatermark", read_callbacks_->connection());
-  read_callbacks_->connection().readDisable(true);
+  pauseReading(ReadPauseReason::WriteBufferFull);
 }
 
 void ConnectionManager::onBelowWriteBufferLowWatermark() {
   ENVOY_CONN_LOG(debug, "onBelowWriteBufferLowWatermark", read_callbacks_->connection());
-  read_callbacks_->connection().readDisable(false);
+  resumeReading(ReadPauseReason::WriteBufferFull);
+}
+
+void ConnectionManager::pauseReading(ReadPauseReason reason) {
+  const bool paused = read_pause_reasons_ != 0;
+  read_pause_reasons_ |= reason;
+  if (paused) {
+    return;
+  }
+  ENVOY_CONN_LOG(debug, "meta protocol: pause reading, reason {}", read_callbacks_->connection(),
+                 static_cast<int>(reason));
+  stats_.downstream_flow_control_paused_reading_total_.inc();
+  read_paused_timer_ = std::make_unique<Stats::HistogramCompletableTimespanImpl>(
+      stats_.downstream_flow_control_paused_time_ms_, time_system_);
+  if (read_callbacks_->connection().state() == Network::Connection::State::Open) {
+    read_callbacks_->connection().readDisable(true);
+  }
+}
+
+void ConnectionManager::resumeReading(ReadPauseReason reason) {
+  if ((read_pause_reasons_ & reason) == 0) {
+    return;
+  }
+  read_pause_reasons_ &= ~reason;
+  if (read_pause_reasons_ != 0) {
+    return;
+  }
+  ENVOY_CONN_LOG(debug, "meta protocol: resume reading", read_callbacks_->connection());
+  stats_.downstream_flow_control_resumed_reading_total_.inc();
+  read_paused_timer_->complete();
+  read_paused_timer_.reset();
+  if (read_callbacks_->connection().state() == Network::Connection::State::Open) {
+    read_callbacks_->connection().readDisable(false);
+  }
+}
+
+void ConnectionManager::onStreamWindowExhausted() {
+  if (streams_out_of_window_++ == 0) {
+    pauseReading(ReadPauseReason::StreamWindowExhausted);
+  }
+}
+
+void ConnectionManager::onStreamWindowAvailable() {
+  ASSERT(streams_out_of_window_ > 0);
+  if (--streams_out_of_window_ == 0) {
+    resumeReading(ReadPauseReason::StreamWindowExhausted);
+  }
+}
+
+void ConnectionManager::onUpstreamBodyBackpressure() {
+  if (messages_under_backpressure_++ == 0) {
+    pauseReading(ReadPauseReason::UpstreamBodyBackpressure);
+  }
+}
+
+void ConnectionManager::onUpstreamBodyBackpressureRelieved() {
+  ASSERT(messages_under_backpressure_ > 0);
+  if (--messages_under_backpressure_ == 0) {
+    resumeReading(ReadPauseReason::UpstreamBodyBackpressure);
+  }
 }
 
 MessageHandler& ConnectionManager::newMessageHandler() {
@@ -101,11 +177,25 @@ bool ConnectionManager::onHeartbeat(MetadataSharedPtr metadata) {
   HeartbeatResponse heartbeat;
   Buffer::OwnedImpl response_buffer;
 
-  heartbeat.encode(*metadata, *codec_, response_buffer);
+  heartbeat.encode(*metadata, encoder_, response_buffer);
   read_callbacks_->connection().write(response_buffer, false);
   return false;
 }
 
+void ConnectionManager::onMessageBody(Buffer::Instance& data, bool end_of_message) {
+  if (streaming_message_ == nullptr) {
+    ENVOY_LOG(debug, "meta protocol: drop {} bytes of the body of a reset request", data.length());
+    data.drain(data.length());
+    return;
+  }
+
+  ActiveMessage* message = streaming_message_;
+  if (end_of_message) {
+    streaming_message_ = nullptr;
+  }
+  message->onMessageBody(data, end_of_message);
+}
+
 void ConnectionManager::dispatch() {
   if (0 == request_buffer_.length()) {
     ENVOY_LOG(debug, "meta protocol: it's empty data");
@@ -121,14 +211,91 @@ void ConnectionManager::dispatch() {
     // 2. all the messages in the buffer have been processed, in this case, the buffer is already
     // empty.
     while (!underflow) {
-      decoder_->onData(request_buffer_, underflow);
+      if (tooManyActiveMessages()) {
+        // the rest of the buffer is decoded once one of the active messages completes
+        pauseReading(ReadPauseReason::TooManyActiveMessages);
+        return;
+      }
+      if (!decoder_->onData(request_buffer_, underflow)) {
+        onDecodingError(decoder_->errorDetail());
+        return;
+      }
+    }
+    // The decoder is waiting for the rest of a message, which would never fit in the buffer.
+    if (request_buffer_.length() > config_.perConnectionBufferLimitBytes()) {
+      onRequestBufferOverflow();
     }
     return;
   } catch (const EnvoyException& ex) {
-    ENVOY_CONN_LOG(error, "meta protocol error: {}", read_callbacks_->connection(), ex.what());
-    read_callbacks_->connection().close(Network::ConnectionCloseType::NoFlush);
-    stats_.request_decoding_error_.inc();
+    // the codecs which report protocol errors by throwing
+    onDecodingError(ex.what());
+  }
+}
+
+bool ConnectionManager::tooManyActiveMessages() const {
+  const uint32_t max_active_messages = config_.maxActiveMessagesPerConnection();
+  // The body of a streamed request must be forwarded for the request to complete.
+  return max_active_messages > 0 && streaming_message_ == nullptr &&
+         active_message_list_.size() >= max_active_messages;
+}
+
+void ConnectionManager::onActiveMessageSlotAvailable() {
+  if ((read_pause_reasons_ & ReadPauseReason::TooManyActiveMessages) == 0 ||
+      tooManyActiveMessages() ||
+      read_callbacks_->connection().state() != Network::Connection::State::Open) {
+    return;
+  }
+  if (resume_dispatch_callback_ == nullptr) {
+    resume_dispatch_callback_ =
+        read_callbacks_->connection().dispatcher().createSchedulableCallback([this]() {
+          resumeReading(ReadPauseReason::TooManyActiveMessages);
+          dispatch();
+        });
+  }
+  resume_dispatch_callback_->scheduleCallbackCurrentIteration();
+}
+
+bool ConnectionManager::shouldRejectForOverload() {
+  // The requests are rejected at the probability of the pressure, like the HTTP connection
+  // manager does.
+  if (!random_generator_.bernoulli(overload_stop_accepting_requests_ref_.value())) {
+    return false;
   }
+  stats_.request_overload_rejected_.inc();
+  maybeCloseIdleUpstreamHandlers();
+  return true;
+}
+
+void ConnectionManager::maybeCloseIdleUpstreamHandlers() {
+  if (!config_.multiplexing() ||
+      !random_generator_.bernoulli(overload_disable_keepalive_ref_.value()) ||
+      read_callbacks_->connection().state() != Network::Connection::State::Open) {
+    return;
+  }
+  if (close_idle_upstream_callback_ == nullptr) {
+    close_idle_upstream_callback_ =
+        read_callbacks_->connection().dispatcher().createSchedulableCallback([this]() {
+          const uint32_t closed = upstream_handler_manager_.closeIdle();
+          ENVOY_CONN_LOG(debug, "meta protocol: overloaded, closed {} idle upstream connections",
+                         read_callbacks_->connection(), closed);
+          stats_.upstream_cx_overload_shed_.add(closed);
+        });
+  }
+  close_idle_upstream_callback_->scheduleCallbackCurrentIteration();
+}
+
+void ConnectionManager::onRequestBufferOverflow() {
+  ENVOY_CONN_LOG(error, "meta protocol: the request exceeds the buffer limit of {} bytes",
+                 read_callbacks_->connection(), config_.perConnectionBufferLimitBytes());
+  read_callbacks_->connection().close(Network::ConnectionCloseType::NoFlush);
+  stats_.request_buffer_overflow_.inc();
+  resetAllMessages(true);
+}
+
+void ConnectionManager::onDecodingError(absl::string_view detail) {
+  ENVOY_CONN_LOG(error, "meta protocol error: {}", read_callbacks_->connection(), detail);
+  read_callbacks_->connection().close(Network::ConnectionCloseType::NoFlush);
+  stats_.request_decoding_error_.inc();
   resetAllMessages(true);
 }
 
@@ -142,7 +309,7 @@ void ConnectionManager::sendLocalReply(Metadata& metadata, const DirectResponse&
 
   try {
     Buffer::OwnedImpl buffer;
-    result = response.encode(metadata, *codec_, buffer);
+    result = response.encode(metadata, encoder_, buffer);
 
     read_callbacks_->connection().write(buffer, end_stream);
   } catch (const EnvoyException& ex) {
@@ -170,9 +337,15 @@ void ConnectionManager::sendLocalReply(Metadata& metadata, const DirectResponse&
 
 Stream& ConnectionManager::newActiveStream(uint64_t stream_id) {
   ENVOY_CONN_LOG(debug, "meta protocol: create an active stream: {}", connection(), stream_id);
-  StreamPtr new_stream(std::make_unique<Stream>(stream_id, connection(), *this, *codec_));
-  active_stream_map_[stream_id] = std::move(new_stream);
-  return *active_stream_map_.find(stream_id)->second;
+  auto iter = active_stream_map_.find(stream_id);
+  if (iter != active_stream_map_.end()) {
+    // the client reuses the id of a stream it considers closed
+    iter->second->reset();
+  }
+  auto& stream = active_stream_map_[stream_id];
+  stream = std::make_unique<Stream>(stream_id, connection(), *this, *protocol_decoder_);
+  stats_.stream_active_.inc();
+  return *stream;
 }
 
 Stream& ConnectionManager::getActiveStream(uint64_t stream_id) {
@@ -186,19 +359,45 @@ bool ConnectionManager::streamExisted(uint64_t stream_id) {
   return (iter != active_stream_map_.end());
 }
 
+bool ConnectionManager::tooManyStreams() const {
+  const uint32_t max_streams = config_.maxConcurrentStreamsPerConnection();
+  return max_streams > 0 && active_stream_map_.size() >= max_streams;
+}
+
 void ConnectionManager::closeStream(uint64_t stream_id) {
   ENVOY_LOG(debug, "meta protocol: close stream {} ", stream_id);
-  active_stream_map_.erase(stream_id);
+  auto iter = active_stream_map_.find(stream_id);
+  if (iter == active_stream_map_.end()) {
+    return;
+  }
+  // The stream may be closing from one of its own callbacks.
+  read_callbacks_->connection().dispatcher().deferredDelete(std::move(iter->second));
+  active_stream_map_.erase(iter);
+  stats_.stream_active_.dec();
+}
+
+void ConnectionManager::clearStream() {
+  // resetting a stream removes it from the map
+  while (!active_stream_map_.empty()) {
+    active_stream_map_.begin()->second->reset();
+  }
 }
 
 void ConnectionManager::deferredDeleteMessage(ActiveMessage& message) {
   if (!message.inserted()) {
     return;
   }
+  if (streaming_message_ == &message) {
+    streaming_message_ = nullptr;
+  }
   ENVOY_LOG(debug, "meta protocol: deferred delete message, id is {}",
             message.metadata()->getRequestId());
   read_callbacks_->connection().dispatcher().deferredDelete(
       message.removeFromList(active_message_list_));
+  onActiveMessageSlotAvailable();
+  if (active_message_list_.empty()) {
+    maybeCloseIdleUpstreamHandlers();
+  }
 }
 
 void ConnectionManager::resetAllMessages(bool local_reset) {
@@ -272,7 +471,7 @@ ConnectionManager::getUpstreamHandler(const std::string& cluster_name,
             tcp_pool_data.value().host()->address()->asString());
 
   auto new_upstream_handler = std::make_shared<UpstreamHandlerImpl>(
-      key, read_callbacks_->connection(), config_,
+      key, &read_callbacks_->connection(), config_,
       [this](const std::string& key) { this->upstream_handler_manager_.del(key); });
   ASSERT(new_upstream_handler);
 
@@ -1,14 +1,18 @@
 #pragma once
 
 #include "envoy/common/time.h"
+#include "envoy/event/schedulable_cb.h"
 #include "envoy/event/timer.h"
 #include "envoy/network/connection.h"
 #include "envoy/network/filter.h"
+#include "envoy/server/overload/overload_manager.h"
 #include "envoy/stats/timespan.h"
 #include "envoy/upstream/cluster_manager.h"
 
 #include "source/common/common/logger.h"
 
+#include "absl/container/flat_hash_map.h"
+
 #include "api/meta_protocol_proxy/v1alpha/meta_protocol_proxy.pb.h"
 
 #include "src/meta_protocol_proxy/codec/codec.h"
@@ -36,7 +40,8 @@ class ConnectionManager : public Network::ReadFilter,
                           Logger::Loggable<Logger::Id::filter> {
 public:
   ConnectionManager(Config& config, Random::RandomGenerator& random_generator,
-                    TimeSource& time_system, Upstream::ClusterManager& cluster_manager);
+                    TimeSource& time_system, Upstream::ClusterManager& cluster_manager,
+                    Server::OverloadManager& overload_manager);
   ~ConnectionManager() override {
     ENVOY_LOG(trace, "********** ConnectionManager destructed ***********");
   };
@@ -54,6 +59,7 @@ public:
   // RequestDecoderCallbacks
   MessageHandler& newMessageHandler() override;
   bool onHeartbeat(MetadataSharedPtr metadata) override;
+  void onMessageBody(Buffer::Instance& data, bool end_of_message) override;
 
   MetaProtocolProxyStats& stats() const { return stats_; }
   Network::Connection& connection() const { return read_callbacks_->connection(); }
@@ -62,18 +68,34 @@ public:
   Config& config() const { return config_; }
 
   void deferredDeleteMessage(ActiveMessage& message);
+  // Whether a new request should be rejected because the proxy is overloaded.
+  bool shouldRejectForOverload();
+  // The body of the request being decoded is streamed to the message.
+  void onMessageBodyStreaming(ActiveMessage& message) { streaming_message_ = &message; }
   void sendLocalReply(Metadata& metadata, const DirectResponse& response, bool end_stream);
 
   Stream& newActiveStream(uint64_t stream_id);
   Stream& getActiveStream(uint64_t stream_id);
   bool streamExisted(uint64_t stream_id);
+  // Whether the connection has reached the maximum number of open streams.
+  bool tooManyStreams() const;
   void closeStream(uint64_t stream_id);
-  void clearStream() { active_stream_map_.clear(); }
+  // Reset all the streams of the connection.
+  void clearStream();
+  // Reading from the downstream connection is paused while any of its streams has exhausted the
+  // window advertised by the upstream server.
+  void onStreamWindowExhausted();
+  void onStreamWindowAvailable();
+  // Reading from the downstream connection is paused while the upstream connection of any request
+  // whose body is forwarded as it's received is above its write buffer high watermark.
+  void onUpstreamBodyBackpressure();
+  void onUpstreamBodyBackpressureRelieved();
 
   Tracing::MetaProtocolTracerSharedPtr tracer() { return config_.tracer(); };
   Tracing::TracingConfig* tracingConfig() { return config_.tracingConfig(); };
   RequestIDExtensionSharedPtr requestIDExtension() { return config_.requestIDExtension(); };
   const std::vector<AccessLog::InstanceSharedPtr>& accessLogs() { return config_.accessLogs(); };
+  BinaryAccessLog* binaryAccessLog() { return config_.binaryAccessLog(); }
 
   GetUpstreamHandlerResult getUpstreamHandler(const std::string& cluster_name,
                                                       Upstream::LoadBalancerContext& context);
@@ -82,7 +104,27 @@ public:
   std::list<ActiveMessagePtr>& getActiveMessagesForTest() { return active_message_list_; }
 
 private:
+  // The reasons for pausing reading from the downstream connection, reading is resumed once all of
+  // them are cleared.
+  enum ReadPauseReason : uint8_t {
+    // the responses waiting to be written exceed the buffer limit
+    WriteBufferFull = 0x1,
+    // the connection has reached the maximum number of active messages
+    TooManyActiveMessages = 0x2,
+    // a stream has exhausted the window advertised by its server
+    StreamWindowExhausted = 0x4,
+    // the upstream connection of a request whose body is streamed can't take more of the body
+    UpstreamBodyBackpressure = 0x8,
+  };
+
   void dispatch();
+  bool tooManyActiveMessages() const;
+  void pauseReading(ReadPauseReason reason);
+  void resumeReading(ReadPauseReason reason);
+  void onActiveMessageSlotAvailable();
+  void onRequestBufferOverflow();
+  void onDecodingError(absl::string_view detail);
+  void maybeCloseIdleUpstreamHandlers();
   void resetAllMessages(bool local_reset);
 
   // This function is to deal with idle downstream's connection timeout.
@@ -96,19 +138,45 @@ private:
 
   Buffer::OwnedImpl request_buffer_;
   std::list<ActiveMessagePtr> active_message_list_;
-  std::map<uint64_t, StreamPtr> active_stream_map_;
+  // the open streams by stream id, a stream is removed as soon as it's closed and deleted at the
+  // end of the event loop iteration
+  absl::flat_hash_map<uint64_t, StreamPtr> active_stream_map_;
+  // the message which receives the body of the request being decoded, nullptr if the request is not
+  // streamed or the message has been reset, in which case the rest of the body is dropped
+  ActiveMessage* streaming_message_{};
 
   Config& config_;
   TimeSource& time_system_;
   MetaProtocolProxyStats& stats_;
   Random::RandomGenerator& random_generator_;
 
-  CodecPtr codec_;
+  ProtocolDecoderPtr protocol_decoder_;
+  // encodes the local replies and the heartbeat responses
+  Encoder& encoder_;
   RequestDecoderPtr decoder_;
   Network::ReadFilterCallbacks* read_callbacks_{};
   // timer for idle timeout
   Event::TimerPtr idle_timer_;
-  // upstream mng
+  // the reasons for which reading is paused, a bitmask of ReadPauseReason
+  uint8_t read_pause_reasons_{0};
+  // the number of streams which have exhausted the window of their server
+  uint32_t streams_out_of_window_{0};
+  // the number of requests whose upstream connection can't take more of their body
+  uint32_t messages_under_backpressure_{0};
+  Stats::TimespanPtr read_paused_timer_;
+  // resumes decoding once a message completes, the messages complete deep in the stack of filter
+  // and upstream callbacks, which is not a good place to decode new requests
+  Event::SchedulableCallbackPtr resume_dispatch_callback_;
+  // The overload actions are polled for each request. The states are updated by the overload
+  // manager on the worker thread, so reading them is cheap.
+  const Server::OverloadActionState& overload_stop_accepting_requests_ref_;
+  const Server::OverloadActionState& overload_disable_keepalive_ref_;
+  // closes the idle multiplexed upstream connections under memory pressure, from the top of the
+  // stack since the messages complete in the upstream connection callbacks
+  Event::SchedulableCallbackPtr close_idle_upstream_callback_;
+  // The multiplexed upstream connections of this downstream connection, one per host. They are not
+  // shared with the other downstream connections, which is what allows forwarding the request ids
+  // and the stream ids without rewriting them.
   UpstreamHandlerManager upstream_handler_manager_;
   Upstream::ClusterManager& cluster_manager_;
 };
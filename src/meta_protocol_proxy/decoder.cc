@@ -7,12 +7,38 @@ namespace NetworkFilters {
 namespace MetaProtocolProxy {
 
 ProtocolState DecoderStateMachine::onDecodeStream(Buffer::Instance& buffer) {
+  // Don't bother the message decoder until the whole message has arrived if it can tell the
+  // message length from the fixed header.
+  if (!protocol_decoder_started_) {
+    const uint64_t frame_length = protocol_decoder_.frameLength(buffer);
+    if (max_message_length_ > 0 && frame_length > max_message_length_) {
+      error_detail_ = fmt::format("the {} bytes message exceeds the maximum message length {}",
+                                  frame_length, max_message_length_);
+      return ProtocolState::Error;
+    }
+    if (frame_length > buffer.length()) {
+      // Large requests are routed once their head has arrived, rather than buffered.
+      if (head_streamable_ && body_streaming_threshold_ > 0 &&
+          frame_length > body_streaming_threshold_) {
+        return onDecodeHead(buffer, frame_length);
+      }
+      ENVOY_LOG(trace,
+                "meta protocol decoder: wait for the rest of the message, {} bytes available",
+                buffer.length());
+      return ProtocolState::WaitForData;
+    }
+  }
+
   auto metadata = std::make_shared<MetadataImpl>();
   metadata->setMessageType(messageType_);
-  auto decodeStatus = codec_.decode(buffer, *metadata);
+  auto decodeStatus = protocol_decoder_.decode(buffer, *metadata);
   if (decodeStatus == DecodeStatus::WaitForData) {
+    protocol_decoder_started_ = true;
     return ProtocolState::WaitForData;
   }
+  if (decodeStatus == DecodeStatus::Error) {
+    return ProtocolState::Error;
+  }
 
   if (metadata->getMessageType() == MessageType::Heartbeat) {
     ENVOY_LOG(debug, "meta protocol decoder: this is a heartbeat message");
@@ -31,22 +57,77 @@ ProtocolState DecoderStateMachine::onDecodeStream(Buffer::Instance& buffer) {
   return ProtocolState::Done;
 }
 
+ProtocolState DecoderStateMachine::onDecodeHead(Buffer::Instance& buffer, uint64_t frame_length) {
+  ASSERT(messageType_ == MessageType::Request);
+  const absl::optional<uint64_t> peeked_head_length = protocol_decoder_.headLength(buffer);
+  if (!peeked_head_length.has_value()) {
+    ENVOY_LOG(trace, "meta protocol decoder: the {} bytes message can't be streamed", frame_length);
+    head_streamable_ = false;
+    return ProtocolState::WaitForData;
+  }
+  if (peeked_head_length.value() == 0 || buffer.length() < peeked_head_length.value()) {
+    ENVOY_LOG(trace, "meta protocol decoder: wait for the head of the message, {} bytes available",
+              buffer.length());
+    return ProtocolState::WaitForData;
+  }
+
+  auto metadata = std::make_shared<MetadataImpl>();
+  metadata->setMessageType(messageType_);
+  const uint64_t head_length = protocol_decoder_.decodeHead(buffer, *metadata);
+  if (head_length == 0) {
+    // e.g. the head is invalid, decode reports it once the whole message has arrived
+    ENVOY_LOG(trace, "meta protocol decoder: the head of the {} bytes message can't be decoded",
+              frame_length);
+    head_streamable_ = false;
+    return ProtocolState::WaitForData;
+  }
+  ASSERT(head_length < frame_length);
+  ASSERT(metadata->getMessageType() == MessageType::Request);
+
+  ENVOY_LOG(debug, "meta protocol decoder: stream the body of the {} bytes request",
+            frame_length);
+  remaining_body_length_ = frame_length - head_length;
+  auto mutation = std::make_shared<Mutation>();
+  auto active_stream = delegate_.newStream(metadata, mutation);
+  ASSERT(active_stream);
+  active_stream->onStreamHeadDecoded();
+  return onStreamBody(buffer);
+}
+
+ProtocolState DecoderStateMachine::onStreamBody(Buffer::Instance& buffer) {
+  if (buffer.length() == 0) {
+    return ProtocolState::OnStreamBody;
+  }
+
+  if (buffer.length() <= remaining_body_length_) {
+    remaining_body_length_ -= buffer.length();
+    delegate_.onMessageBody(buffer, remaining_body_length_ == 0);
+    ASSERT(buffer.length() == 0);
+  } else {
+    // the buffer also holds the following messages
+    Buffer::OwnedImpl body;
+    body.move(buffer, remaining_body_length_);
+    remaining_body_length_ = 0;
+    delegate_.onMessageBody(body, true);
+  }
+  return remaining_body_length_ == 0 ? ProtocolState::Done : ProtocolState::OnStreamBody;
+}
+
 ProtocolState DecoderStateMachine::run(Buffer::Instance& buffer) {
   ASSERT(state_ != ProtocolState::Done);
   ENVOY_LOG(trace, "meta protocol decoder: state {}, {} bytes available",
             ProtocolStateNameValues::name(state_), buffer.length());
-  state_ = onDecodeStream(buffer);
+  state_ = state_ == ProtocolState::OnStreamBody ? onStreamBody(buffer) : onDecodeStream(buffer);
   return state_;
 }
 
-using DecoderStateMachinePtr = std::unique_ptr<DecoderStateMachine>;
-
-DecoderBase::DecoderBase(Codec& codec, MessageType messageType)
-    : codec_(codec), messageType_(messageType) {}
+DecoderBase::DecoderBase(ProtocolDecoder& protocol_decoder, MessageType messageType)
+    : protocol_decoder_(protocol_decoder), state_machine_(protocol_decoder, messageType, *this),
+      messageType_(messageType) {}
 
 DecoderBase::~DecoderBase() { complete(); }
 
-void DecoderBase::onData(Buffer::Instance& data, bool& buffer_underflow) {
+bool DecoderBase::onData(Buffer::Instance& data, bool& buffer_underflow) {
   ENVOY_LOG(debug, "MetaProtocol decoder: {} bytes available", data.length());
   buffer_underflow = false;
 
@@ -54,18 +135,22 @@ void DecoderBase::onData(Buffer::Instance& data, bool& buffer_underflow) {
   if (!decode_started_) {
     start();
   }
-  ASSERT(state_machine_ != nullptr);
 
   ENVOY_LOG(debug, "MetaProtocol decoder: state {}, {} bytes available",
-            ProtocolStateNameValues::name(state_machine_->currentState()), data.length());
+            ProtocolStateNameValues::name(state_machine_.currentState()), data.length());
 
-  ProtocolState state = state_machine_->run(data);
+  ProtocolState state = state_machine_.run(data);
   switch (state) {
   case ProtocolState::WaitForData:
+  case ProtocolState::OnStreamBody:
     ENVOY_LOG(debug, "MetaProtocol decoder: wait for data");
     // set buffer_underflow as true if we need more data to complete decoding of the current message
     buffer_underflow = true;
-    return;
+    return true;
+  case ProtocolState::Error:
+    ENVOY_LOG(debug, "MetaProtocol decoder: protocol error");
+    complete();
+    return false;
   default:
     break;
   }
@@ -78,14 +163,14 @@ void DecoderBase::onData(Buffer::Instance& data, bool& buffer_underflow) {
   // break the outer dispatching loop
   buffer_underflow = (data.length() == 0);
   ENVOY_LOG(debug, "MetaProtocol decoder: data length {}", data.length());
-  return;
+  return true;
 }
 
 /**
  * Start to decode a message
  */
 void DecoderBase::start() {
-  state_machine_ = std::make_unique<DecoderStateMachine>(codec_, messageType_, *this);
+  state_machine_.reset();
   decode_started_ = true;
 }
 
@@ -93,7 +178,6 @@ void DecoderBase::start() {
  * Finishing decoding a message
  */
 void DecoderBase::complete() {
-  state_machine_.reset();
   stream_.reset();
   decode_started_ = false;
 }
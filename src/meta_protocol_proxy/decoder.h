@@ -15,7 +15,9 @@ namespace MetaProtocolProxy {
 #define ALL_PROTOCOL_STATES(FUNCTION)                                                              \
   FUNCTION(WaitForData)                                                                            \
   FUNCTION(OnDecodeStreamData)                                                                     \
-  FUNCTION(Done)
+  FUNCTION(OnStreamBody)                                                                           \
+  FUNCTION(Done)                                                                                   \
+  FUNCTION(Error)
 
 /**
  * ProtocolState represents a set of states used in a state machine to decode requests and
@@ -50,6 +52,12 @@ struct ActiveStream {
     handler_.onMessageDecoded(metadata_, mutation_);
   }
 
+  void onStreamHeadDecoded() {
+    ASSERT(metadata_ && mutation_);
+    handler_.onMessageBodyStreaming();
+    handler_.onMessageDecoded(metadata_, mutation_);
+  }
+
   MessageHandler& handler_;
   MetadataSharedPtr metadata_;
   MutationSharedPtr mutation_;
@@ -70,15 +78,54 @@ public:
      * @return whether to continue waiting for response
      */
     virtual bool onHeartbeat(MetadataSharedPtr metadata) PURE;
+
+    /**
+     * Handle a part of the body of a request whose head has been decoded alone
+     * @param data the part of the body, it must be drained by the delegate
+     * @param end_of_message whether it's the last part of the body
+     */
+    virtual void onMessageBody(Buffer::Instance& data, bool end_of_message) PURE;
   };
 
-  DecoderStateMachine(Codec& codec, MessageType messageType, Delegate& delegate)
-      : codec_(codec), messageType_(messageType), delegate_(delegate),
+  DecoderStateMachine(ProtocolDecoder& protocol_decoder, MessageType messageType,
+                      Delegate& delegate)
+      : protocol_decoder_(protocol_decoder), messageType_(messageType), delegate_(delegate),
         state_(ProtocolState::OnDecodeStreamData) {}
   ~DecoderStateMachine() {
     ENVOY_LOG(trace, "********** DecoderStateMachine destructed ***********");
   }
 
+  /**
+   * Prepare the state machine for the next message. The state machine is owned by the decoder and
+   * reused for all the messages, so decoding doesn't allocate any framing state.
+   */
+  void reset() {
+    state_ = ProtocolState::OnDecodeStreamData;
+    protocol_decoder_started_ = false;
+    head_streamable_ = true;
+    remaining_body_length_ = 0;
+  }
+
+  /**
+   * Requests longer than the threshold are handed to the delegate as soon as their head has been
+   * decoded, and their bodies are passed to Delegate::onMessageBody as they arrive.
+   * @param threshold the length of the request above which its body is streamed, 0 to disable it
+   */
+  void setBodyStreamingThreshold(uint64_t threshold) { body_streaming_threshold_ = threshold; }
+
+  /**
+   * Messages whose length, as told by ProtocolDecoder::frameLength, exceeds the limit are reported
+   * as invalid as soon as their fixed header has arrived.
+   * @param max_length the maximum length of a message, 0 if it's unlimited
+   */
+  void setMaxMessageLength(uint64_t max_length) { max_message_length_ = max_length; }
+
+  /**
+   * @return the reason of the last error found by the state machine itself rather than the
+   *         message decoder, empty if there is none.
+   */
+  const std::string& errorDetail() const { return error_detail_; }
+
   /**
    * Consumes as much data from the configured Buffer as possible and executes the decoding state
    * machine. Returns ProtocolState::WaitForData if more data is required to complete processing of
@@ -86,7 +133,9 @@ public:
    * Once the Done state is reached, further invocations of run return immediately with Done.
    *
    * @param buffer a buffer containing the remaining data to be processed
-   * @return ProtocolState returns with ProtocolState::WaitForData or ProtocolState::Done
+   * @return ProtocolState returns with ProtocolState::WaitForData, ProtocolState::OnStreamBody if
+   * the body of a streamed request is not complete, ProtocolState::Done, or
+   * ProtocolState::Error if the message decoder reports that the data is invalid
    * @throw Envoy Exception if thrown by the underlying Protocol
    */
   ProtocolState run(Buffer::Instance& buffer);
@@ -98,19 +147,29 @@ public:
 
 private:
   ProtocolState onDecodeStream(Buffer::Instance& buffer);
+  ProtocolState onDecodeHead(Buffer::Instance& buffer, uint64_t frame_length);
+  ProtocolState onStreamBody(Buffer::Instance& buffer);
 
-  Codec& codec_;
+  ProtocolDecoder& protocol_decoder_;
   MessageType messageType_;
   Delegate& delegate_;
   ProtocolState state_;
+  // whether the message decoder has consumed a part of the current message
+  bool protocol_decoder_started_{false};
+  // false once the current message is known not to be streamable, so its head isn't peeked again
+  // when the rest of it arrives
+  bool head_streamable_{true};
+  uint64_t body_streaming_threshold_{0};
+  uint64_t max_message_length_{0};
+  std::string error_detail_;
+  // the length of the body of the streamed request which hasn't been received yet
+  uint64_t remaining_body_length_{0};
 };
 
-using DecoderStateMachinePtr = std::unique_ptr<DecoderStateMachine>;
-
 class DecoderBase : public DecoderStateMachine::Delegate,
                     public Logger::Loggable<Logger::Id::filter> {
 public:
-  DecoderBase(Codec& codec, MessageType messageType);
+  DecoderBase(ProtocolDecoder& protocol_decoder, MessageType messageType);
   ~DecoderBase() override;
 
   /**
@@ -118,9 +177,30 @@ public:
    *
    * @param data a Buffer containing protocol data
    * @param buffer_underflow bool set to true if more data is required to continue decoding
-   * @throw EnvoyException on protocol errors
+   * @return false on protocol errors reported by the message decoder, errorDetail() tells why
+   * @throw EnvoyException on protocol errors thrown by the message decoder
    */
-  void onData(Buffer::Instance& data, bool& buffer_underflow);
+  bool onData(Buffer::Instance& data, bool& buffer_underflow);
+
+  /**
+   * @return the reason of the last protocol error returned by onData
+   */
+  std::string errorDetail() const {
+    return state_machine_.errorDetail().empty() ? protocol_decoder_.errorDetail()
+                                                : state_machine_.errorDetail();
+  }
+
+  /**
+   * @see DecoderStateMachine::setBodyStreamingThreshold
+   */
+  void setBodyStreamingThreshold(uint64_t threshold) {
+    state_machine_.setBodyStreamingThreshold(threshold);
+  }
+
+  /**
+   * @see DecoderStateMachine::setMaxMessageLength
+   */
+  void setMaxMessageLength(uint64_t max_length) { state_machine_.setMaxMessageLength(max_length); }
 
   // It is assumed that all of the protocol parsing are stateless,
   // if there is a state of the need to provide the reset interface call here.
@@ -130,9 +210,9 @@ protected:
   void start();
   void complete();
 
-  Codec& codec_;
+  ProtocolDecoder& protocol_decoder_;
   ActiveStreamPtr stream_;
-  DecoderStateMachinePtr state_machine_;
+  DecoderStateMachine state_machine_;
   MessageType messageType_;
   bool decode_started_{false};
 };
@@ -142,8 +222,8 @@ protected:
  */
 template <typename T> class Decoder : public DecoderBase {
 public:
-  Decoder(Codec& codec, T& callbacks, MessageType messageType)
-      : DecoderBase(codec, messageType), callbacks_(callbacks) {}
+  Decoder(ProtocolDecoder& protocol_decoder, T& callbacks, MessageType messageType)
+      : DecoderBase(protocol_decoder, messageType), callbacks_(callbacks) {}
 
   ActiveStream* newStream(MetadataSharedPtr metadata, MutationSharedPtr mutation) override {
     ASSERT(!stream_);
@@ -153,14 +233,18 @@ public:
 
   bool onHeartbeat(MetadataSharedPtr metadata) override { return callbacks_.onHeartbeat(metadata); }
 
+  void onMessageBody(Buffer::Instance& data, bool end_of_message) override {
+    callbacks_.onMessageBody(data, end_of_message);
+  }
+
 private:
   T& callbacks_;
 };
 
 class RequestDecoder : public Decoder<RequestDecoderCallbacks> {
 public:
-  RequestDecoder(Codec& codec, RequestDecoderCallbacks& callbacks)
-      : Decoder(codec, callbacks, MessageType::Request) {}
+  RequestDecoder(ProtocolDecoder& protocol_decoder, RequestDecoderCallbacks& callbacks)
+      : Decoder(protocol_decoder, callbacks, MessageType::Request) {}
   ~RequestDecoder() { ENVOY_LOG(trace, "********** RequestDecoder destructed ***********"); };
 };
 
@@ -168,8 +252,8 @@ using RequestDecoderPtr = std::unique_ptr<RequestDecoder>;
 
 class ResponseDecoder : public Decoder<ResponseDecoderCallbacks> {
 public:
-  ResponseDecoder(Codec& codec, ResponseDecoderCallbacks& callbacks)
-      : Decoder(codec, callbacks, MessageType::Response) {}
+  ResponseDecoder(ProtocolDecoder& protocol_decoder, ResponseDecoderCallbacks& callbacks)
+      : Decoder(protocol_decoder, callbacks, MessageType::Response) {}
   ~ResponseDecoder() { ENVOY_LOG(trace, "********** ResponseDecoder destructed ***********"); };
 };
 
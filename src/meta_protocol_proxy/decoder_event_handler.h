@@ -65,6 +65,12 @@ public:
    * @return FilterStatus to indicate if filter chain iteration should continue
    */
   virtual void onMessageDecoded(MetadataSharedPtr metadata, MutationSharedPtr mutation) PURE;
+
+  /**
+   * Indicates that the metadata passed to the following onMessageDecoded only holds the head of
+   * the message, the body is passed to DecoderCallbacksBase::onMessageBody as it arrives.
+   */
+  virtual void onMessageBodyStreaming() {}
 };
 
 using MessageDecoderSharedPtr = std::shared_ptr<MessageDecoder>;
@@ -83,6 +89,13 @@ public:
    * @return whether to continue waiting for response
    */
   virtual bool onHeartbeat(MetadataSharedPtr) PURE;
+
+  /**
+   * Called with a part of the body of a message whose head has been decoded alone.
+   * @param data the part of the body, it must be drained
+   * @param end_of_message whether it's the last part of the body
+   */
+  virtual void onMessageBody(Buffer::Instance& data, bool) { data.drain(data.length()); }
 };
 
 class RequestDecoderCallbacks : public DecoderCallbacksBase {};
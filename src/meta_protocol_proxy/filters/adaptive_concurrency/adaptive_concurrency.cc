@@ -0,0 +1,166 @@
+#include "src/meta_protocol_proxy/filters/adaptive_concurrency/adaptive_concurrency.h"
+
+#include <algorithm>
+
+#include "source/common/protobuf/utility.h"
+#include "source/common/stats/utility.h"
+
+#include "src/meta_protocol_proxy/app_exception.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace AdaptiveConcurrency {
+
+namespace {
+
+ConcurrencyControllerConfig controllerConfig(const AdaptiveConcurrencyConfig& cfg) {
+  ConcurrencyControllerConfig config;
+  config.sample_interval_ =
+      std::chrono::milliseconds(PROTOBUF_GET_MS_OR_DEFAULT(cfg, sample_interval, 100));
+  config.min_samples_ = PROTOBUF_GET_WRAPPED_OR_DEFAULT(cfg, min_samples, 10);
+  config.sample_aggregate_percentile_ =
+      PROTOBUF_PERCENT_TO_DOUBLE_OR_DEFAULT(cfg, sample_aggregate_percentile, 50) / 100;
+  config.min_rtt_window_ =
+      std::chrono::milliseconds(PROTOBUF_GET_MS_OR_DEFAULT(cfg, min_rtt_window, 60000));
+  config.latency_buffer_ = PROTOBUF_PERCENT_TO_DOUBLE_OR_DEFAULT(cfg, latency_buffer, 25) / 100;
+  config.initial_concurrency_limit_ =
+      PROTOBUF_GET_WRAPPED_OR_DEFAULT(cfg, initial_concurrency_limit, 100);
+  config.min_concurrency_limit_ = PROTOBUF_GET_WRAPPED_OR_DEFAULT(cfg, min_concurrency_limit, 3);
+  config.max_concurrency_limit_ =
+      PROTOBUF_GET_WRAPPED_OR_DEFAULT(cfg, max_concurrency_limit, 1000);
+
+  if (config.min_concurrency_limit_ > config.max_concurrency_limit_) {
+    throw EnvoyException(
+        "adaptive concurrency min_concurrency_limit must be <= max_concurrency_limit");
+  }
+  config.initial_concurrency_limit_ =
+      std::clamp(config.initial_concurrency_limit_, config.min_concurrency_limit_,
+                 config.max_concurrency_limit_);
+  return config;
+}
+
+} // namespace
+
+FilterConfig::FilterConfig(const AdaptiveConcurrencyConfig& cfg, Stats::Scope& scope,
+                           Event::Dispatcher& dispatcher, ThreadLocal::SlotAllocator& tls)
+    : stats_(AdaptiveConcurrencyStats::generateStats(cfg.stat_prefix(), scope)), scope_(scope),
+      pool_(scope.symbolTable()),
+      stat_prefix_(pool_.add(AdaptiveConcurrencyStats::statPrefix(cfg.stat_prefix()))),
+      concurrency_limit_(pool_.add("concurrency_limit")),
+      min_rtt_msecs_(pool_.add("min_rtt_msecs")), limit_key_(cfg.limit_key()),
+      controller_config_(controllerConfig(cfg)), time_source_(dispatcher.timeSource()),
+      sample_timer_(dispatcher.createTimer([this] { onSampleTimer(); })),
+      tls_(tls.allocateSlot()) {
+  tls_->set([](Event::Dispatcher&) -> ThreadLocal::ThreadLocalObjectSharedPtr {
+    return std::make_shared<ThreadLocalControllers>();
+  });
+  sample_timer_->enableTimer(controller_config_.sample_interval_);
+}
+
+FilterConfig::~FilterConfig() { sample_timer_->disableTimer(); }
+
+ConcurrencyController& FilterConfig::controller(const std::string& key) {
+  auto& cache = tls_->getTyped<ThreadLocalControllers>();
+  auto it = cache.controllers_.find(key);
+  if (it != cache.controllers_.end()) {
+    return *it->second;
+  }
+
+  ConcurrencyController& controller = createController(key);
+  cache.controllers_.emplace(key, &controller);
+  return controller;
+}
+
+ConcurrencyController& FilterConfig::createController(const std::string& key) {
+  absl::MutexLock lock(&mutex_);
+  auto& controller = controllers_[key];
+  if (controller == nullptr) {
+    // The key is added as a dynamic name, which doesn't take the symbol table lock.
+    const Stats::DynamicName dynamic_key(key);
+    controller = std::make_unique<ConcurrencyController>(
+        controller_config_,
+        Stats::Utility::gaugeFromElements(scope_, {stat_prefix_, dynamic_key, concurrency_limit_},
+                                          Stats::Gauge::ImportMode::NeverImport),
+        Stats::Utility::gaugeFromElements(scope_, {stat_prefix_, dynamic_key, min_rtt_msecs_},
+                                          Stats::Gauge::ImportMode::NeverImport));
+  }
+  return *controller;
+}
+
+void FilterConfig::onSampleTimer() {
+  const auto now = time_source_.monotonicTime();
+  {
+    absl::ReaderMutexLock lock(&mutex_);
+    for (auto& [key, controller] : controllers_) {
+      controller->updateConcurrencyLimit(now);
+    }
+  }
+  sample_timer_->enableTimer(controller_config_.sample_interval_);
+}
+
+void AdaptiveConcurrency::onDestroy() { cleanup(); }
+
+void AdaptiveConcurrency::setDecoderFilterCallbacks(DecoderFilterCallbacks& callbacks) {
+  callbacks_ = &callbacks;
+}
+
+FilterStatus AdaptiveConcurrency::onMessageDecoded(MetadataSharedPtr metadata, MutationSharedPtr) {
+  auto route = callbacks_->route();
+  // Leave the requests without a route to the router, which sends the local reply.
+  if (!route || !route->routeEntry()) {
+    return FilterStatus::ContinueIteration;
+  }
+
+  const auto* route_entry = route->routeEntry();
+  ConcurrencyController& controller =
+      filter_config_->controller(filter_config_->limitKey() == AdaptiveConcurrencyConfig::ROUTE
+                                     ? route_entry->routeName()
+                                     : route_entry->clusterName());
+  if (!controller.tryAcquire()) {
+    ENVOY_STREAM_LOG(debug, "meta protocol adaptive concurrency: request '{}' blocked, limit {}",
+                     *callbacks_, metadata->getRequestId(), controller.concurrencyLimit());
+    filter_config_->stats().rq_blocked_.inc();
+    callbacks_->sendLocalReply(
+        AppException(Error{
+            ErrorType::OverLimit,
+            fmt::format("meta protocol adaptive concurrency: request '{}' exceeds the concurrency "
+                        "limit",
+                        metadata->getRequestId())}),
+        false);
+    return FilterStatus::AbortIteration;
+  }
+
+  controller_ = &controller;
+  filter_config_->stats().ok_.inc();
+  return FilterStatus::ContinueIteration;
+}
+
+void AdaptiveConcurrency::setEncoderFilterCallbacks(EncoderFilterCallbacks& callbacks) {
+  encoder_callbacks_ = &callbacks;
+}
+
+FilterStatus AdaptiveConcurrency::onMessageEncoded(MetadataSharedPtr, MutationSharedPtr) {
+  return FilterStatus::ContinueIteration;
+}
+
+void AdaptiveConcurrency::cleanup() {
+  if (controller_ != nullptr) {
+    // The latency is sampled when the request is destroyed rather than when its response is
+    // encoded, because the responses of multiplexed requests skip the encoder filters. The request
+    // is marked as completed when its response has been received, on both paths.
+    const auto latency = callbacks_->streamInfo().requestComplete();
+    if (latency.has_value()) {
+      controller_->recordLatency(latency.value());
+    }
+    controller_->release();
+    controller_ = nullptr;
+  }
+}
+
+} // namespace AdaptiveConcurrency
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
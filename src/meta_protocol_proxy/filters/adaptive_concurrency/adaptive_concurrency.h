@@ -0,0 +1,104 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "envoy/event/dispatcher.h"
+#include "envoy/event/timer.h"
+#include "envoy/stats/scope.h"
+#include "envoy/thread_local/thread_local.h"
+
+#include "source/common/common/logger.h"
+#include "source/common/stats/symbol_table.h"
+
+#include "api/meta_protocol_proxy/filters/adaptive_concurrency/v1alpha/adaptive_concurrency.pb.h"
+
+#include "src/meta_protocol_proxy/filters/filter.h"
+#include "src/meta_protocol_proxy/filters/adaptive_concurrency/concurrency_controller.h"
+#include "src/meta_protocol_proxy/filters/adaptive_concurrency/stats.h"
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace AdaptiveConcurrency {
+
+using AdaptiveConcurrencyConfig =
+    aeraki::meta_protocol_proxy::filters::adaptive_concurrency::v1alpha::AdaptiveConcurrency;
+
+/**
+ * FilterConfig owns the concurrency controllers, which are shared by all the worker threads. The
+ * controllers are created on the first request to a cluster or route, and their limits are
+ * recalculated by a timer on the main thread. Every worker keeps the controllers it has already
+ * looked up, so the shared map and its lock are only used once per worker and key.
+ */
+class FilterConfig {
+public:
+  FilterConfig(const AdaptiveConcurrencyConfig& cfg, Stats::Scope& scope,
+               Event::Dispatcher& dispatcher, ThreadLocal::SlotAllocator& tls);
+  ~FilterConfig();
+
+  AdaptiveConcurrencyStats& stats() { return stats_; }
+  AdaptiveConcurrencyConfig::LimitKey limitKey() const { return limit_key_; }
+  ConcurrencyController& controller(const std::string& key);
+
+private:
+  struct ThreadLocalControllers : public ThreadLocal::ThreadLocalObject {
+    absl::flat_hash_map<std::string, ConcurrencyController*> controllers_;
+  };
+
+  ConcurrencyController& createController(const std::string& key);
+  void onSampleTimer();
+
+  AdaptiveConcurrencyStats stats_;
+  Stats::Scope& scope_;
+  // holds the constant parts of the gauge names, it's only written in the constructor
+  Stats::StatNamePool pool_;
+  const Stats::StatName stat_prefix_;
+  const Stats::StatName concurrency_limit_;
+  const Stats::StatName min_rtt_msecs_;
+  const AdaptiveConcurrencyConfig::LimitKey limit_key_;
+  const ConcurrencyControllerConfig controller_config_;
+  TimeSource& time_source_;
+  const Event::TimerPtr sample_timer_;
+  ThreadLocal::SlotPtr tls_;
+
+  absl::Mutex mutex_;
+  absl::flat_hash_map<std::string, ConcurrencyControllerPtr> controllers_ ABSL_GUARDED_BY(mutex_);
+};
+
+class AdaptiveConcurrency : public CodecFilter, Logger::Loggable<Logger::Id::filter> {
+public:
+  AdaptiveConcurrency(std::shared_ptr<FilterConfig> filter_config)
+      : filter_config_(filter_config){};
+  ~AdaptiveConcurrency() override = default;
+
+  void onDestroy() override;
+
+  // DecoderFilter
+  void setDecoderFilterCallbacks(DecoderFilterCallbacks& callbacks) override;
+  FilterStatus onMessageDecoded(MetadataSharedPtr metadata, MutationSharedPtr mutation) override;
+
+  // EncoderFilter
+  void setEncoderFilterCallbacks(EncoderFilterCallbacks& callbacks) override;
+  FilterStatus onMessageEncoded(MetadataSharedPtr metadata, MutationSharedPtr mutation) override;
+
+private:
+  void cleanup();
+
+  DecoderFilterCallbacks* callbacks_{};
+  EncoderFilterCallbacks* encoder_callbacks_{};
+
+  std::shared_ptr<FilterConfig> filter_config_;
+  // The controller which admitted the current request, if any.
+  ConcurrencyController* controller_{};
+};
+
+} // namespace AdaptiveConcurrency
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
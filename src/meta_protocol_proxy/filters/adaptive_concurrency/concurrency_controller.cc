@@ -0,0 +1,126 @@
+#include "src/meta_protocol_proxy/filters/adaptive_concurrency/concurrency_controller.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace AdaptiveConcurrency {
+
+namespace {
+
+// The gradient is clamped to avoid overreacting to a single slow or fast interval.
+constexpr double MinGradient = 0.5;
+constexpr double MaxGradient = 2.0;
+
+} // namespace
+
+ConcurrencyController::ConcurrencyController(const ConcurrencyControllerConfig& config,
+                                             Stats::Gauge& concurrency_limit_gauge,
+                                             Stats::Gauge& min_rtt_gauge)
+    : config_(config), concurrency_limit_gauge_(concurrency_limit_gauge),
+      min_rtt_gauge_(min_rtt_gauge), concurrency_limit_(config.initial_concurrency_limit_) {
+  concurrency_limit_gauge_.set(config_.initial_concurrency_limit_);
+}
+
+bool ConcurrencyController::tryAcquire() {
+  // Relaxed consistency is used for all operations because we don't care about ordering, just the
+  // final atomic correctness.
+  uint32_t expected = in_flight_.load(std::memory_order_relaxed);
+  do {
+    if (expected >= concurrency_limit_.load(std::memory_order_relaxed)) {
+      return false;
+    }
+  } while (!in_flight_.compare_exchange_weak(expected, expected + 1, std::memory_order_relaxed));
+  return true;
+}
+
+void ConcurrencyController::release() {
+  ASSERT(in_flight_.load(std::memory_order_relaxed) > 0);
+  in_flight_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void ConcurrencyController::recordLatency(std::chrono::nanoseconds latency) {
+  absl::MutexLock lock(&sample_mutex_);
+  if (samples_.size() < MaxSamplesPerInterval) {
+    samples_.push_back(latency);
+  }
+}
+
+void ConcurrencyController::updateConcurrencyLimit(MonotonicTime now) {
+  if (min_rtt_.has_value() && !probing_min_rtt_ &&
+      now - min_rtt_window_start_ >= config_.min_rtt_window_) {
+    ENVOY_LOG(debug, "meta protocol adaptive concurrency: probing min rtt, concurrency limit {}",
+              concurrencyLimit());
+    probing_min_rtt_ = true;
+    probe_drained_ = false;
+    limit_before_probe_ = concurrencyLimit();
+    setConcurrencyLimit(config_.min_concurrency_limit_);
+  }
+
+  std::vector<std::chrono::nanoseconds> samples;
+  {
+    absl::MutexLock lock(&sample_mutex_);
+    if (probing_min_rtt_ && !probe_drained_) {
+      // Drop the samples of the requests which were admitted under the previous limit.
+      samples_.clear();
+      probe_drained_ = inFlightRequests() <= config_.min_concurrency_limit_;
+      return;
+    }
+    if (samples_.size() < config_.min_samples_) {
+      return;
+    }
+    samples.swap(samples_);
+  }
+
+  auto nth = samples.begin() + static_cast<size_t>(config_.sample_aggregate_percentile_ *
+                                                   (samples.size() - 1));
+  std::nth_element(samples.begin(), nth, samples.end());
+  const std::chrono::nanoseconds sample_rtt = std::max(*nth, std::chrono::nanoseconds(1));
+
+  if (!min_rtt_.has_value() || probing_min_rtt_) {
+    min_rtt_ = sample_rtt;
+    min_rtt_window_start_ = now;
+  } else {
+    min_rtt_ = std::min(min_rtt_.value(), sample_rtt);
+  }
+  min_rtt_gauge_.set(
+      std::chrono::duration_cast<std::chrono::milliseconds>(min_rtt_.value()).count());
+
+  if (probing_min_rtt_) {
+    // Resume from the limit used before the probe rather than growing from min_concurrency_limit.
+    ENVOY_LOG(debug, "meta protocol adaptive concurrency: min rtt {}ns, concurrency limit {}",
+              min_rtt_.value().count(), limit_before_probe_);
+    probing_min_rtt_ = false;
+    setConcurrencyLimit(limit_before_probe_);
+    return;
+  }
+
+  const double gradient = std::clamp(static_cast<double>(min_rtt_.value().count()) *
+                                         (1 + config_.latency_buffer_) / sample_rtt.count(),
+                                     MinGradient, MaxGradient);
+  const double limit = concurrencyLimit() * gradient;
+  // The headroom lets the limit grow again once the latency is back to normal.
+  const uint32_t new_limit = std::clamp(static_cast<uint32_t>(limit + std::sqrt(limit)),
+                                        config_.min_concurrency_limit_,
+                                        config_.max_concurrency_limit_);
+
+  ENVOY_LOG(trace,
+            "meta protocol adaptive concurrency: sample rtt {}ns, min rtt {}ns, gradient {}, "
+            "concurrency limit {} -> {}",
+            sample_rtt.count(), min_rtt_.value().count(), gradient, concurrencyLimit(), new_limit);
+  setConcurrencyLimit(new_limit);
+}
+
+void ConcurrencyController::setConcurrencyLimit(uint32_t limit) {
+  concurrency_limit_.store(limit, std::memory_order_relaxed);
+  concurrency_limit_gauge_.set(limit);
+}
+
+} // namespace AdaptiveConcurrency
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+#include "envoy/common/time.h"
+#include "envoy/stats/stats.h"
+
+#include "source/common/common/logger.h"
+
+#include "absl/synchronization/mutex.h"
+#include "absl/types/optional.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace AdaptiveConcurrency {
+
+struct ConcurrencyControllerConfig {
+  std::chrono::milliseconds sample_interval_;
+  uint32_t min_samples_;
+  // In the range of [0, 1].
+  double sample_aggregate_percentile_;
+  std::chrono::milliseconds min_rtt_window_;
+  double latency_buffer_;
+  uint32_t initial_concurrency_limit_;
+  uint32_t min_concurrency_limit_;
+  uint32_t max_concurrency_limit_;
+};
+
+/**
+ * ConcurrencyController tracks the in-flight requests and the concurrency limit of a single
+ * cluster or route. tryAcquire, release and recordLatency can be called from any worker thread,
+ * updateConcurrencyLimit is only called from the main thread.
+ */
+class ConcurrencyController : Logger::Loggable<Logger::Id::filter> {
+public:
+  ConcurrencyController(const ConcurrencyControllerConfig& config,
+                        Stats::Gauge& concurrency_limit_gauge, Stats::Gauge& min_rtt_gauge);
+
+  /**
+   * Reserve a slot for a new request.
+   * @return false if the concurrency limit has been reached and the request should be rejected.
+   */
+  bool tryAcquire();
+
+  /**
+   * Free the slot reserved by a successful tryAcquire.
+   */
+  void release();
+
+  /**
+   * Record the latency of a completed request.
+   */
+  void recordLatency(std::chrono::nanoseconds latency);
+
+  /**
+   * Recalculate the concurrency limit from the latencies recorded since the last update. At the end
+   * of every min_rtt window, the limit is dropped to min_concurrency_limit until min_rtt has been
+   * measured again, so that min_rtt doesn't include the queueing caused by the current limit.
+   */
+  void updateConcurrencyLimit(MonotonicTime now);
+
+  uint32_t concurrencyLimit() const { return concurrency_limit_.load(std::memory_order_relaxed); }
+  uint32_t inFlightRequests() const { return in_flight_.load(std::memory_order_relaxed); }
+
+private:
+  // Bounds the memory used by the samples of a single interval.
+  static constexpr size_t MaxSamplesPerInterval = 4096;
+
+  const ConcurrencyControllerConfig& config_;
+  Stats::Gauge& concurrency_limit_gauge_;
+  Stats::Gauge& min_rtt_gauge_;
+
+  std::atomic<uint32_t> in_flight_{0};
+  std::atomic<uint32_t> concurrency_limit_;
+
+  absl::Mutex sample_mutex_;
+  std::vector<std::chrono::nanoseconds> samples_ ABSL_GUARDED_BY(sample_mutex_);
+
+  void setConcurrencyLimit(uint32_t limit);
+
+  // Only accessed by the main thread.
+  absl::optional<std::chrono::nanoseconds> min_rtt_;
+  MonotonicTime min_rtt_window_start_;
+  // Whether min_rtt is being measured again at min_concurrency_limit.
+  bool probing_min_rtt_{false};
+  // Whether the requests admitted before the probe have completed.
+  bool probe_drained_{false};
+  uint32_t limit_before_probe_{0};
+};
+
+using ConcurrencyControllerPtr = std::unique_ptr<ConcurrencyController>;
+
+} // namespace AdaptiveConcurrency
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
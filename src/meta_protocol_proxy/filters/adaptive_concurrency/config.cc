@@ -0,0 +1,36 @@
+#include "src/meta_protocol_proxy/filters/adaptive_concurrency/config.h"
+
+#include "envoy/registry/registry.h"
+#include "src/meta_protocol_proxy/filters/adaptive_concurrency/adaptive_concurrency.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace AdaptiveConcurrency {
+
+FilterFactoryCb AdaptiveConcurrencyFilterConfig::createFilterFactoryFromProtoTyped(
+    const aeraki::meta_protocol_proxy::filters::adaptive_concurrency::v1alpha::AdaptiveConcurrency&
+        cfg,
+    const std::string&, Server::Configuration::FactoryContext& context) {
+
+  // The filter config is shared by all the workers, so the concurrency limits are process-wide.
+  auto filter_config = std::make_shared<FilterConfig>(
+      cfg, context.scope(), context.serverFactoryContext().mainThreadDispatcher(),
+      context.serverFactoryContext().threadLocal());
+
+  return [filter_config](FilterChainFactoryCallbacks& callbacks) -> void {
+    callbacks.addFilter(std::make_shared<AdaptiveConcurrency>(filter_config));
+  };
+}
+
+/**
+ * Static registration for the adaptive concurrency filter. @see RegisterFactory.
+ */
+REGISTER_FACTORY(AdaptiveConcurrencyFilterConfig, NamedMetaProtocolFilterConfigFactory);
+
+} // namespace AdaptiveConcurrency
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
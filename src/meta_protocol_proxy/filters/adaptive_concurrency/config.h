@@ -0,0 +1,31 @@
+#pragma once
+
+#include "api/meta_protocol_proxy/filters/adaptive_concurrency/v1alpha/adaptive_concurrency.pb.h"
+#include "api/meta_protocol_proxy/filters/adaptive_concurrency/v1alpha/adaptive_concurrency.pb.validate.h"
+#include "src/meta_protocol_proxy/filters/factory_base.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace AdaptiveConcurrency {
+
+class AdaptiveConcurrencyFilterConfig
+    : public FactoryBase<
+          aeraki::meta_protocol_proxy::filters::adaptive_concurrency::v1alpha::AdaptiveConcurrency> {
+public:
+  AdaptiveConcurrencyFilterConfig()
+      : FactoryBase("aeraki.meta_protocol.filters.adaptive_concurrency") {}
+
+private:
+  FilterFactoryCb createFilterFactoryFromProtoTyped(
+      const aeraki::meta_protocol_proxy::filters::adaptive_concurrency::v1alpha::AdaptiveConcurrency&
+          proto_config,
+      const std::string&, Server::Configuration::FactoryContext& context) override;
+};
+
+} // namespace AdaptiveConcurrency
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+
+#include "envoy/stats/scope.h"
+#include "envoy/stats/stats_macros.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace AdaptiveConcurrency {
+
+/**
+ * All adaptive concurrency stats. @see stats_macros.h
+ */
+#define ALL_ADAPTIVE_CONCURRENCY_STATS(COUNTER)                                                    \
+  COUNTER(rq_blocked)                                                                              \
+  COUNTER(ok)
+
+/**
+ * Struct definition for all adaptive concurrency stats. @see stats_macros.h
+ */
+struct AdaptiveConcurrencyStats {
+  ALL_ADAPTIVE_CONCURRENCY_STATS(GENERATE_COUNTER_STRUCT)
+
+  static std::string statPrefix(const std::string& prefix) {
+    return "meta_protocol." + prefix + ".adaptive_concurrency";
+  }
+
+  static AdaptiveConcurrencyStats generateStats(const std::string& prefix, Stats::Scope& scope) {
+    const std::string final_prefix = statPrefix(prefix);
+    return {ALL_ADAPTIVE_CONCURRENCY_STATS(POOL_COUNTER_PREFIX(scope, final_prefix))};
+  }
+};
+
+} // namespace AdaptiveConcurrency
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -21,6 +21,8 @@ namespace Extensions {
 namespace NetworkFilters {
 namespace MetaProtocolProxy {
 
+class BinaryAccessLog;
+
 struct GetUpstreamHandlerResult {
   absl::optional<Error> error;
   UpstreamHandlerSharedPtr upstream_handler;
@@ -43,31 +45,53 @@ public:
   };
 
   /**
-   * Encodes the response via the given codec.
+   * Encodes the response via the given encoder.
    * @param metadata the MessageMetadata for the request that generated this response
-   * @param codec the codec to be used for message encoding
+   * @param encoder the encoder to be used for message encoding
    * @param buffer the Buffer into which the message should be encoded
    * @return ResponseType indicating whether the message is a successful or error reply or an
    *         exception
    */
-  virtual ResponseType encode(Metadata& metadata, Codec& codec,
+  virtual ResponseType encode(Metadata& metadata, Encoder& encoder,
                               Buffer::Instance& buffer) const PURE;
 };
 
 using DirectResponsePtr = std::unique_ptr<DirectResponse>;
 
 /**
- * CodecFactory creates codec.
+ * CodecFactory creates decoders and provides the encoder of the current worker.
  */
 class CodecFactory {
 public:
   virtual ~CodecFactory() = default;
 
   /**
-   * Create a codec, which will be used by the router to encode request and response
-   * @return CodecPtr
+   * Create a decoder, which will be used by the router to decode the upstream response
+   * @return ProtocolDecoderPtr
+   */
+  virtual ProtocolDecoderPtr createDecoder() PURE;
+
+  /**
+   * @return const EncoderSharedPtr& the encoder used by the router to encode request and response.
+   *         It's shared by the worker, so the router doesn't need to create one for each message.
    */
-  virtual CodecPtr createCodec() PURE;
+  virtual const EncoderSharedPtr& encoder() PURE;
+};
+
+/**
+ * MessageBodyCallbacks receives the body of a request which is forwarded while it's still being
+ * received.
+ */
+class MessageBodyCallbacks {
+public:
+  virtual ~MessageBodyCallbacks() = default;
+
+  /**
+   * Called with a part of the body of the request.
+   * @param data the part of the body, it must be drained
+   * @param end_of_message whether it's the last part of the body
+   */
+  virtual void onMessageBody(Buffer::Instance& data, bool end_of_message) PURE;
 };
 
 /**
@@ -161,6 +185,13 @@ public:
    */
   virtual void setUpstreamConnection(Tcp::ConnectionPool::ConnectionDataPtr conn) PURE;
 
+  /**
+   * Set the upstream handler on which a streaming RPC is multiplexed, used by router instead of
+   * setUpstreamConnection when multiplexing is enabled.
+   * @param upstream_handler supplies the upstream handler of the selected host
+   */
+  virtual void setUpstreamHandler(UpstreamHandlerSharedPtr upstream_handler) PURE;
+
   /**
    * Get the tracer, used by router to create tracing spans
    * @return
@@ -185,6 +216,12 @@ public:
    */
   virtual const std::vector<AccessLog::InstanceSharedPtr>& accessLogs() PURE;
 
+  /**
+   * @return BinaryAccessLog* the binary access log of this MetaProtocol Proxy, nullptr if it's not
+   * enabled.
+   */
+  virtual BinaryAccessLog* binaryAccessLog() PURE;
+
   /**
    * @brief get upstream handler
    *
@@ -203,10 +240,36 @@ public:
    */
   virtual bool multiplexing() PURE;
 
+  /**
+   * @return CodecFactory& the codec factory of the proxy config. Unlike the callbacks, it outlives
+   * the message, so it can be kept by the requests which outlive it, e.g. the mirrored requests.
+   */
+  virtual CodecFactory& configCodecFactory() PURE;
+
   /**
    * on upstream response
    */
   virtual void onUpstreamResponse() PURE;
+
+  /**
+   * @return true if the metadata of the current request only holds its head, the body is still
+   * being received and is delivered to the callbacks set by setMessageBodyCallbacks.
+   */
+  virtual bool bodyStreaming() PURE;
+
+  /**
+   * Set the receiver of the body of a streamed request, the body which has been received before is
+   * delivered at once.
+   * @param callbacks supplies the callbacks, it must stay valid until the filter is destroyed
+   */
+  virtual void setMessageBodyCallbacks(MessageBodyCallbacks& callbacks) PURE;
+
+  /**
+   * Stop or resume reading from the downstream connection, used for flow control when the body of
+   * a request is forwarded while it's still being received. The calls must be balanced.
+   * @param disable whether to stop reading
+   */
+  virtual void readDisableDownstream(bool disable) PURE;
 };
 
 /**
@@ -2,8 +2,11 @@
 
 #include "envoy/registry/registry.h"
 
+#include "source/common/protobuf/utility.h"
+
 #include "src/meta_protocol_proxy/filters/istio_stats/stats_filter.h"
 #include "src/meta_protocol_proxy/filters/istio_stats/istio_stats.h"
+#include "src/meta_protocol_proxy/filters/istio_stats/peer_node_cache.h"
 
 namespace Envoy {
 namespace Extensions {
@@ -15,9 +18,12 @@ FilterFactoryCb StatsFilterConfig::createFilterFactoryFromProtoTyped(
     const aeraki::meta_protocol_proxy::filters::istio_stats::v1alpha::IstioStats& cfg, const std::string&,
     Server::Configuration::FactoryContext& context) {
   auto stats = std::make_shared<IstioStats>(context, context.listenerInfo().direction());
+  auto peer_node_cache = std::make_shared<PeerNodeCache>(
+      context.serverFactoryContext().threadLocal(),
+      PROTOBUF_GET_WRAPPED_OR_DEFAULT(cfg, peer_metadata_cache_size, 1024));
   // cfg is changed
-  return [cfg, &context, stats](FilterChainFactoryCallbacks& callbacks) -> void {
-    callbacks.addFilter(std::make_shared<StatsFilter>(cfg, context, *stats));
+  return [cfg, &context, stats, peer_node_cache](FilterChainFactoryCallbacks& callbacks) -> void {
+    callbacks.addFilter(std::make_shared<StatsFilter>(cfg, context, *stats, *peer_node_cache));
   };
 }
 
@@ -54,6 +54,10 @@ IstioStats::IstioStats(Server::Configuration::FactoryContext& context,
     local_node_info_ =
         Wasm::Common::extractNodeFlatBufferFromStruct(context.serverFactoryContext().localInfo().node().metadata());
   }
+  tls_ = context.serverFactoryContext().threadLocal().allocateSlot();
+  tls_->set([](Event::Dispatcher&) -> ThreadLocal::ThreadLocalObjectSharedPtr {
+    return std::make_shared<ThreadLocalCache>();
+  });
 }
 
 // Returns a string view stored in a flatbuffers string.
@@ -61,86 +65,164 @@ static inline absl::string_view GetFromFbStringView(const flatbuffers::String* s
   return str ? absl::string_view(str->c_str(), str->size()) : absl::string_view();
 }
 
+namespace {
+
+// A worker thread caches the metrics of at most this many tag value combinations.
+constexpr size_t MaxCachedMetrics = 4096;
+
+void appendKey(std::string& key, absl::string_view value) {
+  absl::StrAppend(&key, value.size(), ":", value);
+}
+
+template <class Labels>
+void appendLabelKey(std::string& key, const Labels& labels, const char* name) {
+  auto iter = labels.LookupByKey(name);
+  if (iter) {
+    appendKey(key, GetFromFbStringView(iter->value()));
+  } else {
+    // distinguish a missing label from an empty one
+    key.push_back('-');
+  }
+}
+
+// Appends all the fields of the node which are used as tag values to the cache key.
+void appendNodeKey(std::string& key, const Wasm::Common::FlatNode& node) {
+  appendKey(key, GetFromFbStringView(node.workload_name()));
+  appendKey(key, GetFromFbStringView(node.namespace_()));
+  appendKey(key, GetFromFbStringView(node.cluster_id()));
+  auto labels = node.labels();
+  if (labels) {
+    appendLabelKey(key, *labels, "app");
+    appendLabelKey(key, *labels, "version");
+    appendLabelKey(key, *labels, ::Wasm::Common::kCanonicalServiceLabelName.data());
+    appendLabelKey(key, *labels, ::Wasm::Common::kCanonicalServiceRevisionLabelName.data());
+  } else {
+    key.push_back('-');
+  }
+}
+
+} // namespace
+
 void IstioStats::report(const Wasm::Common::FlatNode& peer_node, MetadataSharedPtr metadata,
                         const std::string& destination_service) {
+  absl::optional<absl::string_view> destination_service_name;
+  if (traffic_direction_ == envoy::config::core::v3::TrafficDirection::INBOUND) {
+    // use the destination_service in the stats config for inbound traffic
+    destination_service_name = destination_service;
+  } else if (metadata->streamInfo().upstreamClusterInfo().has_value() &&
+             metadata->streamInfo().upstreamClusterInfo().value()) {
+    // extract the destination_service from the cluster name for outbound traffic
+    absl::string_view cluster_name = metadata->streamInfo().upstreamClusterInfo().value()->name();
+    size_t pos = cluster_name.find_last_of("|");
+    if (pos != absl::string_view::npos) {
+      cluster_name = cluster_name.substr(pos + 1);
+    }
+    destination_service_name = cluster_name;
+  }
+  const int response_code = responseCode(metadata->getResponseStatus());
+
+  auto& cache = tls_->getTyped<ThreadLocalCache>();
+  std::string& key = cache.key_;
+  key.clear();
+  appendNodeKey(key, peer_node);
+  if (destination_service_name.has_value()) {
+    appendKey(key, destination_service_name.value());
+  } else {
+    key.push_back('-');
+  }
+  absl::StrAppend(&key, response_code);
+
+  auto it = cache.metrics_.find(key);
+  if (it == cache.metrics_.end()) {
+    if (cache.metrics_.size() >= MaxCachedMetrics) {
+      cache.metrics_.clear();
+    }
+    it = cache.metrics_
+             .emplace(key, resolveMetrics(peer_node, destination_service_name, response_code))
+             .first;
+  }
+  const CachedMetrics& metrics = it->second;
+
+  metrics.requests_total_.inc();
+  auto duration = metadata->streamInfo().requestComplete();
+  if (duration.has_value()) {
+    metrics.request_duration_milliseconds_.recordValue(absl::FromChrono(duration.value()) /
+                                                       absl::Milliseconds(1));
+  }
+  metrics.request_bytes_.recordValue(metadata->streamInfo().bytesSent());
+  metrics.response_bytes_.recordValue(metadata->streamInfo().bytesReceived());
+}
+
+IstioStats::CachedMetrics
+IstioStats::resolveMetrics(const Wasm::Common::FlatNode& peer_node,
+                           absl::optional<absl::string_view> destination_service_name,
+                           int response_code) {
+  // The metrics keep their own copies of the names, so the dynamic names are only needed until
+  // the metrics have been created.
+  Stats::StatNameDynamicPool pool(scope_.symbolTable());
   Stats::StatNameTagVector tags;
   tags.reserve(25);
   const auto& local_node = *flatbuffers::GetRoot<Wasm::Common::FlatNode>(local_node_info_.data());
 
   if (traffic_direction_ == envoy::config::core::v3::TrafficDirection::INBOUND) {
     tags.push_back({reporter_, destination_});
-    populateSourceNodeTags(peer_node, tags);
-    populateDestinationNodeTags(local_node, tags);
-    // use the destination_service in the stats config for inbound traffic
-    auto destination_service_name = pool_.add(destination_service);
-    tags.push_back({destination_service_, destination_service_name});
-    tags.push_back({destination_service_name_, destination_service_name});
+    populateSourceNodeTags(peer_node, pool, tags);
+    populateDestinationNodeTags(local_node, pool, tags);
   } else {
     tags.push_back({reporter_, source_});
-    populateSourceNodeTags(local_node, tags);
-    populateDestinationNodeTags(peer_node, tags);
-    // extract the destination_service from the cluster name for outbound traffic
-    if (metadata->streamInfo().upstreamClusterInfo().has_value() &&
-        metadata->streamInfo().upstreamClusterInfo().value()) {
-      std::string cluster_name = metadata->streamInfo().upstreamClusterInfo().value()->name();
-      size_t pos = cluster_name.find_last_of("|");
-      if (pos != std::string::npos) {
-        cluster_name = cluster_name.substr(pos + 1, cluster_name.length() - pos - 1);
-      }
-      auto destination_service_name = pool_.add(cluster_name);
-      tags.push_back({destination_service_, destination_service_name});
-      tags.push_back({destination_service_name_, destination_service_name});
-    }
+    populateSourceNodeTags(local_node, pool, tags);
+    populateDestinationNodeTags(peer_node, pool, tags);
   }
-  tags.push_back(
-      {response_code_, pool_.add(absl::StrCat(static_cast<int>(metadata->getResponseStatus())))});
-  Stats::Utility::counterFromStatNames(scope_, {stat_namespace_, requests_total_}, tags).inc();
-  auto duration = metadata->streamInfo().requestComplete();
-  if (duration.has_value()) {
-    Stats::Utility::histogramFromStatNames(scope_,
-                                           {stat_namespace_, request_duration_milliseconds_},
-                                           Stats::Histogram::Unit::Milliseconds, tags)
-        .recordValue(absl::FromChrono(duration.value()) / absl::Milliseconds(1));
+  if (destination_service_name.has_value()) {
+    auto destination_service = pool.add(destination_service_name.value());
+    tags.push_back({destination_service_, destination_service});
+    tags.push_back({destination_service_name_, destination_service});
   }
-  Stats::Utility::histogramFromStatNames(scope_, {stat_namespace_, request_bytes_},
-                                         Stats::Histogram::Unit::Bytes, tags)
-      .recordValue(metadata->streamInfo().bytesSent());
-  Stats::Utility::histogramFromStatNames(scope_, {stat_namespace_, response_bytes_},
-                                         Stats::Histogram::Unit::Bytes, tags)
-      .recordValue(metadata->streamInfo().bytesReceived());
+  tags.push_back({response_code_, pool.add(absl::StrCat(response_code))});
+
+  return CachedMetrics{
+      Stats::Utility::counterFromStatNames(scope_, {stat_namespace_, requests_total_}, tags),
+      Stats::Utility::histogramFromStatNames(scope_,
+                                             {stat_namespace_, request_duration_milliseconds_},
+                                             Stats::Histogram::Unit::Milliseconds, tags),
+      Stats::Utility::histogramFromStatNames(scope_, {stat_namespace_, request_bytes_},
+                                             Stats::Histogram::Unit::Bytes, tags),
+      Stats::Utility::histogramFromStatNames(scope_, {stat_namespace_, response_bytes_},
+                                             Stats::Histogram::Unit::Bytes, tags)};
 }
 
 void IstioStats::populateSourceNodeTags(const Wasm::Common::FlatNode& node,
+                                        Stats::StatNameDynamicPool& pool,
                                         Stats::StatNameTagVector& tags) {
   auto workload = GetFromFbStringView(node.workload_name());
-  tags.push_back({source_workload_, !workload.empty() ? pool_.add(workload) : unknown_});
+  tags.push_back({source_workload_, !workload.empty() ? pool.add(workload) : unknown_});
   auto ns = GetFromFbStringView(node.namespace_());
-  tags.push_back({source_workload_namespace_, !ns.empty() ? pool_.add(ns) : unknown_});
+  tags.push_back({source_workload_namespace_, !ns.empty() ? pool.add(ns) : unknown_});
   auto cluster = GetFromFbStringView(node.cluster_id());
-  tags.push_back({source_cluster_, !cluster.empty() ? pool_.add(cluster) : unknown_});
+  tags.push_back({source_cluster_, !cluster.empty() ? pool.add(cluster) : unknown_});
   auto labels = node.labels();
   if (labels) {
     auto app_iter = labels->LookupByKey("app");
     auto app = app_iter ? app_iter->value() : nullptr;
     auto app_view = GetFromFbStringView(app);
-    tags.push_back({source_app_, !app_view.empty() ? pool_.add(app_view) : unknown_});
+    tags.push_back({source_app_, !app_view.empty() ? pool.add(app_view) : unknown_});
 
     auto version_iter = labels->LookupByKey("version");
     auto version = version_iter ? version_iter->value() : nullptr;
     auto version_view = GetFromFbStringView(version);
-    tags.push_back({source_version_, !version_view.empty() ? pool_.add(version_view) : unknown_});
+    tags.push_back({source_version_, !version_view.empty() ? pool.add(version_view) : unknown_});
 
     auto canonical_name = labels->LookupByKey(::Wasm::Common::kCanonicalServiceLabelName.data());
     auto name = canonical_name ? canonical_name->value() : node.workload_name();
     auto name_view = GetFromFbStringView(name);
     tags.push_back(
-        {source_canonical_service_, !name_view.empty() ? pool_.add(name_view) : unknown_});
+        {source_canonical_service_, !name_view.empty() ? pool.add(name_view) : unknown_});
 
     auto rev = labels->LookupByKey(::Wasm::Common::kCanonicalServiceRevisionLabelName.data());
     if (rev) {
       auto rev_view = GetFromFbStringView(rev->value());
       tags.push_back(
-          {source_canonical_revision_, !rev_view.empty() ? pool_.add(rev_view) : unknown_});
+          {source_canonical_revision_, !rev_view.empty() ? pool.add(rev_view) : unknown_});
     } else {
       tags.push_back({source_canonical_revision_, latest_});
     }
@@ -153,38 +235,39 @@ void IstioStats::populateSourceNodeTags(const Wasm::Common::FlatNode& node,
 }
 
 void IstioStats::populateDestinationNodeTags(const Wasm::Common::FlatNode& node,
+                                             Stats::StatNameDynamicPool& pool,
                                              Stats::StatNameTagVector& tags) {
   auto workload = GetFromFbStringView(node.workload_name());
-  tags.push_back({destination_workload_, !workload.empty() ? pool_.add(workload) : unknown_});
+  tags.push_back({destination_workload_, !workload.empty() ? pool.add(workload) : unknown_});
   auto ns = GetFromFbStringView(node.namespace_());
-  tags.push_back({destination_service_namespace_, !ns.empty() ? pool_.add(ns) : unknown_});
-  tags.push_back({destination_workload_namespace_, !ns.empty() ? pool_.add(ns) : unknown_});
+  tags.push_back({destination_service_namespace_, !ns.empty() ? pool.add(ns) : unknown_});
+  tags.push_back({destination_workload_namespace_, !ns.empty() ? pool.add(ns) : unknown_});
   auto cluster = GetFromFbStringView(node.cluster_id());
-  tags.push_back({destination_cluster_, !cluster.empty() ? pool_.add(cluster) : unknown_});
+  tags.push_back({destination_cluster_, !cluster.empty() ? pool.add(cluster) : unknown_});
   auto labels = node.labels();
   if (labels) {
     auto app_iter = labels->LookupByKey("app");
     auto app = app_iter ? app_iter->value() : nullptr;
     auto app_view = GetFromFbStringView(app);
-    tags.push_back({destination_app_, !app_view.empty() ? pool_.add(app_view) : unknown_});
+    tags.push_back({destination_app_, !app_view.empty() ? pool.add(app_view) : unknown_});
 
     auto version_iter = labels->LookupByKey("version");
     auto version = version_iter ? version_iter->value() : nullptr;
     auto version_view = GetFromFbStringView(version);
     tags.push_back(
-        {destination_version_, !version_view.empty() ? pool_.add(version_view) : unknown_});
+        {destination_version_, !version_view.empty() ? pool.add(version_view) : unknown_});
 
     auto canonical_name = labels->LookupByKey(::Wasm::Common::kCanonicalServiceLabelName.data());
     auto name = canonical_name ? canonical_name->value() : node.workload_name();
     auto name_view = GetFromFbStringView(name);
     tags.push_back(
-        {destination_canonical_service_, !name_view.empty() ? pool_.add(name_view) : unknown_});
+        {destination_canonical_service_, !name_view.empty() ? pool.add(name_view) : unknown_});
 
     auto rev = labels->LookupByKey(::Wasm::Common::kCanonicalServiceRevisionLabelName.data());
     if (rev) {
       auto rev_view = GetFromFbStringView(rev->value());
       tags.push_back(
-          {destination_canonical_revision_, !rev_view.empty() ? pool_.add(rev_view) : unknown_});
+          {destination_canonical_revision_, !rev_view.empty() ? pool.add(rev_view) : unknown_});
     } else {
       tags.push_back({destination_canonical_revision_, latest_});
     }
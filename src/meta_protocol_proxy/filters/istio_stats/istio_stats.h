@@ -7,6 +7,7 @@
 #include "envoy/stats/scope.h"
 #include "envoy/config/core/v3/base.pb.h"
 #include "envoy/server/factory_context.h"
+#include "envoy/thread_local/thread_local.h"
 
 #include "source/common/stats/symbol_table.h"
 #include "source/common/stats/utility.h"
@@ -33,14 +34,39 @@ public:
               const std::string& destination_service);
 
 private:
-  void populateSourceNodeTags(const Wasm::Common::FlatNode& node, Stats::StatNameTagVector& tags);
+  // The metrics of one combination of tag values.
+  struct CachedMetrics {
+    Stats::Counter& requests_total_;
+    Stats::Histogram& request_duration_milliseconds_;
+    Stats::Histogram& request_bytes_;
+    Stats::Histogram& response_bytes_;
+  };
+
+  // Resolving the metrics means building ~25 tags and looking them up in the symbol table, which
+  // takes a process-wide lock. Every worker thread keeps the metrics it has already resolved, keyed
+  // by the tag values which vary per request: the peer node, the destination service and the
+  // response code.
+  struct ThreadLocalCache : public ThreadLocal::ThreadLocalObject {
+    absl::flat_hash_map<std::string, CachedMetrics> metrics_;
+    // reused to build the lookup key without allocating
+    std::string key_;
+  };
+
+  CachedMetrics resolveMetrics(const Wasm::Common::FlatNode& peer_node,
+                               absl::optional<absl::string_view> destination_service_name,
+                               int response_code);
+  void populateSourceNodeTags(const Wasm::Common::FlatNode& node,
+                              Stats::StatNameDynamicPool& pool, Stats::StatNameTagVector& tags);
   void populateDestinationNodeTags(const Wasm::Common::FlatNode& node,
+                                   Stats::StatNameDynamicPool& pool,
                                    Stats::StatNameTagVector& tags);
   // traffic direction, inbound or outbound
   envoy::config::core::v3::TrafficDirection traffic_direction_;
   flatbuffers::DetachedBuffer local_node_info_;
   Stats::Scope& scope_;
+  // holds the constant names below, it's only written in the constructor
   Stats::StatNameDynamicPool pool_;
+  ThreadLocal::SlotPtr tls_;
   absl::flat_hash_map<std::string, Stats::StatName> all_metrics_;
   absl::flat_hash_map<std::string, Stats::StatName> all_tags_;
 
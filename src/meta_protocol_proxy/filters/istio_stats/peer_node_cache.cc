@@ -0,0 +1,59 @@
+#include "src/meta_protocol_proxy/filters/istio_stats/peer_node_cache.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace IstioStats {
+
+PeerNodeCache::PeerNodeCache(ThreadLocal::SlotAllocator& tls, uint32_t max_size)
+    : max_size_(max_size), empty_node_(std::make_shared<const flatbuffers::DetachedBuffer>(
+                               Wasm::Common::extractEmptyNodeFlatBuffer())),
+      tls_(tls.allocateSlot()) {
+  tls_->set([](Event::Dispatcher&) -> ThreadLocal::ThreadLocalObjectSharedPtr {
+    return std::make_shared<ThreadLocalCache>();
+  });
+}
+
+PeerNodeSharedPtr PeerNodeCache::get(absl::string_view id) {
+  if (max_size_ == 0) {
+    return nullptr;
+  }
+
+  auto& cache = tls_->getTyped<ThreadLocalCache>();
+  auto it = cache.index_.find(id);
+  if (it == cache.index_.end()) {
+    return nullptr;
+  }
+  // move the entry to the front of the list, the iterators stay valid
+  cache.entries_.splice(cache.entries_.begin(), cache.entries_, it->second);
+  return it->second->node_;
+}
+
+void PeerNodeCache::put(absl::string_view id, PeerNodeSharedPtr node) {
+  if (max_size_ == 0) {
+    return;
+  }
+
+  auto& cache = tls_->getTyped<ThreadLocalCache>();
+  auto it = cache.index_.find(id);
+  if (it != cache.index_.end()) {
+    it->second->node_ = std::move(node);
+    cache.entries_.splice(cache.entries_.begin(), cache.entries_, it->second);
+    return;
+  }
+
+  if (cache.entries_.size() >= max_size_) {
+    // the index refers to the id stored in the entry, so remove it before the entry
+    cache.index_.erase(cache.entries_.back().id_);
+    cache.entries_.pop_back();
+  }
+  cache.entries_.push_front(Entry{std::string(id), std::move(node)});
+  cache.index_.emplace(cache.entries_.front().id_, cache.entries_.begin());
+}
+
+} // namespace IstioStats
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <string>
+
+#include "envoy/thread_local/thread_local.h"
+
+// istio proxy
+#include "extensions/common/proto_util.h"
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace IstioStats {
+
+using PeerNodeSharedPtr = std::shared_ptr<const flatbuffers::DetachedBuffer>;
+
+/**
+ * A worker-local LRU cache of decoded peer node metadata keyed by x-envoy-peer-metadata-id, so the
+ * base64 decoding and the FlatBuffer construction are only done the first time a worker sees a
+ * peer.
+ */
+class PeerNodeCache {
+public:
+  PeerNodeCache(ThreadLocal::SlotAllocator& tls, uint32_t max_size);
+
+  /**
+   * @return the cached peer node of the id, or nullptr if it's not in the cache.
+   */
+  PeerNodeSharedPtr get(absl::string_view id);
+
+  /**
+   * Add the peer node of the id to the cache, evict the least recently used one if the cache is
+   * full.
+   */
+  void put(absl::string_view id, PeerNodeSharedPtr node);
+
+  /**
+   * @return the node used when there is no peer metadata. It's shared by all the workers.
+   */
+  const PeerNodeSharedPtr& emptyNode() const { return empty_node_; }
+
+private:
+  struct Entry {
+    std::string id_;
+    PeerNodeSharedPtr node_;
+  };
+  using EntryList = std::list<Entry>;
+
+  struct ThreadLocalCache : public ThreadLocal::ThreadLocalObject {
+    // most recently used first
+    EntryList entries_;
+    absl::flat_hash_map<absl::string_view, EntryList::iterator> index_;
+  };
+
+  const uint32_t max_size_;
+  const PeerNodeSharedPtr empty_node_;
+  ThreadLocal::SlotPtr tls_;
+};
+
+using PeerNodeCacheSharedPtr = std::shared_ptr<PeerNodeCache>;
+
+} // namespace IstioStats
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
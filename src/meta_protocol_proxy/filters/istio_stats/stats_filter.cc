@@ -10,10 +10,10 @@ namespace MetaProtocolProxy {
 namespace IstioStats {
 StatsFilter::StatsFilter(const aeraki::meta_protocol_proxy::filters::istio_stats::v1alpha::IstioStats& config,
                          const Server::Configuration::FactoryContext& context,
-                         IstioStats& istioStats)
-    : istio_stats_(istioStats), destination_service_(config.destination_service()) {
+                         IstioStats& istioStats, PeerNodeCache& peer_node_cache)
+    : peer_node_info_(peer_node_cache.emptyNode()), istio_stats_(istioStats),
+      peer_node_cache_(peer_node_cache), destination_service_(config.destination_service()) {
   traffic_direction_ = context.listenerInfo().direction();
-  peer_node_info_ = Wasm::Common::extractEmptyNodeFlatBuffer();
 }
 
 FilterStatus StatsFilter::onMessageDecoded(MetadataSharedPtr metadata, MutationSharedPtr) {
@@ -29,21 +29,34 @@ FilterStatus StatsFilter::onMessageEncoded(MetadataSharedPtr metadata, MutationS
   if (traffic_direction_ == envoy::config::core::v3::TrafficDirection::OUTBOUND) {
     peer_node_info_ = extractPeerNodeMetadata(metadata);
   }
-  const auto& peer_node = *flatbuffers::GetRoot<Wasm::Common::FlatNode>(peer_node_info_.data());
+  const auto& peer_node = *flatbuffers::GetRoot<Wasm::Common::FlatNode>(peer_node_info_->data());
   istio_stats_.report(peer_node, metadata, destination_service_);
   return FilterStatus::ContinueIteration;
 }
 
-flatbuffers::DetachedBuffer StatsFilter::extractPeerNodeMetadata(MetadataSharedPtr metadata) {
+PeerNodeSharedPtr StatsFilter::extractPeerNodeMetadata(MetadataSharedPtr metadata) {
+  std::string metadataId = metadata->getString(ExchangeMetadataHeaderId);
+  if (metadataId != "") {
+    auto cached = peer_node_cache_.get(metadataId);
+    if (cached != nullptr) {
+      return cached;
+    }
+  }
+
   std::string metadataHeader = metadata->getString(ExchangeMetadataHeader);
   if (metadataHeader != "") {
     auto bytes = Base64::decodeWithoutPadding(metadataHeader);
     google::protobuf::Struct metadata;
     if (metadata.ParseFromString(bytes)) {
-      return Wasm::Common::extractNodeFlatBufferFromStruct(metadata);
+      auto node = std::make_shared<const flatbuffers::DetachedBuffer>(
+          Wasm::Common::extractNodeFlatBufferFromStruct(metadata));
+      if (metadataId != "") {
+        peer_node_cache_.put(metadataId, node);
+      }
+      return node;
     }
   }
-  return Wasm::Common::extractEmptyNodeFlatBuffer();
+  return peer_node_cache_.emptyNode();
 }
 
 } // namespace IstioStats
@@ -12,6 +12,7 @@
 #include "api/meta_protocol_proxy/filters/istio_stats/v1alpha/istio_stats.pb.h"
 #include "src/meta_protocol_proxy/filters/filter.h"
 #include "src/meta_protocol_proxy/filters/istio_stats/istio_stats.h"
+#include "src/meta_protocol_proxy/filters/istio_stats/peer_node_cache.h"
 
 namespace Envoy {
 namespace Extensions {
@@ -25,7 +26,8 @@ const std::string ExchangeMetadataHeaderId = "x-envoy-peer-metadata-id";
 class StatsFilter : public CodecFilter, Logger::Loggable<Logger::Id::filter> {
 public:
   StatsFilter(const aeraki::meta_protocol_proxy::filters::istio_stats::v1alpha::IstioStats&,
-              const Server::Configuration::FactoryContext& context, IstioStats& istioStats);
+              const Server::Configuration::FactoryContext& context, IstioStats& istioStats,
+              PeerNodeCache& peer_node_cache);
   ~StatsFilter() override = default;
   void onDestroy() override{};
 
@@ -37,13 +39,14 @@ public:
   FilterStatus onMessageEncoded(MetadataSharedPtr, MutationSharedPtr) override;
 
 private:
-  flatbuffers::DetachedBuffer extractPeerNodeMetadata(MetadataSharedPtr metadata);
+  PeerNodeSharedPtr extractPeerNodeMetadata(MetadataSharedPtr metadata);
 
   // traffic direction, inbound or outbound
   envoy::config::core::v3::TrafficDirection traffic_direction_;
 
-  flatbuffers::DetachedBuffer peer_node_info_;
+  PeerNodeSharedPtr peer_node_info_;
   IstioStats& istio_stats_;
+  PeerNodeCache& peer_node_cache_;
   const std::string& destination_service_;
 };
 
@@ -13,7 +13,10 @@ FilterFactoryCb LocalRateLimitFilterConfig::createFilterFactoryFromProtoTyped(
     const aeraki::meta_protocol_proxy::filters::local_ratelimit::v1alpha::LocalRateLimit& cfg, const std::string&,
     Server::Configuration::FactoryContext& context) {
 
-  auto filter_config = std::make_shared<FilterConfig>(cfg, context.scope(), context.serverFactoryContext().mainThreadDispatcher() );
+  // The filter config is shared by all the workers, so the token buckets are process-wide.
+  auto filter_config = std::make_shared<FilterConfig>(
+      cfg, context.scope(), context.serverFactoryContext().mainThreadDispatcher(),
+      context.serverFactoryContext().options().concurrency());
 
   // cfg is changed
   return [cfg, filter_config](FilterChainFactoryCallbacks& callbacks) -> void {
@@ -11,14 +11,14 @@ namespace MetaProtocolProxy {
 namespace LocalRateLimit {
 
 FilterConfig::FilterConfig(const LocalRateLimitConfig& cfg, Stats::Scope& scope,
-                           Event::Dispatcher& dispatcher)
+                           Event::Dispatcher& dispatcher, uint32_t concurrency)
     : stats_(LocalRateLimitStats::generateStats(cfg.stat_prefix(), scope)),
       rate_limiter_(LocalRateLimiterImpl(
           std::chrono::milliseconds(
               PROTOBUF_GET_MS_OR_DEFAULT(cfg.token_bucket(), fill_interval, 0)),
           cfg.token_bucket().max_tokens(),
           PROTOBUF_GET_WRAPPED_OR_DEFAULT(cfg.token_bucket(), tokens_per_fill, 1), dispatcher,
-          cfg.conditions(), cfg)) {}
+          cfg.conditions(), cfg, concurrency)) {}
 
 void LocalRateLimit::onDestroy() { cleanup(); }
 
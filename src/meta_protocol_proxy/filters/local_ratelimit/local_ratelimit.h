@@ -25,7 +25,8 @@ namespace LocalRateLimit {
 
 class FilterConfig {
 public:
-  FilterConfig(const LocalRateLimitConfig& cfg, Stats::Scope& scope, Event::Dispatcher& dispatcher);
+  FilterConfig(const LocalRateLimitConfig& cfg, Stats::Scope& scope, Event::Dispatcher& dispatcher,
+               uint32_t concurrency);
   ~FilterConfig() = default;
 
   LocalRateLimitStats& stats() { return stats_; }
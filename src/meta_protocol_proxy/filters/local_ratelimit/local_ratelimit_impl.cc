@@ -9,22 +9,36 @@ namespace NetworkFilters {
 namespace MetaProtocolProxy {
 namespace LocalRateLimit {
 
+namespace {
+
+// Gives each thread a small, stable ordinal, so that the workers are spread over the token shards.
+uint32_t threadOrdinal() {
+  static std::atomic<uint32_t> next_ordinal{0};
+  thread_local const uint32_t ordinal = next_ordinal.fetch_add(1, std::memory_order_relaxed);
+  return ordinal;
+}
+
+} // namespace
+
 LocalRateLimiterImpl::LocalRateLimiterImpl(
     const std::chrono::milliseconds fill_interval, const uint32_t max_tokens,
     const uint32_t tokens_per_fill, Event::Dispatcher& dispatcher,
     const Protobuf::RepeatedPtrField<
         aeraki::meta_protocol_proxy::filters::local_ratelimit::v1alpha::LocalRateLimitCondition>&
     conditions,
-    const LocalRateLimitConfig& cfg)
+    const LocalRateLimitConfig& cfg, uint32_t concurrency)
     : fill_timer_(dispatcher.createTimer([this] { onFillTimer(); })),
       time_source_(dispatcher.timeSource()), timer_duration_(fill_interval),
-      config_(cfg){
+      shard_count_(cfg.token_sharing_mode() == LocalRateLimitConfig::SHARDED
+                       ? std::max<uint32_t>(concurrency, 1)
+                       : 1),
+      config_(cfg) {
   if (config_.has_token_bucket()) {
     // The global token bucket for the whole service
     global_token_bucket_.max_tokens_ = max_tokens;
     global_token_bucket_.tokens_per_fill_ = tokens_per_fill;
     global_token_bucket_.fill_interval_ = absl::FromChrono(fill_interval);
-    global_token_state_.tokens_ = max_tokens;
+    initTokenState(global_token_state_, global_token_bucket_);
   }
 
   // Use the minimum fill interval as the duration for the timer
@@ -56,7 +70,7 @@ LocalRateLimiterImpl::LocalRateLimiterImpl(
     new_condition.token_bucket_ = token_bucket;
 
     auto token_state = std::make_unique<TokenState>();
-    token_state->tokens_ = token_bucket.max_tokens_;
+    initTokenState(*token_state, token_bucket);
     token_state->fill_time_ = time_source_.monotonicTime();
     new_condition.token_state_ = std::move(token_state);
 
@@ -73,22 +87,60 @@ void LocalRateLimiterImpl::onFillTimer() {
   fill_timer_->enableTimer(timer_duration_);
 }
 
-void LocalRateLimiterImpl::onFillTimerHelper(const TokenState& tokens,
+void LocalRateLimiterImpl::initTokenState(TokenState& state,
+                                          const RateLimit::TokenBucket& bucket) const {
+  // Every shard should be able to hold at least one token.
+  state.shard_count_ = std::max<uint32_t>(std::min(shard_count_, bucket.max_tokens_), 1);
+  state.shards_ = std::make_unique<TokenShard[]>(state.shard_count_);
+  // Split max_tokens across the shards, so that the sum of all the shards never exceeds it.
+  for (uint32_t i = 0; i < state.shard_count_; i++) {
+    TokenShard& shard = state.shards_[i];
+    shard.max_tokens_ = bucket.max_tokens_ / state.shard_count_ +
+                        (i < bucket.max_tokens_ % state.shard_count_ ? 1 : 0);
+    shard.tokens_ = shard.max_tokens_;
+  }
+}
+
+void LocalRateLimiterImpl::onFillTimerHelper(TokenState& state,
                                              const RateLimit::TokenBucket& bucket) {
+  // Spread the new tokens evenly over the shards, starting from a different shard at each fill so
+  // that the remainder doesn't always go to the same shards. The tokens which don't fit into a full
+  // shard are carried over to the next ones.
+  uint32_t tokens_to_fill = bucket.tokens_per_fill_;
+  for (uint32_t i = 0; i < state.shard_count_ && tokens_to_fill > 0; i++) {
+    const uint32_t remaining_shards = state.shard_count_ - i;
+    const uint32_t share =
+        tokens_to_fill / remaining_shards + (tokens_to_fill % remaining_shards ? 1 : 0);
+    tokens_to_fill -=
+        fillShard(state.shards_[(state.next_fill_shard_ + i) % state.shard_count_], share);
+  }
+  // The shards filled first only took their share, so the tokens which didn't fit into the last
+  // ones go to any shard with room left. A sharded bucket then gets as many tokens as a single one.
+  for (uint32_t i = 0; i < state.shard_count_ && tokens_to_fill > 0; i++) {
+    tokens_to_fill -=
+        fillShard(state.shards_[(state.next_fill_shard_ + i) % state.shard_count_], tokens_to_fill);
+  }
+  state.next_fill_shard_ = (state.next_fill_shard_ + 1) % state.shard_count_;
+}
+
+uint32_t LocalRateLimiterImpl::fillShard(const TokenShard& shard, uint32_t tokens) {
   // Relaxed consistency is used for all operations because we don't care about ordering, just the
   // final atomic correctness.
-  uint32_t expected_tokens = tokens.tokens_.load(std::memory_order_relaxed);
-  uint32_t new_tokens_value;
+  uint32_t expected_tokens = shard.tokens_.load(std::memory_order_relaxed);
+  uint32_t added_tokens;
   do {
     // expected_tokens is either initialized above or reloaded during the CAS failure below.
-    new_tokens_value = std::min(bucket.max_tokens_, expected_tokens + bucket.tokens_per_fill_);
+    added_tokens = expected_tokens >= shard.max_tokens_
+                       ? 0
+                       : std::min(shard.max_tokens_ - expected_tokens, tokens);
 
     // Testing hook.
     synchronizer_.syncPoint("on_fill_timer_pre_cas");
 
     // Loop while the weak CAS fails trying to update the tokens value.
-  } while (!tokens.tokens_.compare_exchange_weak(expected_tokens, new_tokens_value,
-                                                 std::memory_order_relaxed));
+  } while (!shard.tokens_.compare_exchange_weak(expected_tokens, expected_tokens + added_tokens,
+                                                std::memory_order_relaxed));
+  return added_tokens;
 }
 
 void LocalRateLimiterImpl::onFillTimerConditionHelper() {
@@ -113,10 +165,22 @@ void LocalRateLimiterImpl::onFillTimerConditionHelper() {
   }
 }
 
-bool LocalRateLimiterImpl::requestAllowedHelper(const TokenState& tokens) const {
+bool LocalRateLimiterImpl::requestAllowedHelper(const TokenState& state) const {
+  // Take a token from the shard of the current worker first, and borrow one from the other shards
+  // if that shard is exhausted.
+  const uint32_t first_shard = state.shard_count_ == 1 ? 0 : threadOrdinal() % state.shard_count_;
+  for (uint32_t i = 0; i < state.shard_count_; i++) {
+    if (consumeToken(state.shards_[(first_shard + i) % state.shard_count_])) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool LocalRateLimiterImpl::consumeToken(const TokenShard& shard) const {
   // Relaxed consistency is used for all operations because we don't care about ordering, just the
   // final atomic correctness.
-  uint32_t expected_tokens = tokens.tokens_.load(std::memory_order_relaxed);
+  uint32_t expected_tokens = shard.tokens_.load(std::memory_order_relaxed);
   do {
     // expected_tokens is either initialized above or reloaded during the CAS failure below.
     if (expected_tokens == 0) {
@@ -127,8 +191,8 @@ bool LocalRateLimiterImpl::requestAllowedHelper(const TokenState& tokens) const
     synchronizer_.syncPoint("allowed_pre_cas");
 
     // Loop while the weak CAS fails trying to subtract 1 from expected.
-  } while (!tokens.tokens_.compare_exchange_weak(expected_tokens, expected_tokens - 1,
-                                                 std::memory_order_relaxed));
+  } while (!shard.tokens_.compare_exchange_weak(expected_tokens, expected_tokens - 1,
+                                                std::memory_order_relaxed));
 
   // We successfully decremented the counter by 1.
   return true;
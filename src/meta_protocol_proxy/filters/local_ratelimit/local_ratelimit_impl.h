@@ -7,6 +7,8 @@
 #include "envoy/extensions/common/ratelimit/v3/ratelimit.pb.h"
 #include "envoy/ratelimit/ratelimit.h"
 
+#include "absl/base/optimization.h"
+
 #include "source/common/common/thread_synchronizer.h"
 #include "source/common/protobuf/protobuf.h"
 #include "source/common/http/header_utility.h"
@@ -31,14 +33,25 @@ public:
       const Protobuf::RepeatedPtrField<
           aeraki::meta_protocol_proxy::filters::local_ratelimit::v1alpha::LocalRateLimitCondition>&
       conditions,
-      const LocalRateLimitConfig& cfg);
+      const LocalRateLimitConfig& cfg, uint32_t concurrency);
   ~LocalRateLimiterImpl();
 
   bool requestAllowed(MetadataSharedPtr metadata) const;
 
 private:
+  // Each shard sits on its own cache line, so that the workers consuming tokens from different
+  // shards don't contend with each other.
+  struct alignas(ABSL_CACHELINE_SIZE) TokenShard {
+    mutable std::atomic<uint32_t> tokens_{0};
+    uint32_t max_tokens_{0};
+  };
+
+  // The tokens of a bucket. There is only one shard unless the token sharing mode is SHARDED.
   struct TokenState {
-    mutable std::atomic<uint32_t> tokens_;
+    std::unique_ptr<TokenShard[]> shards_;
+    uint32_t shard_count_{1};
+    // The shard which gets the first share of the tokens at the next fill.
+    uint32_t next_fill_shard_{0};
     MonotonicTime fill_time_;
   };
 
@@ -49,9 +62,12 @@ private:
   };
 
   void onFillTimer();
-  void onFillTimerHelper(const TokenState& state, const RateLimit::TokenBucket& bucket);
+  void initTokenState(TokenState& state, const RateLimit::TokenBucket& bucket) const;
+  void onFillTimerHelper(TokenState& state, const RateLimit::TokenBucket& bucket);
+  uint32_t fillShard(const TokenShard& shard, uint32_t tokens);
   void onFillTimerConditionHelper();
-  bool requestAllowedHelper(const TokenState& tokens) const;
+  bool requestAllowedHelper(const TokenState& state) const;
+  bool consumeToken(const TokenShard& shard) const;
 
   RateLimit::TokenBucket global_token_bucket_; // The global token bucket for the whole service
   TokenState global_token_state_;                   // The global token for the whole service
@@ -59,6 +75,7 @@ private:
   TimeSource& time_source_;
   std::vector<LocalRateLimitCondition> conditions_;
   std::chrono::milliseconds timer_duration_;
+  uint32_t shard_count_{1};
 
   mutable Thread::ThreadSynchronizer synchronizer_; // Used for testing only.
 
@@ -12,9 +12,9 @@ namespace MetadataExchange {
 FilterFactoryCb MetadataExchangeFilterConfig::createFilterFactoryFromProtoTyped(
     const aeraki::meta_protocol_proxy::filters::metadata_exchange::v1alpha::MetadataExchange& cfg,
     const std::string&, Server::Configuration::FactoryContext& context) {
-      // cfg is changed
-      return [cfg, &context](FilterChainFactoryCallbacks& callbacks) -> void {
-    callbacks.addFilter(std::make_shared<MetadataExchangeFilter>(cfg, context));
+  auto config = std::make_shared<FilterConfig>(cfg, context);
+  return [config](FilterChainFactoryCallbacks& callbacks) -> void {
+    callbacks.addFilter(std::make_shared<MetadataExchangeFilter>(*config));
   };
 }
 
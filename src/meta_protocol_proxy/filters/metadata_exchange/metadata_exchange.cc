@@ -1,5 +1,10 @@
 #include "src/meta_protocol_proxy/filters/metadata_exchange/metadata_exchange.h"
 
+#include "envoy/network/connection.h"
+#include "envoy/stream_info/filter_state.h"
+
+#include "source/common/protobuf/utility.h"
+
 #include "src/meta_protocol_proxy/filters/common/base64.h"
 
 namespace Envoy {
@@ -7,19 +12,52 @@ namespace Extensions {
 namespace NetworkFilters {
 namespace MetaProtocolProxy {
 namespace MetadataExchange {
-MetadataExchangeFilter::MetadataExchangeFilter(
-    const aeraki::meta_protocol_proxy::filters::metadata_exchange::v1alpha::MetadataExchange&,
-    const Server::Configuration::FactoryContext& context) {
+
+namespace {
+
+// Marks a downstream connection on which the full node metadata has been sent.
+class MetadataSentObject : public StreamInfo::FilterState::Object {
+public:
+  // the responses sent without the full metadata since it was last sent
+  uint32_t responses_without_metadata_{0};
+};
+
+const std::string& metadataSentKey() {
+  CONSTRUCT_ON_FIRST_USE(std::string, "aeraki.meta_protocol.metadata_exchange.metadata_sent");
+}
+
+} // namespace
+
+FilterConfig::FilterConfig(
+    const aeraki::meta_protocol_proxy::filters::metadata_exchange::v1alpha::MetadataExchange&
+        config,
+    const Server::Configuration::FactoryContext& context)
+    : send_metadata_once_per_connection_(config.send_metadata_once_per_connection()),
+      metadata_resend_interval_(
+          PROTOBUF_GET_WRAPPED_OR_DEFAULT(config, metadata_resend_interval, 100)) {
   loadMetadataFromNodeInfo(context.serverFactoryContext().localInfo());
   traffic_direction_ = context.listenerInfo().direction();
 }
 
+void FilterConfig::loadMetadataFromNodeInfo(const LocalInfo::LocalInfo& local_info) {
+  if (local_info.node().has_metadata()) {
+    google::protobuf::Struct metadata;
+    const auto fb = Wasm::Common::extractNodeFlatBufferFromStruct(local_info.node().metadata());
+    Wasm::Common::extractStructFromNodeFlatBuffer(
+        *flatbuffers::GetRoot<Wasm::Common::FlatNode>(fb.data()), &metadata);
+    std::string metadata_bytes;
+    Wasm::Common::serializeToStringDeterministic(metadata, &metadata_bytes);
+    local_node_metadata_ = Base64::encode(metadata_bytes.data(), metadata_bytes.size());
+  }
+  local_node_metadata_id_ = local_info.node().id();
+}
+
 FilterStatus MetadataExchangeFilter::onMessageDecoded(MetadataSharedPtr,
                                                       MutationSharedPtr mutation) {
   // if this is an outbound request, we need to send node metadata to peer
-  if (traffic_direction_ == envoy::config::core::v3::TrafficDirection::OUTBOUND) {
-    (*mutation.get())[ExchangeMetadataHeader] = local_node_metadata_;
-    (*mutation.get())[ExchangeMetadataHeaderId] = local_node_metadata_id_;
+  if (config_.trafficDirection() == envoy::config::core::v3::TrafficDirection::OUTBOUND) {
+    (*mutation.get())[ExchangeMetadataHeader] = config_.localNodeMetadata();
+    (*mutation.get())[ExchangeMetadataHeaderId] = config_.localNodeMetadataId();
   }
   return FilterStatus::ContinueIteration;
 }
@@ -27,24 +65,39 @@ FilterStatus MetadataExchangeFilter::onMessageDecoded(MetadataSharedPtr,
 FilterStatus MetadataExchangeFilter::onMessageEncoded(MetadataSharedPtr,
                                                       MutationSharedPtr mutation) {
   // if this is an inbound request, we need to send node metadata to peer in the response
-  if (traffic_direction_ == envoy::config::core::v3::TrafficDirection::INBOUND) {
-    (*mutation.get())[ExchangeMetadataHeader] = local_node_metadata_;
-    (*mutation.get())[ExchangeMetadataHeaderId] = local_node_metadata_id_;
+  if (config_.trafficDirection() == envoy::config::core::v3::TrafficDirection::INBOUND) {
+    // All the responses on a downstream connection are received by the same worker of the peer,
+    // which caches the metadata by its id after the first response.
+    if (!config_.sendMetadataOncePerConnection() || !metadataSentOnConnection()) {
+      (*mutation.get())[ExchangeMetadataHeader] = config_.localNodeMetadata();
+    }
+    (*mutation.get())[ExchangeMetadataHeaderId] = config_.localNodeMetadataId();
   }
   return FilterStatus::ContinueIteration;
 }
 
-void MetadataExchangeFilter::loadMetadataFromNodeInfo(const LocalInfo::LocalInfo& local_info) {
-  if (local_info.node().has_metadata()) {
-    google::protobuf::Struct metadata;
-    const auto fb = Wasm::Common::extractNodeFlatBufferFromStruct(local_info.node().metadata());
-    Wasm::Common::extractStructFromNodeFlatBuffer(
-        *flatbuffers::GetRoot<Wasm::Common::FlatNode>(fb.data()), &metadata);
-    std::string metadata_bytes;
-    Wasm::Common::serializeToStringDeterministic(metadata, &metadata_bytes);
-    local_node_metadata_ = Base64::encode(metadata_bytes.data(), metadata_bytes.size());
+bool MetadataExchangeFilter::metadataSentOnConnection() {
+  const Network::Connection* connection =
+      encoder_callbacks_ != nullptr ? encoder_callbacks_->connection() : nullptr;
+  if (connection == nullptr) {
+    return false;
   }
-  local_node_metadata_id_ = local_info.node().id();
+
+  const auto& filter_state = connection->streamInfo().filterState();
+  auto* metadata_sent = filter_state->getDataMutable<MetadataSentObject>(metadataSentKey());
+  if (metadata_sent == nullptr) {
+    filter_state->setData(metadataSentKey(), std::make_shared<MetadataSentObject>(),
+                          StreamInfo::FilterState::StateType::Mutable,
+                          StreamInfo::FilterState::LifeSpan::Connection);
+    return false;
+  }
+  // The peer may have evicted the metadata from its cache, e.g. a cache full of other peers, so
+  // it's resent periodically rather than only once in the lifetime of a long lived connection.
+  if (++metadata_sent->responses_without_metadata_ >= config_.metadataResendInterval()) {
+    metadata_sent->responses_without_metadata_ = 0;
+    return false;
+  }
+  return true;
 }
 
 } // namespace MetadataExchange
@@ -20,20 +20,22 @@ namespace MetadataExchange {
 const std::string ExchangeMetadataHeader = "x-envoy-peer-metadata";
 const std::string ExchangeMetadataHeaderId = "x-envoy-peer-metadata-id";
 
-class MetadataExchangeFilter : public CodecFilter, Logger::Loggable<Logger::Id::filter> {
+/**
+ * Shared by all the metadata exchange filters created from the same config, so the local node
+ * metadata is only serialized and base64 encoded once.
+ */
+class FilterConfig {
 public:
-  MetadataExchangeFilter(
-      const aeraki::meta_protocol_proxy::filters::metadata_exchange::v1alpha::MetadataExchange&,
+  FilterConfig(
+      const aeraki::meta_protocol_proxy::filters::metadata_exchange::v1alpha::MetadataExchange&
+          config,
       const Server::Configuration::FactoryContext& context);
-  ~MetadataExchangeFilter() override = default;
-  void onDestroy() override{};
-
-  // DecoderFilter
-  void setDecoderFilterCallbacks(DecoderFilterCallbacks&) override{};
-  FilterStatus onMessageDecoded(MetadataSharedPtr metadata, MutationSharedPtr mutation) override;
 
-  void setEncoderFilterCallbacks(EncoderFilterCallbacks&) override{};
-  FilterStatus onMessageEncoded(MetadataSharedPtr, MutationSharedPtr) override;
+  const std::string& localNodeMetadata() const { return local_node_metadata_; }
+  const std::string& localNodeMetadataId() const { return local_node_metadata_id_; }
+  envoy::config::core::v3::TrafficDirection trafficDirection() const { return traffic_direction_; }
+  bool sendMetadataOncePerConnection() const { return send_metadata_once_per_connection_; }
+  uint32_t metadataResendInterval() const { return metadata_resend_interval_; }
 
 private:
   // Helper function to get node metadata.
@@ -45,6 +47,34 @@ private:
   std::string local_node_metadata_id_;
   // traffic direction, inbound or outbound
   envoy::config::core::v3::TrafficDirection traffic_direction_;
+  const bool send_metadata_once_per_connection_;
+  const uint32_t metadata_resend_interval_;
+};
+
+using FilterConfigSharedPtr = std::shared_ptr<FilterConfig>;
+
+class MetadataExchangeFilter : public CodecFilter, Logger::Loggable<Logger::Id::filter> {
+public:
+  MetadataExchangeFilter(const FilterConfig& config) : config_(config) {}
+  ~MetadataExchangeFilter() override = default;
+  void onDestroy() override{};
+
+  // DecoderFilter
+  void setDecoderFilterCallbacks(DecoderFilterCallbacks&) override{};
+  FilterStatus onMessageDecoded(MetadataSharedPtr metadata, MutationSharedPtr mutation) override;
+
+  void setEncoderFilterCallbacks(EncoderFilterCallbacks& callbacks) override {
+    encoder_callbacks_ = &callbacks;
+  };
+  FilterStatus onMessageEncoded(MetadataSharedPtr, MutationSharedPtr) override;
+
+private:
+  // Returns true if the full metadata has been sent on the downstream connection within the last
+  // resend interval responses, and records that it's sent now otherwise.
+  bool metadataSentOnConnection();
+
+  const FilterConfig& config_;
+  EncoderFilterCallbacks* encoder_callbacks_{};
 };
 
 } // namespace MetadataExchange
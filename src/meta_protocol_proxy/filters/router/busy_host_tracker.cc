@@ -0,0 +1,55 @@
+#include "src/meta_protocol_proxy/filters/router/busy_host_tracker.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Router {
+
+BusyHostTracker::BusyHostTracker(ThreadLocal::SlotAllocator& tls,
+                                 std::chrono::milliseconds backoff,
+                                 uint32_t max_host_selection_retries)
+    : backoff_(backoff), max_host_selection_retries_(max_host_selection_retries),
+      tls_(tls.allocateSlot()) {
+  tls_->set([](Event::Dispatcher&) -> ThreadLocal::ThreadLocalObjectSharedPtr {
+    return std::make_shared<BusyHosts>();
+  });
+}
+
+void BusyHostTracker::markBusy(const Upstream::HostDescription& host, MonotonicTime now) {
+  auto& busy_hosts = tls_->getTyped<BusyHosts>().busy_until_;
+  // Drop the expired entries here rather than on the hot path. Hosts which have been removed from
+  // the cluster would otherwise stay in the map forever.
+  absl::erase_if(busy_hosts, [now](const auto& entry) { return entry.second <= now; });
+  busy_hosts[host.address()->asString()] = now + backoff_;
+  ENVOY_LOG(debug, "meta protocol router: upstream host {} is busy, avoid it for {}ms",
+            host.address()->asString(), backoff_.count());
+}
+
+bool BusyHostTracker::isBusy(const Upstream::HostDescription& host, MonotonicTime now) {
+  auto& busy_hosts = tls_->getTyped<BusyHosts>().busy_until_;
+  if (busy_hosts.empty()) {
+    return false;
+  }
+
+  auto it = busy_hosts.find(host.address()->asString());
+  if (it == busy_hosts.end()) {
+    return false;
+  }
+  if (it->second <= now) {
+    // The backoff has expired, forget the host so the map only holds hosts which are busy now.
+    busy_hosts.erase(it);
+    return false;
+  }
+  return true;
+}
+
+uint32_t BusyHostTracker::hostSelectionRetryCount() const {
+  return tls_->getTyped<BusyHosts>().busy_until_.empty() ? 0 : max_host_selection_retries_;
+}
+
+} // namespace Router
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
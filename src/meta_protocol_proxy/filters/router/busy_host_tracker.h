@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include "envoy/common/time.h"
+#include "envoy/event/dispatcher.h"
+#include "envoy/thread_local/thread_local.h"
+#include "envoy/upstream/host_description.h"
+
+#include "source/common/common/logger.h"
+
+#include "absl/container/flat_hash_map.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Router {
+
+/**
+ * Remembers the upstream hosts which recently answered with a "server busy" response so that the
+ * load balancer can pick another host for new requests until the backoff expires.
+ *
+ * BusyHostTracker is shared by all the router filters created from the same router config. The
+ * busy hosts are kept in a thread-local map, so marking and checking a host never takes a lock;
+ * each worker learns about busy hosts from the responses it receives itself.
+ */
+class BusyHostTracker : Logger::Loggable<Logger::Id::filter> {
+public:
+  BusyHostTracker(ThreadLocal::SlotAllocator& tls, std::chrono::milliseconds backoff,
+                  uint32_t max_host_selection_retries);
+
+  /**
+   * Mark a host as busy until now + backoff.
+   */
+  void markBusy(const Upstream::HostDescription& host, MonotonicTime now);
+
+  /**
+   * @return true if the host answered with a busy response within the last backoff period.
+   */
+  bool isBusy(const Upstream::HostDescription& host, MonotonicTime now);
+
+  /**
+   * @return the number of host selection retries the load balancer may do to avoid busy hosts. It
+   * is zero if the current worker doesn't know any busy host, so the common case costs nothing.
+   */
+  uint32_t hostSelectionRetryCount() const;
+
+private:
+  struct BusyHosts : public ThreadLocal::ThreadLocalObject {
+    // host address -> the time until which the host is considered busy
+    absl::flat_hash_map<std::string, MonotonicTime> busy_until_;
+  };
+
+  const std::chrono::milliseconds backoff_;
+  const uint32_t max_host_selection_retries_;
+  ThreadLocal::SlotPtr tls_;
+};
+
+using BusyHostTrackerSharedPtr = std::shared_ptr<BusyHostTracker>;
+
+} // namespace Router
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
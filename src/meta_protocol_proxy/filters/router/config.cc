@@ -2,6 +2,8 @@
 
 #include "envoy/registry/registry.h"
 
+#include "source/common/protobuf/utility.h"
+
 #include "src/meta_protocol_proxy/filters/router/router_impl.h"
 #include "src/meta_protocol_proxy/filters/router/shadow_writer_impl.h"
 
@@ -12,18 +14,33 @@ namespace MetaProtocolProxy {
 namespace Router {
 
 FilterFactoryCb RouterFilterConfig::createFilterFactoryFromProtoTyped(
-    const aeraki::meta_protocol_proxy::filters::router::v1alpha::Router&, const std::string&,
-    Server::Configuration::FactoryContext& context) {
+    const aeraki::meta_protocol_proxy::filters::router::v1alpha::Router& proto_config,
+    const std::string& stat_prefix, Server::Configuration::FactoryContext& context) {
 
   auto shadow_writer = std::make_shared<ShadowWriterImpl>(
-      context.serverFactoryContext().clusterManager(), context.serverFactoryContext().mainThreadDispatcher(), context.serverFactoryContext().threadLocal());
+      context.serverFactoryContext().clusterManager(),
+      context.serverFactoryContext().mainThreadDispatcher(),
+      context.serverFactoryContext().threadLocal(),
+      ShadowStats::generateStats(stat_prefix, context.scope()));
+  auto stat_names = std::make_shared<RouterStatNames>(context.scope().symbolTable());
+  BusyHostTrackerSharedPtr busy_host_tracker;
+  if (proto_config.has_busy_host_policy()) {
+    const auto& policy = proto_config.busy_host_policy();
+    busy_host_tracker = std::make_shared<BusyHostTracker>(
+        context.serverFactoryContext().threadLocal(),
+        std::chrono::milliseconds(PROTOBUF_GET_MS_OR_DEFAULT(policy, backoff, 100)),
+        PROTOBUF_GET_WRAPPED_OR_DEFAULT(policy, max_host_selection_retries, 3));
+  }
+
   // This lambda captures the shadow_writer created above, thus shadowed requests won't be
   // destructed after the main request is finished.
   // The life span of shadow_writer is as long as the MetaProtocol ConfigImpl, see filter_factories_
   // member of the MetaProtocol ConfigImpl
-  return [&context, shadow_writer](FilterChainFactoryCallbacks& callbacks) -> void {
-    callbacks.addFilter(
-        std::make_shared<Router>(context.serverFactoryContext().clusterManager(), context.serverFactoryContext().runtime(), *shadow_writer));
+  return [&context, shadow_writer, busy_host_tracker,
+          stat_names](FilterChainFactoryCallbacks& callbacks) -> void {
+    callbacks.addFilter(std::make_shared<Router>(
+        context.serverFactoryContext().clusterManager(), context.serverFactoryContext().runtime(),
+        *shadow_writer, busy_host_tracker.get(), *stat_names));
   };
 }
 
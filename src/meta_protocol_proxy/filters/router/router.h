@@ -30,9 +30,10 @@ public:
 
   virtual void continueDecoding() PURE;
   virtual void sendLocalReply(const DirectResponse& response, bool end_stream) PURE;
-  virtual CodecPtr createCodec() PURE;
+  virtual Encoder& encoder() PURE;
   virtual void resetStream() PURE;
   virtual void setUpstreamConnection(Tcp::ConnectionPool::ConnectionDataPtr conn) PURE;
+  virtual void setUpstreamHandler(UpstreamHandlerSharedPtr upstream_handler) PURE;
   virtual void onUpstreamHostSelected(Upstream::HostDescriptionConstSharedPtr host) PURE;
 
 protected:
@@ -115,11 +116,20 @@ public:
    */
   virtual Event::Dispatcher& dispatcher() PURE;
 
+  /**
+   * Reserves the resources of a request mirrored by the policy. A successful reservation must be
+   * followed by submit, which hands it to the shadow request.
+   * @param policy supplies the mirror policy.
+   * @param request_size supplies the size of the mirrored request.
+   * @return false if the limits of the policy are reached, the request isn't mirrored then.
+   */
+  virtual bool reserve(const Route::RequestMirrorPolicy& policy, uint64_t request_size) PURE;
+
   /**
    * Starts the shadow request by requesting an upstream connection.
    */
-  virtual void submit(const std::string& cluster_name, MetadataSharedPtr request_metadata,
-                      MutationSharedPtr mutation, CodecFactory& codec_factory) PURE;
+  virtual void submit(const Route::RequestMirrorPolicy& policy, MetadataSharedPtr request_metadata,
+                      MutationSharedPtr mutation, DecoderFilterCallbacks& callbacks) PURE;
 };
 
 } // namespace Router
@@ -4,6 +4,9 @@
 #include "envoy/tracing/trace_reason.h"
 #include "envoy/formatter/http_formatter_context.h"
 
+#include "source/common/stats/utility.h"
+
+#include "src/meta_protocol_proxy/access_log/binary_access_log.h"
 #include "src/meta_protocol_proxy/app_exception.h"
 #include "src/meta_protocol_proxy/codec/codec.h"
 #include "src/meta_protocol_proxy/codec_impl.h"
@@ -24,6 +27,7 @@ void Router::onDestroy() {
         false); // todo: should be true, but we get segment fault in rare case
   }
   cleanUpstreamRequest();
+  setDownstreamReadDisabled(false);
 }
 
 void Router::setDecoderFilterCallbacks(DecoderFilterCallbacks& callbacks) {
@@ -36,6 +40,7 @@ FilterStatus Router::onMessageDecoded(MetadataSharedPtr request_metadata,
   ASSERT(messageType == MessageType::Request || messageType == MessageType::Stream_Init);
 
   request_metadata_ = request_metadata;
+  body_streaming_ = decoder_filter_callbacks_->bodyStreaming();
   route_ = decoder_filter_callbacks_->route();
   if (!route_) {
     ENVOY_STREAM_LOG(debug, "meta protocol router: no cluster match for request '{}'",
@@ -57,14 +62,17 @@ FilterStatus Router::onMessageDecoded(MetadataSharedPtr request_metadata,
   const std::string& cluster_name = route_entry_->clusterName();
 
   // if x-request-id is created, then it's the first span in this trace
-  is_first_span_ = setXRequestID(request_metadata, request_mutation);
+  is_first_span_ = setXRequestID(request_metadata);
   // only trace request if there's a tracing config
   if (decoder_filter_callbacks_->tracingConfig()) {
     traceRequest(request_metadata, request_mutation, cluster_name);
   }
-
-  // Save the clone for request mirroring
-  auto metadata_clone = request_metadata_->clone();
+  // add the created x-request-id to mutation, so it can be passed through to upstream requests.
+  // It's added after the tracing decision has been packed into it.
+  if (is_first_span_) {
+    (*request_mutation)[ReservedHeaders::RequestUUID] =
+        decoder_filter_callbacks_->requestIDExtension()->get(*request_metadata);
+  }
 
   route_entry_->requestMutation(request_mutation);
 
@@ -81,10 +89,13 @@ FilterStatus Router::onMessageDecoded(MetadataSharedPtr request_metadata,
           AppException(get_upstream_handler_result.error.value()), false);
       return FilterStatus::AbortIteration;
     }
-    get_upstream_handler_result.upstream_handler->addResponseCallback(
-        request_metadata_->getRequestId(), [this](MetadataSharedPtr response_metadata) {
-          this->onUpstreamResponseCallback(response_metadata);
-        });
+    // The frames of a stream are handed to the stream by the upstream handler.
+    if (messageType == MessageType::Request) {
+      get_upstream_handler_result.upstream_handler->addResponseCallback(
+          request_metadata_->getRequestId(), [this](MetadataSharedPtr response_metadata) {
+            this->onUpstreamResponseCallback(response_metadata);
+          });
+    }
     upstream_request_ = std::make_unique<UpstreamRequestByHandler>(
         *this, request_metadata_, request_mutation, get_upstream_handler_result.upstream_handler);
   } else {
@@ -103,28 +114,47 @@ FilterStatus Router::onMessageDecoded(MetadataSharedPtr request_metadata,
                                                           request_mutation);
   }
 
+  // The mirror policies are checked before the request is sent because the original message is
+  // drained when it's encoded, the request is only cloned if it's mirrored at all. It's done once
+  // the primary request has been created, so every reservation is handed to a shadow request.
+  MetadataSharedPtr metadata_clone;
+  std::vector<const Route::RequestMirrorPolicy*> shadow_policies;
+  if (!body_streaming_) {
+    // The body is forwarded as it arrives, so it can't be mirrored.
+    const uint64_t request_size = request_metadata_->originMessage().length();
+    for (const auto& policy : route_entry_->requestMirrorPolicies()) {
+      // todo replace with rand generator of conn mgr
+      if (policy->shouldShadow(runtime_, rand()) && shadow_writer_.reserve(*policy, request_size)) {
+        shadow_policies.push_back(policy.get());
+      }
+    }
+    if (!shadow_policies.empty()) {
+      metadata_clone = request_metadata_->clone();
+    }
+  }
+
   decoder_filter_callbacks_->streamInfo().setUpstreamClusterInfo(cluster_);
   ENVOY_STREAM_LOG(debug, "meta protocol router: decoding request", *decoder_filter_callbacks_);
 
+  if (body_streaming_) {
+    upstream_request_->expectRequestBody();
+  }
   auto filter_status = upstream_request_->start();
+  if (body_streaming_) {
+    decoder_filter_callbacks_->setMessageBodyCallbacks(*this);
+    return filter_status;
+  }
 
-  // Prepare connections for shadow routers, if there are mirror policies configured and currently
-  // enabled.
-  const auto& policies = route_entry_->requestMirrorPolicies();
-  ENVOY_STREAM_LOG(debug, "meta protocol router: requestMirrorPolicies size:{}",
-                   *decoder_filter_callbacks_, policies.size());
-
-  if (!policies.empty()) {
-    for (const auto& policy : policies) {
-      if (policy->shouldShadow(runtime_, rand())) { // todo replace with rand generator of conn mgr
-        // We can reuse the same metadata for each request because its original message will be
-        // drained in the request
-        ENVOY_STREAM_LOG(debug, "meta protocol router: mirror request size:{}",
-                         *decoder_filter_callbacks_, metadata_clone->originMessage().length());
-        shadow_writer_.submit(policy->clusterName(), metadata_clone->clone(), request_mutation,
-                              *decoder_filter_callbacks_);
-      }
-    }
+  // Send the request to the mirror clusters after the primary request has been sent.
+  ENVOY_STREAM_LOG(debug, "meta protocol router: mirror the request to {} clusters",
+                   *decoder_filter_callbacks_, shadow_policies.size());
+  for (const auto* policy : shadow_policies) {
+    // Each shadow request drains its own message, the clones share the bytes of metadata_clone
+    // rather than copying them.
+    ENVOY_STREAM_LOG(debug, "meta protocol router: mirror request size:{}",
+                     *decoder_filter_callbacks_, metadata_clone->originMessage().length());
+    shadow_writer_.submit(*policy, metadata_clone->clone(), request_mutation,
+                          *decoder_filter_callbacks_);
   }
 
   return filter_status;
@@ -145,23 +175,7 @@ FilterStatus Router::onMessageEncoded(MetadataSharedPtr metadata, MutationShared
   ENVOY_STREAM_LOG(trace, "meta protocol router: response status: {}", *encoder_filter_callbacks_,
                    static_cast<int>(metadata->getResponseStatus()));
 
-  switch (metadata->getResponseStatus()) {
-  case ResponseStatus::Ok:
-    if (metadata->getMessageType() == MessageType::Error) {
-      upstream_request_->upstreamHost()->outlierDetector().putResult(
-          Upstream::Outlier::Result::ExtOriginRequestFailed);
-    } else {
-      upstream_request_->upstreamHost()->outlierDetector().putResult(
-          Upstream::Outlier::Result::ExtOriginRequestSuccess);
-    }
-    break;
-  case ResponseStatus::Error:
-    upstream_request_->upstreamHost()->outlierDetector().putResult(
-        Upstream::Outlier::Result::ExtOriginRequestFailed);
-    break;
-  default:
-    break;
-  }
+  reportUpstreamResult(*metadata);
 
   return FilterStatus::ContinueIteration;
 }
@@ -262,13 +276,90 @@ void Router::onUpstreamResponseComplete(MetadataSharedPtr response_metadata) {
 }
 
 void Router::onUpstreamResponseCallback(MetadataSharedPtr response_metadata) {
+  // Responses of multiplexed requests don't go through the response decoder and the encoder
+  // filters, so complete the request and report them here.
+  decoder_filter_callbacks_->streamInfo().addBytesReceived(response_metadata->getMessageSize());
+  decoder_filter_callbacks_->streamInfo().onRequestComplete();
+  reportUpstreamResult(*response_metadata);
   onUpstreamResponseComplete(response_metadata);
   // defer delete message
   decoder_filter_callbacks_->onUpstreamResponse();
 }
 
+void Router::reportUpstreamResult(const Metadata& response_metadata) {
+  auto upstream_host = upstream_request_->upstreamHost();
+  if (upstream_host == nullptr) {
+    return;
+  }
+
+  switch (response_metadata.getResponseStatus()) {
+  case ResponseStatus::Ok:
+    if (response_metadata.getMessageType() == MessageType::Error) {
+      upstream_host->outlierDetector().putResult(Upstream::Outlier::Result::ExtOriginRequestFailed);
+    } else {
+      upstream_host->outlierDetector().putResult(
+          Upstream::Outlier::Result::ExtOriginRequestSuccess);
+    }
+    break;
+  case ResponseStatus::Error:
+    upstream_host->outlierDetector().putResult(Upstream::Outlier::Result::ExtOriginRequestFailed);
+    break;
+  case ResponseStatus::ServerBusy:
+    upstream_host->outlierDetector().putResult(Upstream::Outlier::Result::ExtOriginRequestFailed);
+    onUpstreamHostBusy(*upstream_host);
+    break;
+  default:
+    break;
+  }
+}
+
+void Router::onUpstreamHostBusy(const Upstream::HostDescription& host) {
+  ENVOY_STREAM_LOG(debug, "meta protocol router: upstream host {} is busy",
+                   *decoder_filter_callbacks_, host.address()->asString());
+  Stats::Scope& scope = host.cluster().statsScope();
+  scope.counterFromStatName(stat_names_.upstream_rq_server_busy_).inc();
+  // the address is a dynamic name, so the per-host counter doesn't take the symbol table lock
+  Stats::Utility::counterFromElements(
+      scope, {stat_names_.host_prefix_, Stats::DynamicName(host.address()->asStringView()),
+              stat_names_.host_upstream_rq_server_busy_})
+      .inc();
+
+  if (busy_host_tracker_ != nullptr) {
+    busy_host_tracker_->markBusy(
+        host, decoder_filter_callbacks_->dispatcher().approximateMonotonicTime());
+  }
+}
+
+void Router::onAboveWriteBufferHighWatermark() {
+  // Only the body of a streamed request can outpace the upstream connection.
+  if (body_streaming_) {
+    setDownstreamReadDisabled(true);
+  }
+}
+
+void Router::onBelowWriteBufferLowWatermark() {
+  if (body_streaming_) {
+    setDownstreamReadDisabled(false);
+  }
+}
+
+void Router::setDownstreamReadDisabled(bool disabled) {
+  if (downstream_read_disabled_ == disabled) {
+    return;
+  }
+  ENVOY_STREAM_LOG(debug, "meta protocol router: {} reading the request body",
+                   *decoder_filter_callbacks_, disabled ? "pause" : "resume");
+  downstream_read_disabled_ = disabled;
+  decoder_filter_callbacks_->readDisableDownstream(disabled);
+}
+
 void Router::onEvent(Network::ConnectionEvent event) {
   ASSERT(upstream_request_);
+  // the connection of a request answered before its whole body was sent is closed once the
+  // response is complete
+  if (upstream_request_->responseCompleted()) {
+    return;
+  }
 
   upstream_request_->onUpstreamConnectionEvent(event);
   if (active_span_) {
@@ -281,6 +372,16 @@ void Router::onEvent(Network::ConnectionEvent event) {
 }
 // ---- Tcp::ConnectionPool::UpstreamCallbacks ----
 
+// ---- MessageBodyCallbacks ----
+void Router::onMessageBody(Buffer::Instance& data, bool end_of_message) {
+  if (upstreamRequestFinished()) {
+    data.drain(data.length());
+    return;
+  }
+  upstream_request_->onRequestBody(data, end_of_message);
+}
+// ---- MessageBodyCallbacks ----
+
 // ---- Upstream::LoadBalancerContextBase ----
 absl::optional<uint64_t> Router::computeHashKey() {
   if (auto* hash_policy = route_entry_->hashPolicy(); hash_policy != nullptr) {
@@ -298,19 +399,24 @@ absl::optional<uint64_t> Router::computeHashKey() {
 const Network::Connection* Router::downstreamConnection() const {
   return decoder_filter_callbacks_ != nullptr ? decoder_filter_callbacks_->connection() : nullptr;
 }
+
+bool Router::shouldSelectAnotherHost(const Upstream::Host& host) {
+  if (busy_host_tracker_ == nullptr) {
+    return false;
+  }
+  return busy_host_tracker_->isBusy(
+      host, decoder_filter_callbacks_->dispatcher().approximateMonotonicTime());
+}
+
+uint32_t Router::hostSelectionRetryCount() const {
+  return busy_host_tracker_ != nullptr ? busy_host_tracker_->hostSelectionRetryCount() : 0;
+}
 // ---- Upstream::LoadBalancerContextBase ----
 
-bool Router::setXRequestID(MetadataSharedPtr& request_metadata,
-                           MutationSharedPtr& request_mutation) {
-  auto rid_extension = decoder_filter_callbacks_->requestIDExtension();
+bool Router::setXRequestID(MetadataSharedPtr& request_metadata) {
   // set x-request-id to metadata, so it can be used to record tracing sampling decision
   // RequestIDExtension only sets x-request-id if it doesn't exist in the Metadata
-  bool modified = rid_extension->set(*request_metadata, false);
-  // add x-request-id to mutation, so it can be passed through to upstream requests
-  if (modified) {
-    (*request_mutation)[ReservedHeaders::RequestUUID] = rid_extension->get(*request_metadata);
-  }
-  return modified;
+  return decoder_filter_callbacks_->requestIDExtension()->set(*request_metadata, false);
 }
 
 Envoy::Tracing::Reason Router::mutateTracingRequestMetadata(MetadataSharedPtr& request_metadata) {
@@ -379,6 +485,8 @@ void Router::traceRequest(MetadataSharedPtr request_metadata, MutationSharedPtr
   const Envoy::Tracing::Decision tracing_decision = Envoy::Tracing::Decision{reason, true};
 
   ENVOY_STREAM_LOG(debug, "meta protocol router: start tracing span", *decoder_filter_callbacks_);
+  // the span is tagged with x-request-id
+  decoder_filter_callbacks_->requestIDExtension()->materialize(*request_metadata);
   active_span_ = decoder_filter_callbacks_->tracer()->startSpan(
       *decoder_filter_callbacks_->tracingConfig(), *request_metadata, *request_mutation,
       decoder_filter_callbacks_->streamInfo(), cluster_name, tracing_decision);
@@ -400,21 +508,28 @@ void Router::emitLogEntry(const MetadataSharedPtr& request_metadata,
   decoder_filter_callbacks_->streamInfo().setResponseCode(response_code);
   decoder_filter_callbacks_->streamInfo().setResponseCodeDetails(response_code_detail);
 
-  const MetadataImpl* requestMetadataImpl = static_cast<const MetadataImpl*>(&(*request_metadata));
-  const auto& requestHeaders = requestMetadataImpl->getHeaders();
-  Envoy::Formatter::HttpFormatterContext* httpFormatterContext = new Envoy::Formatter::HttpFormatterContext(&requestHeaders);
+  BinaryAccessLog* binary_access_log = decoder_filter_callbacks_->binaryAccessLog();
+  if (binary_access_log != nullptr) {
+    binary_access_log->log(*request_metadata, response_metadata.get(), response_code,
+                           decoder_filter_callbacks_->streamInfo());
+  }
+
+  const auto& access_logs = decoder_filter_callbacks_->accessLogs();
+  if (access_logs.empty()) {
+    return;
+  }
+
+  // the loggers read x-request-id from the headers of the metadata
+  decoder_filter_callbacks_->requestIDExtension()->materialize(*request_metadata);
+  // The formatter context only refers to the headers of the metadata, so it lives on the stack.
+  const auto& request_headers = static_cast<const MetadataImpl&>(*request_metadata).getHeaders();
+  Envoy::Formatter::HttpFormatterContext formatter_context(&request_headers);
   if (response_metadata) {
-    const MetadataImpl* responseMetadataImpl =
-        static_cast<const MetadataImpl*>(&(*response_metadata));
-    const auto& responseHeaders = responseMetadataImpl->getResponseHeaders();
-    httpFormatterContext->setResponseHeaders(responseHeaders);
-    for (const auto& access_log : decoder_filter_callbacks_->accessLogs()) {
-      access_log->log(*httpFormatterContext, decoder_filter_callbacks_->streamInfo());
-    }
-  } else {
-    for (const auto& access_log : decoder_filter_callbacks_->accessLogs()) {
-      access_log->log(*httpFormatterContext, decoder_filter_callbacks_->streamInfo());
-    }
+    formatter_context.setResponseHeaders(
+        static_cast<const MetadataImpl&>(*response_metadata).getResponseHeaders());
+  }
+  for (const auto& access_log : access_logs) {
+    access_log->log(formatter_context, decoder_filter_callbacks_->streamInfo());
   }
 }
 } // namespace Router
@@ -10,7 +10,9 @@
 #include "source/common/stream_info/stream_info_impl.h"
 
 #include "src/meta_protocol_proxy/filters/filter.h"
+#include "src/meta_protocol_proxy/filters/router/busy_host_tracker.h"
 #include "src/meta_protocol_proxy/filters/router/router.h"
+#include "src/meta_protocol_proxy/filters/router/stats.h"
 #include "src/meta_protocol_proxy/filters/router/upstream_request.h"
 #include "src/meta_protocol_proxy/route/route.h"
 
@@ -23,11 +25,14 @@ namespace Router {
 class Router : public Tcp::ConnectionPool::UpstreamCallbacks,
                public Upstream::LoadBalancerContextBase,
                public RequestOwner,
+               public MessageBodyCallbacks,
                public CodecFilter {
 public:
   Router(Upstream::ClusterManager& cluster_manager, Runtime::Loader& runtime,
-         ShadowWriter& shadow_writer)
-      : RequestOwner(cluster_manager), runtime_(runtime), shadow_writer_(shadow_writer) {}
+         ShadowWriter& shadow_writer, BusyHostTracker* busy_host_tracker,
+         const RouterStatNames& stat_names)
+      : RequestOwner(cluster_manager), runtime_(runtime), shadow_writer_(shadow_writer),
+        busy_host_tracker_(busy_host_tracker), stat_names_(stat_names) {}
   ~Router() override { ENVOY_LOG(trace, "********** Router destructed ***********"); };
 
   // DecoderFilter
@@ -44,12 +49,17 @@ public:
   absl::optional<uint64_t> computeHashKey() override;
   const Envoy::Router::MetadataMatchCriteria* metadataMatchCriteria() override { return nullptr; }
   const Network::Connection* downstreamConnection() const override;
+  bool shouldSelectAnotherHost(const Upstream::Host& host) override;
+  uint32_t hostSelectionRetryCount() const override;
 
   // Tcp::ConnectionPool::UpstreamCallbacks
   void onUpstreamData(Buffer::Instance& data, bool end_stream) override;
   void onEvent(Network::ConnectionEvent event) override;
-  void onAboveWriteBufferHighWatermark() override {}
-  void onBelowWriteBufferLowWatermark() override {}
+  void onAboveWriteBufferHighWatermark() override;
+  void onBelowWriteBufferLowWatermark() override;
+
+  // MessageBodyCallbacks
+  void onMessageBody(Buffer::Instance& data, bool end_of_message) override;
 
   // RequestOwner
   Tcp::ConnectionPool::UpstreamCallbacks& upstreamCallbacks() override { return *this; };
@@ -57,11 +67,14 @@ public:
   void sendLocalReply(const DirectResponse& response, bool end_stream) override {
     decoder_filter_callbacks_->sendLocalReply(response, end_stream);
   };
-  CodecPtr createCodec() override { return decoder_filter_callbacks_->createCodec(); };
+  Encoder& encoder() override { return *decoder_filter_callbacks_->encoder(); };
   void resetStream() override;
   void setUpstreamConnection(Tcp::ConnectionPool::ConnectionDataPtr conn) override {
     decoder_filter_callbacks_->setUpstreamConnection(std::move(conn));
   };
+  void setUpstreamHandler(UpstreamHandlerSharedPtr upstream_handler) override {
+    decoder_filter_callbacks_->setUpstreamHandler(std::move(upstream_handler));
+  };
   void onUpstreamHostSelected(Upstream::HostDescriptionConstSharedPtr host) override {
     decoder_filter_callbacks_->streamInfo().setUpstreamInfo(
         std::make_shared<StreamInfo::UpstreamInfoImpl>());
@@ -76,7 +89,7 @@ public:
 private:
   void cleanUpstreamRequest();
   bool upstreamRequestFinished() { return upstream_request_ == nullptr; };
-  bool setXRequestID(MetadataSharedPtr& request_metadata, MutationSharedPtr& request_mutation);
+  bool setXRequestID(MetadataSharedPtr& request_metadata);
   void traceRequest(MetadataSharedPtr request_metadata, MutationSharedPtr request_mutation,
                     const std::string& cluster_name);
   Envoy::Tracing::Reason mutateTracingRequestMetadata(MetadataSharedPtr& request_metadata);
@@ -85,6 +98,9 @@ private:
                     const std::string& response_code_detail);
 
   void onUpstreamResponseComplete(MetadataSharedPtr response_metadata);
+  void reportUpstreamResult(const Metadata& response_metadata);
+  void onUpstreamHostBusy(const Upstream::HostDescription& host);
+  void setDownstreamReadDisabled(bool disabled);
 
   DecoderFilterCallbacks* decoder_filter_callbacks_{};
   EncoderFilterCallbacks* encoder_filter_callbacks_{};
@@ -100,8 +116,15 @@ private:
   Runtime::Loader& runtime_;
   ShadowWriter& shadow_writer_;
 
+  // nullptr if busy host policy is not configured
+  BusyHostTracker* busy_host_tracker_;
+  const RouterStatNames& stat_names_;
+
   Envoy::Tracing::SpanPtr active_span_;
   bool is_first_span_{false};
+  // whether the body of the request is forwarded while it's still being received
+  bool body_streaming_{false};
+  bool downstream_read_disabled_{false};
 };
 
 } // namespace Router
@@ -4,6 +4,7 @@
 
 #include "src/meta_protocol_proxy/app_exception.h"
 #include "src/meta_protocol_proxy/codec/codec.h"
+#include "src/meta_protocol_proxy/upstream_handler_impl.h"
 
 namespace Envoy {
 namespace Extensions {
@@ -11,11 +12,24 @@ namespace NetworkFilters {
 namespace MetaProtocolProxy {
 namespace Router {
 
-void ShadowWriterImpl::submit(const std::string& cluster_name, MetadataSharedPtr request_metadata,
-                              MutationSharedPtr request_mutation, CodecFactory& codec_factory) {
-  auto shadow_router = std::make_unique<ShadowRouterImpl>(*this, cluster_name, request_metadata,
-                                                          request_mutation, codec_factory);
-  ENVOY_LOG(debug, "meta protocol shadow router: send request to mirror host: {}", cluster_name);
+bool ShadowWriterImpl::reserve(const Route::RequestMirrorPolicy& policy, uint64_t request_size) {
+  if (!policy.resourceLimit()->tryAcquire(request_size)) {
+    ENVOY_LOG(debug, "meta protocol shadow router: too many requests mirrored to {}, drop it",
+              policy.clusterName());
+    stats_.request_overflow_.inc();
+    return false;
+  }
+  return true;
+}
+
+void ShadowWriterImpl::submit(const Route::RequestMirrorPolicy& policy,
+                              MetadataSharedPtr request_metadata,
+                              MutationSharedPtr request_mutation,
+                              DecoderFilterCallbacks& callbacks) {
+  auto shadow_router = std::make_unique<ShadowRouterImpl>(*this, policy, request_metadata,
+                                                          request_mutation, callbacks);
+  ENVOY_LOG(debug, "meta protocol shadow router: send request to mirror host: {}",
+            policy.clusterName());
   const bool created = shadow_router->createUpstreamRequest();
   if (!created) {
     return;
@@ -27,14 +41,71 @@ void ShadowWriterImpl::submit(const std::string& cluster_name, MetadataSharedPtr
   return;
 }
 
-ShadowRouterImpl::ShadowRouterImpl(ShadowWriterImpl& parent, const std::string& cluster_name,
+UpstreamHandlerSharedPtr
+ShadowWriterImpl::getUpstreamHandler(const std::string& cluster_name,
+                                     Upstream::LoadBalancerContext& context,
+                                     CodecFactory& codec_factory) {
+  auto* cluster = cm_.getThreadLocalCluster(cluster_name);
+  if (cluster == nullptr) {
+    ENVOY_LOG(debug, "meta protocol shadow router: unknown cluster '{}'", cluster_name);
+    return nullptr;
+  }
+  auto tcp_pool_data = UpstreamHandler::createTcpPoolData(*cluster, context);
+  if (!tcp_pool_data) {
+    ENVOY_LOG(debug, "meta protocol shadow router: no healthy upstream for '{}'", cluster_name);
+    return nullptr;
+  }
+  const std::string key = cluster_name + "_" + tcp_pool_data->host()->address()->asString();
+
+  auto& upstream_handlers = tls_->getTyped<ActiveRouters>().upstreamHandlers();
+  auto upstream_handler = upstream_handlers.get(key);
+  if (upstream_handler) {
+    return upstream_handler;
+  }
+
+  ENVOY_LOG(debug, "meta protocol shadow router: create upstream handler: key={}", key);
+  // There is no downstream connection, the responses of the mirrored requests are discarded.
+  auto new_upstream_handler = std::make_shared<UpstreamHandlerImpl>(
+      key, nullptr, codec_factory,
+      [&upstream_handlers](const std::string& key) { upstream_handlers.del(key); });
+  upstream_handlers.add(key, new_upstream_handler);
+  new_upstream_handler->start(*tcp_pool_data);
+  return new_upstream_handler;
+}
+
+ShadowRouterImpl::ShadowRouterImpl(ShadowWriterImpl& parent,
+                                   const Route::RequestMirrorPolicy& policy,
                                    MetadataSharedPtr metadata, MutationSharedPtr mutation,
-                                   CodecFactory& codec_factory)
-    : RequestOwner(parent.clusterManager()), parent_(parent), cluster_name_(cluster_name),
-      metadata_(metadata), mutation_(mutation), codec_(codec_factory.createCodec()),
-      decoder_(NullResponseDecoder(codec_factory.createCodec())) {}
+                                   DecoderFilterCallbacks& callbacks)
+    : RequestOwner(parent.clusterManager()), parent_(parent), cluster_name_(policy.clusterName()),
+      resource_limit_(policy.resourceLimit()), reserved_bytes_(metadata->originMessage().length()),
+      timeout_(policy.timeout()), metadata_(metadata), mutation_(mutation),
+      encoder_(callbacks.encoder()), decoder_(NullResponseDecoder(callbacks.createDecoder())),
+      multiplexing_(callbacks.multiplexing()),
+      config_codec_factory_(callbacks.configCodecFactory()) {
+  parent_.stats().request_.inc();
+  parent_.stats().request_active_.inc();
+  parent_.stats().request_active_bytes_.add(reserved_bytes_);
+}
+
+ShadowRouterImpl::~ShadowRouterImpl() {
+  ENVOY_LOG(trace, "********** ShadowRouter destructed ***********");
+  removeResponseCallback();
+  resource_limit_->release(reserved_bytes_);
+  parent_.stats().request_active_.dec();
+  parent_.stats().request_active_bytes_.sub(reserved_bytes_);
+}
 
 bool ShadowRouterImpl::createUpstreamRequest() {
+  // A slow mirror cluster must not hold the resources of the worker for long.
+  timeout_timer_ = parent_.workerDispatcher().createTimer([this]() { onTimeout(); });
+  timeout_timer_->enableTimer(timeout_);
+
+  if (multiplexing_ && metadata_->getMessageType() == MessageType::Request &&
+      createMultiplexedUpstreamRequest()) {
+    return true;
+  }
+
   auto prepare_result = prepareUpstreamRequest(cluster_name_, metadata_->getRequestId(), this);
   if (prepare_result.exception.has_value()) {
     return false;
@@ -48,11 +119,61 @@ bool ShadowRouterImpl::createUpstreamRequest() {
   return true;
 }
 
+bool ShadowRouterImpl::createMultiplexedUpstreamRequest() {
+  auto upstream_handler =
+      parent_.getUpstreamHandler(cluster_name_, *this, config_codec_factory_);
+  if (upstream_handler == nullptr) {
+    return false;
+  }
+  // The connection is shared by the mirrored requests of all the downstream connections of the
+  // worker, whose request ids may collide. A request whose id is already waiting for a response
+  // on the connection takes an exclusive connection instead.
+  if (!upstream_handler->addResponseCallback(
+          metadata_->getRequestId(), [this](MetadataSharedPtr) { onMultiplexedResponse(); })) {
+    return false;
+  }
+  response_callback_added_ = true;
+  upstream_handler_ = std::move(upstream_handler);
+
+  upstream_request_ =
+      std::make_unique<UpstreamRequestByHandler>(*this, metadata_, mutation_, upstream_handler_);
+  upstream_request_->start();
+  return true;
+}
+
+void ShadowRouterImpl::onMultiplexedResponse() {
+  ENVOY_LOG(debug, "meta protocol shadow router: multiplexed response complete");
+  // the handler removes the callback after calling it
+  response_callback_added_ = false;
+  upstream_request_->onResponseComplete();
+  cleanup();
+}
+
+void ShadowRouterImpl::removeResponseCallback() {
+  if (response_callback_added_) {
+    response_callback_added_ = false;
+    upstream_handler_->removeResponseCallback(metadata_->getRequestId());
+  }
+}
+
+void ShadowRouterImpl::onTimeout() {
+  ENVOY_LOG(debug, "meta protocol shadow router: request mirrored to {} timed out", cluster_name_);
+  parent_.stats().request_timeout_.inc();
+  // An exclusive connection is closed, otherwise the late response would be read by its next
+  // request. The late response on a multiplexed connection is discarded by request id.
+  upstream_request_->releaseUpStreamConnection(true);
+  cleanup();
+}
+
 void ShadowRouterImpl::cleanup() {
   if (removed_) {
     return;
   }
   removed_ = true;
+  if (timeout_timer_ != nullptr) {
+    timeout_timer_->disableTimer();
+  }
+  removeResponseCallback();
 
   upstream_request_->releaseUpStreamConnection(false);
   parent_.remove(*this);
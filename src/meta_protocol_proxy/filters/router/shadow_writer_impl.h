@@ -3,6 +3,7 @@
 #include <memory>
 
 #include "envoy/buffer/buffer.h"
+#include "envoy/event/timer.h"
 #include "envoy/tcp/conn_pool.h"
 #include "envoy/upstream/thread_local_cluster.h"
 
@@ -12,8 +13,10 @@
 #include "source/common/upstream/load_balancer_impl.h"
 
 #include "src/meta_protocol_proxy/decoder.h"
+#include "src/meta_protocol_proxy/upstream_handler.h"
 #include "src/meta_protocol_proxy/filters/filter.h"
 #include "src/meta_protocol_proxy/filters/router/router.h"
+#include "src/meta_protocol_proxy/filters/router/stats.h"
 #include "src/meta_protocol_proxy/filters/router/upstream_request.h"
 
 namespace Envoy {
@@ -26,8 +29,9 @@ class NullResponseDecoder : public ResponseDecoderCallbacks,
                             public MessageHandler,
                             Logger::Loggable<Logger::Id::filter> {
 public:
-  NullResponseDecoder(CodecPtr codec)
-      : codec_(std::move(codec)), decoder_(std::make_unique<ResponseDecoder>(*codec_, *this)) {}
+  NullResponseDecoder(ProtocolDecoderPtr protocol_decoder)
+      : protocol_decoder_(std::move(protocol_decoder)),
+        decoder_(std::make_unique<ResponseDecoder>(*protocol_decoder_, *this)) {}
 
   UpstreamResponseStatus decode(Buffer::Instance& data) {
     ENVOY_LOG(debug, "meta protocol shadow router: response: the received reply data length is {}",
@@ -35,7 +39,10 @@ public:
 
     bool underflow = false;
     try {
-      decoder_->onData(data, underflow);
+      if (!decoder_->onData(data, underflow)) {
+        ENVOY_LOG(error, "meta protocol error: {}", decoder_->errorDetail());
+        return UpstreamResponseStatus::Reset;
+      }
     } catch (const EnvoyException& ex) {
       ENVOY_LOG(error, "meta protocol error: {}", ex.what());
       return UpstreamResponseStatus::Reset;
@@ -65,7 +72,7 @@ public:
   bool onHeartbeat(MetadataSharedPtr) override { return true; };
 
 private:
-  CodecPtr codec_;
+  ProtocolDecoderPtr protocol_decoder_;
   ResponseDecoderPtr decoder_;
   bool complete_ : 1;
 };
@@ -80,12 +87,10 @@ class ShadowRouterImpl : public ShadowRouterHandle,
                          public Event::DeferredDeletable,
                          public LinkedObject<ShadowRouterImpl> {
 public:
-  ShadowRouterImpl(ShadowWriterImpl& parent, const std::string& cluster_name,
+  ShadowRouterImpl(ShadowWriterImpl& parent, const Route::RequestMirrorPolicy& policy,
                    MetadataSharedPtr metadata, MutationSharedPtr mutation,
-                   CodecFactory& codec_factory);
-  ~ShadowRouterImpl() override {
-    ENVOY_LOG(trace, "********** ShadowRouter destructed ***********");
-  };
+                   DecoderFilterCallbacks& callbacks);
+  ~ShadowRouterImpl() override;
 
   bool createUpstreamRequest();
   // void maybeCleanup();
@@ -101,13 +106,14 @@ public:
     (void)response;
     (void)end_stream;
   };
-  CodecPtr createCodec() override { return std::move(codec_); };
+  Encoder& encoder() override { return *encoder_; };
   void resetStream() override { // TODO
     if (upstream_request_ != nullptr) {
       upstream_request_->releaseUpStreamConnection(true);
     }
   }
   void setUpstreamConnection(Tcp::ConnectionPool::ConnectionDataPtr conn) override { (void)conn; };
+  void setUpstreamHandler(UpstreamHandlerSharedPtr) override{};
   void onUpstreamHostSelected(Upstream::HostDescriptionConstSharedPtr) override{};
 
   // Tcp::ConnectionPool::UpstreamCallbacks
@@ -124,6 +130,10 @@ private:
   using ConverterCallback = std::function<FilterStatus()>;
 
   void writeRequest();
+  bool createMultiplexedUpstreamRequest();
+  void onMultiplexedResponse();
+  void removeResponseCallback();
+  void onTimeout();
   bool requestInProgress();
   bool requestStarted() const;
   void flushPendingCallbacks();
@@ -132,11 +142,19 @@ private:
 
   ShadowWriterImpl& parent_;
   const std::string cluster_name_;
+  // The resources reserved for this request by ShadowWriter::reserve, released on destruction.
+  const Route::MirrorResourceLimitSharedPtr resource_limit_;
+  const uint64_t reserved_bytes_;
+  const std::chrono::milliseconds timeout_;
+  Event::TimerPtr timeout_timer_;
   MetadataSharedPtr metadata_;
   MutationSharedPtr mutation_;
   bool router_destroyed_{};
   Buffer::OwnedImpl upstream_request_buffer_;
-  std::unique_ptr<UpstreamRequest> upstream_request_;
+  std::unique_ptr<UpstreamRequestBase> upstream_request_;
+  // set if the request is sent on a connection multiplexed with other mirrored requests
+  UpstreamHandlerSharedPtr upstream_handler_;
+  bool response_callback_added_{};
   uint64_t request_size_{};
   uint64_t response_size_{};
   bool request_ready_ : 1;
@@ -144,8 +162,11 @@ private:
   std::list<ConverterCallback> pending_callbacks_;
   bool removed_{};
 
-  CodecPtr codec_;
+  // Keep the worker's encoder alive, the shadow request may outlive the downstream request.
+  EncoderSharedPtr encoder_;
   NullResponseDecoder decoder_;
+  const bool multiplexing_;
+  CodecFactory& config_codec_factory_;
 };
 
 class ActiveRouters : public ThreadLocal::ThreadLocalObject,
@@ -163,6 +184,8 @@ public:
   }
 
   std::list<std::unique_ptr<ShadowRouterImpl>>& activeRouters() { return active_routers_; }
+  Event::Dispatcher& dispatcher() { return dispatcher_; }
+  UpstreamHandlerManager& upstreamHandlers() { return upstream_handlers_; }
 
   void remove(ShadowRouterImpl& router) {
     ENVOY_LOG(trace, "********** remove shadow router from active routers ***********");
@@ -172,13 +195,16 @@ public:
 private:
   Event::Dispatcher& dispatcher_;
   std::list<std::unique_ptr<ShadowRouterImpl>> active_routers_;
+  // The connections shared by the mirrored requests of the worker when multiplexing is enabled,
+  // key: clusterName_address
+  UpstreamHandlerManager upstream_handlers_;
 };
 
 class ShadowWriterImpl : public ShadowWriter, Logger::Loggable<Logger::Id::filter> {
 public:
   ShadowWriterImpl(Upstream::ClusterManager& cm, Event::Dispatcher& dispatcher,
-                   ThreadLocal::SlotAllocator& tls)
-      : cm_(cm), dispatcher_(dispatcher), tls_(tls.allocateSlot()) {
+                   ThreadLocal::SlotAllocator& tls, ShadowStats stats)
+      : cm_(cm), dispatcher_(dispatcher), tls_(tls.allocateSlot()), stats_(stats) {
     // Since ShadowWriter is shared across all the dispatcher worker threads, it isn't thread-safe
     // to just store shadow routers directly inside ShadowWriter.
     // We use a thread-local store for shadow writers. Each dispatcher worker thread holds an
@@ -197,12 +223,23 @@ public:
   }
 
   void remove(ShadowRouterImpl& router) { tls_->getTyped<ActiveRouters>().remove(router); }
+  // The dispatcher of the current worker, the shadow routers run on it.
+  Event::Dispatcher& workerDispatcher() { return tls_->getTyped<ActiveRouters>().dispatcher(); }
+  ShadowStats& stats() { return stats_; }
+  /**
+   * @return the upstream handler of the worker for the host selected in the cluster, or nullptr if
+   * there is no healthy host. The responses received by the handler are discarded.
+   */
+  UpstreamHandlerSharedPtr getUpstreamHandler(const std::string& cluster_name,
+                                              Upstream::LoadBalancerContext& context,
+                                              CodecFactory& codec_factory);
 
   // Router::ShadowWriter
   Upstream::ClusterManager& clusterManager() override { return cm_; }
   Event::Dispatcher& dispatcher() override { return dispatcher_; }
-  void submit(const std::string& cluster_name, MetadataSharedPtr request_metadata,
-              MutationSharedPtr mutation, CodecFactory& codec_factory) override;
+  bool reserve(const Route::RequestMirrorPolicy& policy, uint64_t request_size) override;
+  void submit(const Route::RequestMirrorPolicy& policy, MetadataSharedPtr request_metadata,
+              MutationSharedPtr mutation, DecoderFilterCallbacks& callbacks) override;
 
 private:
   friend class ShadowRouterImpl;
@@ -210,6 +247,7 @@ private:
   Upstream::ClusterManager& cm_;
   Event::Dispatcher& dispatcher_;
   ThreadLocal::SlotPtr tls_;
+  ShadowStats stats_;
 };
 
 } // namespace Router
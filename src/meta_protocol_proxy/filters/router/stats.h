@@ -0,0 +1,65 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "envoy/stats/scope.h"
+#include "envoy/stats/stats_macros.h"
+
+#include "source/common/stats/symbol_table.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Router {
+
+/**
+ * All the stats of the mirrored requests. @see stats_macros.h
+ */
+#define ALL_SHADOW_STATS(COUNTER, GAUGE)                                                           \
+  COUNTER(request)                                                                                 \
+  COUNTER(request_overflow)                                                                        \
+  COUNTER(request_timeout)                                                                         \
+  GAUGE(request_active, Accumulate)                                                                \
+  GAUGE(request_active_bytes, Accumulate)
+
+/**
+ * Struct definition for all the stats of the mirrored requests. @see stats_macros.h
+ */
+struct ShadowStats {
+  ALL_SHADOW_STATS(GENERATE_COUNTER_STRUCT, GENERATE_GAUGE_STRUCT)
+
+  static ShadowStats generateStats(const std::string& prefix, Stats::Scope& scope) {
+    const std::string final_prefix = "meta_protocol." + prefix + ".shadow";
+    return {ALL_SHADOW_STATS(POOL_COUNTER_PREFIX(scope, final_prefix),
+                             POOL_GAUGE_PREFIX(scope, final_prefix))};
+  }
+};
+
+/**
+ * The names of the stats the router sets in the scopes of the upstream clusters. They are encoded
+ * when the config is loaded, since encoding a name on a worker takes the lock of the symbol table.
+ * The per-host stats are named meta_protocol.host.<address>.<stat>, the address is joined as a
+ * dynamic name, which doesn't go through the symbol table either.
+ */
+struct RouterStatNames {
+  explicit RouterStatNames(Stats::SymbolTable& symbol_table)
+      : pool_(symbol_table),
+        upstream_rq_server_busy_(pool_.add("meta_protocol.upstream_rq_server_busy")),
+        host_prefix_(pool_.add("meta_protocol.host")),
+        host_upstream_rq_server_busy_(pool_.add("upstream_rq_server_busy")) {}
+
+  Stats::StatNamePool pool_;
+  const Stats::StatName upstream_rq_server_busy_;
+  const Stats::StatName host_prefix_;
+  const Stats::StatName host_upstream_rq_server_busy_;
+};
+
+using RouterStatNamesSharedPtr = std::shared_ptr<RouterStatNames>;
+
+} // namespace Router
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
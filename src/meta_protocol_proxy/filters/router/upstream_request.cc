@@ -14,13 +14,15 @@ namespace Router {
 UpstreamRequestBase::UpstreamRequestBase(RequestOwner& parent, MetadataSharedPtr& metadata,
                                          MutationSharedPtr& mutation)
     : parent_(parent), metadata_(metadata), mutation_(mutation), request_complete_(false),
-      response_started_(false), response_complete_(false), stream_reset_(false) {
+      response_started_(false), response_complete_(false), stream_reset_(false),
+      request_body_complete_(true) {
   upstream_request_buffer_.move(metadata->originMessage(), metadata->originMessage().length());
 }
 
 UpstreamRequest::UpstreamRequest(RequestOwner& parent, Upstream::TcpPoolData& pool,
                                  MetadataSharedPtr& metadata, MutationSharedPtr& mutation)
-    : UpstreamRequestBase(parent, metadata, mutation), conn_pool_(pool) {}
+    : UpstreamRequestBase(parent, metadata, mutation), conn_pool_(pool),
+      pending_body_limit_(pool.host()->cluster().perConnectionBufferLimitBytes()) {}
 
 FilterStatus UpstreamRequest::start() {
   Tcp::ConnectionPool::Cancellable* handle = conn_pool_.newConnection(*this);
@@ -77,20 +79,46 @@ void UpstreamRequest::releaseUpStreamConnection(bool close) {
   // will cause segment fault
   Tcp::ConnectionPool::ConnectionDataPtr conn_data = std::move(conn_data_);
   ENVOY_LOG(debug, "meta protocol upstream request: release upstream connection");
-  if (close && conn_data != nullptr) {
+  // the next request sent on the connection would be appended to the truncated body
+  if ((close || !request_body_complete_) && conn_data != nullptr) {
     // we shouldn't close the upstream connection unless explicitly asked at some exceptional cases
     conn_data->connection().close(Network::ConnectionCloseType::NoFlush);
     ENVOY_LOG(warn, "meta protocol upstream request: close upstream connection");
   }
 }
 
+void UpstreamRequest::onRequestBody(Buffer::Instance& data, bool end_of_message) {
+  if (end_of_message) {
+    request_body_complete_ = true;
+  }
+  if (conn_data_ != nullptr) {
+    ENVOY_LOG(trace, "proxying {} bytes of the request body", data.length());
+    conn_data_->connection().write(data, false);
+    return;
+  }
+
+  if (conn_pool_handle_ == nullptr) {
+    // the upstream request has failed, nobody is waiting for the rest of the body
+    data.drain(data.length());
+    return;
+  }
+
+  pending_body_.move(data);
+  if (!pending_body_above_limit_ && pending_body_.length() > pending_body_limit_) {
+    ENVOY_LOG(debug, "meta protocol upstream request: {} bytes of the body are waiting for the "
+                     "upstream connection",
+              pending_body_.length());
+    pending_body_above_limit_ = true;
+    parent_.upstreamCallbacks().onAboveWriteBufferHighWatermark();
+  }
+}
+
 void UpstreamRequest::encodeData(Buffer::Instance& data) {
   ASSERT(conn_data_);
   ASSERT(!conn_pool_handle_);
 
   ENVOY_LOG(trace, "proxying {} bytes", data.length());
-  auto codec = parent_.createCodec();
-  codec->encode(*metadata_, *mutation_, data);
+  parent_.encoder().encode(*metadata_, *mutation_, data);
   conn_data_->connection().write(data, false);
 }
 
@@ -104,6 +132,7 @@ void UpstreamRequest::onPoolFailure(ConnectionPool::PoolFailureReason reason, ab
   onUpstreamConnectionReset(reason);
 
   upstream_request_buffer_.drain(upstream_request_buffer_.length());
+  pending_body_.drain(pending_body_.length());
 
   // If it is a connection error, it means that the connection pool returned
   // the error asynchronously and the upper layer needs to be notified to continue decoding.
@@ -146,6 +175,14 @@ void UpstreamRequest::onPoolReady(Tcp::ConnectionPool::ConnectionDataPtr&& conn_
   onRequestStart(continue_decoding);
   encodeData(upstream_request_buffer_);
 
+  if (pending_body_.length() > 0) {
+    conn_data_->connection().write(pending_body_, false);
+  }
+  if (pending_body_above_limit_) {
+    pending_body_above_limit_ = false;
+    parent_.upstreamCallbacks().onBelowWriteBufferLowWatermark();
+  }
+
   if (metadata_->getMessageType() == MessageType::Stream_Init) {
     // For streaming requests, we handle the following server response message in the stream
     ENVOY_LOG(debug, "meta protocol upstream request: the request is a stream init message");
@@ -167,6 +204,13 @@ void UpstreamRequestBase::onRequestStart(bool continue_decoding) {
 
 void UpstreamRequest::onResponseComplete() {
   response_complete_ = true;
+  if (!request_body_complete_) {
+    // The server has answered before the whole body has been sent, e.g. it rejected a large
+    // request, so the connection holds a truncated request and can't go back to the pool.
+    ENVOY_LOG(debug, "meta protocol upstream request: response received before the whole body");
+    releaseUpStreamConnection(true);
+    return;
+  }
   conn_data_.reset();
 }
 
@@ -285,9 +329,18 @@ void UpstreamRequestByHandler::releaseUpStreamConnection(bool) {
 
 void UpstreamRequestByHandler::encodeData(Buffer::Instance& data) {
   ENVOY_LOG(trace, "proxying {} bytes", data.length());
-  auto codec = parent_.createCodec();
-  codec->encode(*metadata_, *mutation_, data);
+  parent_.encoder().encode(*metadata_, *mutation_, data);
+  const bool stream_init = metadata_->getMessageType() == MessageType::Stream_Init;
+  if (stream_init) {
+    // Register the stream before the server can answer the init frame.
+    parent_.setUpstreamHandler(upstream_handler_);
+  }
   upstream_handler_->onData(upstream_request_buffer_, false);
+  if (stream_init) {
+    // The following frames of the stream go through the stream rather than the message.
+    ENVOY_LOG(debug, "meta protocol upstream request: the request is a multiplexed stream init");
+    parent_.resetStream();
+  }
 }
 
 } // namespace Router
@@ -25,6 +25,16 @@ public:
 
   virtual FilterStatus start() PURE;
   virtual void releaseUpStreamConnection(bool close) PURE;
+  /**
+   * Forward a part of the body of a request whose head has been sent by start().
+   */
+  virtual void onRequestBody(Buffer::Instance& data, bool end_of_message) PURE;
+  /**
+   * The body of the request follows its head through onRequestBody. Until the end of the body has
+   * been forwarded, the upstream connection holds a truncated request and is never put back into
+   * the pool.
+   */
+  void expectRequestBody() { request_body_complete_ = false; }
   virtual void onRequestStart(bool continue_decoding);
   virtual void onRequestComplete() { request_complete_ = true; }
   virtual void onResponseStarted() { response_started_ = true; }
@@ -50,6 +60,7 @@ protected:
   bool response_started_ : 1;
   bool response_complete_ : 1;
   bool stream_reset_ : 1;
+  bool request_body_complete_ : 1;
 };
 
 class UpstreamRequest : public Tcp::ConnectionPool::Callbacks, public UpstreamRequestBase {
@@ -69,6 +80,7 @@ public:
   // UpstreamRequestBase
   FilterStatus start() override;
   void releaseUpStreamConnection(const bool close) override;
+  void onRequestBody(Buffer::Instance& data, bool end_of_message) override;
   void onResponseComplete() override;
 
 private:
@@ -76,6 +88,11 @@ private:
 
 private:
   Upstream::TcpPoolData& conn_pool_;
+  // the body of a streamed request received before the upstream connection is ready, the
+  // downstream stops reading once it exceeds the buffer limit of the upstream cluster
+  Buffer::OwnedImpl pending_body_;
+  const uint32_t pending_body_limit_;
+  bool pending_body_above_limit_{false};
 
   Tcp::ConnectionPool::Cancellable* conn_pool_handle_{};
   Tcp::ConnectionPool::ConnectionDataPtr conn_data_;
@@ -98,6 +115,8 @@ public:
   // UpstreamRequestBase
   FilterStatus start() override;
   void releaseUpStreamConnection(const bool close) override;
+  // Body streaming is disabled when multiplexing.
+  void onRequestBody(Buffer::Instance&, bool) override { PANIC("not reached"); }
 
 private:
   void encodeData(Buffer::Instance& data);
@@ -7,10 +7,10 @@ namespace Extensions {
 namespace NetworkFilters {
 namespace MetaProtocolProxy {
 
-DirectResponse::ResponseType HeartbeatResponse::encode(Metadata& metadata, Codec& codec,
+DirectResponse::ResponseType HeartbeatResponse::encode(Metadata& metadata, Encoder& encoder,
                                                        Buffer::Instance& buffer) const {
   metadata.setMessageType(MessageType::Heartbeat);
-  codec.encode(metadata, Mutation{}, buffer);
+  encoder.encode(metadata, Mutation{}, buffer);
   ENVOY_LOG(debug, "buffer length {}", buffer.length());
   return DirectResponse::ResponseType::SuccessReply;
 }
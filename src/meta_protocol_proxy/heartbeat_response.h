@@ -13,7 +13,8 @@ struct HeartbeatResponse : public DirectResponse, Logger::Loggable<Logger::Id::f
   ~HeartbeatResponse() override = default;
 
   using ResponseType = DirectResponse::ResponseType;
-  ResponseType encode(Metadata& metadata, Codec& codec, Buffer::Instance& buffer) const override;
+  ResponseType encode(Metadata& metadata, Encoder& encoder,
+                      Buffer::Instance& buffer) const override;
 };
 
 } // namespace MetaProtocolProxy
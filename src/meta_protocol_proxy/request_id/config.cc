@@ -94,6 +94,130 @@ void UUIDRequestIDExtension::setTraceReason(Metadata& request_metadata, Tracing:
   request_metadata.putString(ReservedHeaders::RequestUUID, uuid);
 }
 
+namespace {
+
+uint64_t hexDigitValue(char digit) { return digit <= '9' ? digit - '0' : digit - 'a' + 10; }
+
+} // namespace
+
+bool BinaryRequestIDExtension::set(Metadata& request_metadata, bool force) {
+  if (!force && (getBinary(request_metadata) != nullptr ||
+                 request_metadata.getString(ReservedHeaders::RequestUUID) != "")) {
+    return false;
+  }
+
+  // Same as a UUID version 4: random bits with the version digit and the variant bits set.
+  BinaryRequestId id{random_.random(), random_.random()};
+  setTraceDigit(id, NO_TRACE);
+  id.low_ = (id.low_ & 0x3fffffffffffffffULL) | 0x8000000000000000ULL;
+  if (force) {
+    request_metadata.removeString(ReservedHeaders::RequestUUID);
+  }
+  request_metadata.put(BinaryRequestIdKey, id);
+  return true;
+}
+
+std::string BinaryRequestIDExtension::get(Metadata& request_metadata) {
+  const BinaryRequestId* id = getBinary(request_metadata);
+  return id != nullptr ? format(*id) : UUIDRequestIDExtension::get(request_metadata);
+}
+
+void BinaryRequestIDExtension::materialize(Metadata& request_metadata) {
+  const BinaryRequestId* id = getBinary(request_metadata);
+  if (id == nullptr) {
+    return;
+  }
+  // The string takes over, so the trace reason set afterwards is written to it.
+  std::string uuid = format(*id);
+  request_metadata.removeString(BinaryRequestIdKey);
+  request_metadata.putString(ReservedHeaders::RequestUUID, std::move(uuid));
+}
+
+absl::optional<uint64_t>
+BinaryRequestIDExtension::toInteger(const Metadata& request_metadata) const {
+  const BinaryRequestId* id = getBinary(request_metadata);
+  if (id == nullptr) {
+    return UUIDRequestIDExtension::toInteger(request_metadata);
+  }
+  // the first 8 digits of the UUID, as UUIDRequestIDExtension parses them
+  return id->high_ >> 32;
+}
+
+Tracing::Reason BinaryRequestIDExtension::getTraceReason(const Metadata& request_metadata) {
+  const BinaryRequestId* id = getBinary(request_metadata);
+  if (id == nullptr) {
+    return UUIDRequestIDExtension::getTraceReason(request_metadata);
+  }
+
+  const uint64_t digit = (id->high_ >> TRACE_DIGIT_SHIFT) & 0xf;
+  if (digit == hexDigitValue(TRACE_FORCED)) {
+    return Tracing::Reason::ServiceForced;
+  }
+  if (digit == hexDigitValue(TRACE_SAMPLED)) {
+    return Tracing::Reason::Sampling;
+  }
+  if (digit == hexDigitValue(TRACE_CLIENT)) {
+    return Tracing::Reason::ClientForced;
+  }
+  return Tracing::Reason::NotTraceable;
+}
+
+void BinaryRequestIDExtension::setTraceReason(Metadata& request_metadata,
+                                              Tracing::Reason reason) {
+  const BinaryRequestId* id = getBinary(request_metadata);
+  if (id == nullptr) {
+    UUIDRequestIDExtension::setTraceReason(request_metadata, reason);
+    return;
+  }
+
+  char digit;
+  switch (reason) {
+  case Tracing::Reason::ServiceForced:
+    digit = TRACE_FORCED;
+    break;
+  case Tracing::Reason::ClientForced:
+    digit = TRACE_CLIENT;
+    break;
+  case Tracing::Reason::Sampling:
+    digit = TRACE_SAMPLED;
+    break;
+  case Tracing::Reason::NotTraceable:
+    digit = NO_TRACE;
+    break;
+  default:
+    return;
+  }
+  BinaryRequestId updated = *id;
+  setTraceDigit(updated, digit);
+  request_metadata.put(BinaryRequestIdKey, updated);
+}
+
+void BinaryRequestIDExtension::setTraceDigit(BinaryRequestId& id, char digit) {
+  id.high_ =
+      (id.high_ & ~(0xfULL << TRACE_DIGIT_SHIFT)) | (hexDigitValue(digit) << TRACE_DIGIT_SHIFT);
+}
+
+const BinaryRequestIDExtension::BinaryRequestId*
+BinaryRequestIDExtension::getBinary(const Metadata& request_metadata) {
+  const auto value = request_metadata.getByKey(BinaryRequestIdKey);
+  return value.has_value() ? std::any_cast<BinaryRequestId>(value.ptr()) : nullptr;
+}
+
+std::string BinaryRequestIDExtension::format(const BinaryRequestId& id) {
+  // xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx, the high bits first
+  static constexpr char Digits[] = "0123456789abcdef";
+  std::string uuid;
+  uuid.reserve(Random::RandomGeneratorImpl::UUID_LENGTH);
+  for (int i = 0; i < 32; i++) {
+    if (i == 8 || i == 12 || i == 16 || i == 20) {
+      uuid.push_back('-');
+    }
+    const uint64_t bits = i < 16 ? id.high_ : id.low_;
+    uuid.push_back(Digits[(bits >> ((15 - i % 16) * 4)) & 0xf]);
+  }
+  return uuid;
+}
+
 } // namespace MetaProtocolProxy
 } // namespace NetworkFilters
 } // namespace Extensions
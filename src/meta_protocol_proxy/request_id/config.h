@@ -29,7 +29,7 @@ public:
   void setTraceReason(Metadata& request_metadata, Envoy::Tracing::Reason status) override;
   bool useRequestIdForTraceSampling() const override { return use_request_id_for_trace_sampling_; }
 
-private:
+protected:
   Envoy::Random::RandomGenerator& random_;
   const bool pack_trace_reason_ = true;
   const bool use_request_id_for_trace_sampling_ = true;
@@ -53,6 +53,44 @@ private:
   static const char NO_TRACE = '4';
 };
 
+/**
+ * BinaryRequestIDExtension keeps the request IDs it generates as 128-bit values rather than UUID
+ * strings. The ID is only formatted as a UUID when it's read as a string, i.e. when it's propagated
+ * to the upstream, traced or logged, and the sampling decision is made on the binary value. The
+ * trace reason is packed in the same digit as UUIDRequestIDExtension does, so the formatted IDs
+ * are interchangeable. The request IDs received from the downstream are handled as UUID strings.
+ */
+class BinaryRequestIDExtension : public UUIDRequestIDExtension {
+public:
+  BinaryRequestIDExtension(Random::RandomGenerator& random) : UUIDRequestIDExtension(random) {}
+
+  // RequestIDExtension
+  bool set(Metadata& request_metadata, bool force) override;
+  std::string get(Metadata& request_metadata) override;
+  void materialize(Metadata& request_metadata) override;
+  absl::optional<uint64_t> toInteger(const Metadata& request_metadata) const override;
+  Envoy::Tracing::Reason getTraceReason(const Metadata& request_metadata) override;
+  void setTraceReason(Metadata& request_metadata, Envoy::Tracing::Reason status) override;
+
+private:
+  struct BinaryRequestId {
+    // the first 16 digits of the UUID, the trace reason is the digit at TRACE_BYTE_POSITION
+    uint64_t high_;
+    uint64_t low_;
+  };
+
+  // The metadata key of the binary request ID. It's not a string, so it isn't propagated or set as
+  // a span tag.
+  inline static const std::string BinaryRequestIdKey = "x-meta-protocol-binary-request-id";
+
+  // the shift of the trace reason digit in BinaryRequestId::high_
+  static const int TRACE_DIGIT_SHIFT = 12;
+
+  static void setTraceDigit(BinaryRequestId& id, char digit);
+  static const BinaryRequestId* getBinary(const Metadata& request_metadata);
+  static std::string format(const BinaryRequestId& id);
+};
+
 } // namespace MetaProtocolProxy
 } // namespace NetworkFilters
 } // namespace Extensions
@@ -52,6 +52,14 @@ public:
    */
   virtual std::string get(Metadata& request_metadata) PURE;
 
+  /**
+   * Make sure the request ID is in the request metadata as the x-request-id string, so it can be
+   * read from the metadata, e.g. by the tracer or the access loggers. It's only needed by the
+   * extensions which keep the request ID in another form until it's used.
+   * @param request_metadata supplies the incoming request metadata.
+   */
+  virtual void materialize(Metadata&) {}
+
   /**
    * Preserve request ID in response headers if any is set in the request metadata.
    * @param response_headers supplies the downstream response headers for setting the request ID.
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <string>
 
@@ -14,6 +16,49 @@ namespace NetworkFilters {
 namespace MetaProtocolProxy {
 namespace Route {
 
+/**
+ * The in-flight mirrored requests of a mirror policy and the bytes they hold. It's shared by all
+ * the workers, and is kept alive by the mirrored requests after the route config is updated.
+ */
+class MirrorResourceLimit {
+public:
+  MirrorResourceLimit(uint64_t max_requests, uint64_t max_bytes)
+      : max_requests_(max_requests), max_bytes_(max_bytes) {}
+
+  /**
+   * Reserve the resources of a mirrored request.
+   * @return false if the request would exceed the limits, nothing is reserved then.
+   */
+  bool tryAcquire(uint64_t bytes) {
+    if (requests_.fetch_add(1, std::memory_order_relaxed) >= max_requests_) {
+      requests_.fetch_sub(1, std::memory_order_relaxed);
+      return false;
+    }
+    if (bytes_.fetch_add(bytes, std::memory_order_relaxed) + bytes > max_bytes_) {
+      bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+      requests_.fetch_sub(1, std::memory_order_relaxed);
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * Release the resources reserved by tryAcquire.
+   */
+  void release(uint64_t bytes) {
+    bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+    requests_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+private:
+  const uint64_t max_requests_;
+  const uint64_t max_bytes_;
+  std::atomic<uint64_t> requests_{0};
+  std::atomic<uint64_t> bytes_{0};
+};
+
+using MirrorResourceLimitSharedPtr = std::shared_ptr<MirrorResourceLimit>;
+
 /**
  * RequestMirrorPolicy is an individual mirroring rule for a route entry.
  */
@@ -31,6 +76,16 @@ public:
    * @return bool whether this policy is currently enabled.
    */
   virtual bool shouldShadow(Runtime::Loader& runtime, uint64_t stable_random) const PURE;
+
+  /**
+   * @return the limits of the in-flight mirrored requests of this policy.
+   */
+  virtual const MirrorResourceLimitSharedPtr& resourceLimit() const PURE;
+
+  /**
+   * @return the time a mirrored request may take before it's abandoned.
+   */
+  virtual std::chrono::milliseconds timeout() const PURE;
 };
 
 /**
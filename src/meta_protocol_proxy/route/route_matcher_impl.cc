@@ -12,7 +12,11 @@ namespace NetworkFilters {
 namespace MetaProtocolProxy {
 namespace Route {
 
-RequestMirrorPolicyImpl::RequestMirrorPolicyImpl(const RequestMirrorPolicy& config) {
+RequestMirrorPolicyImpl::RequestMirrorPolicyImpl(const RequestMirrorPolicy& config)
+    : resource_limit_(std::make_shared<MirrorResourceLimit>(
+          PROTOBUF_GET_WRAPPED_OR_DEFAULT(config, max_pending_requests, 1024),
+          PROTOBUF_GET_WRAPPED_OR_DEFAULT(config, max_pending_bytes, 16 * 1024 * 1024))),
+      timeout_(PROTOBUF_GET_MS_OR_DEFAULT(config, timeout, 1000)) {
   cluster_name_ = config.cluster();
   if (config.has_runtime_fraction()) {
     runtime_key_ = config.runtime_fraction().runtime_key();
@@ -35,11 +35,15 @@ public:
   const std::string& clusterName() const override { return cluster_name_; }
 
   bool shouldShadow(Runtime::Loader& runtime, uint64_t stable_random) const override;
+  const MirrorResourceLimitSharedPtr& resourceLimit() const override { return resource_limit_; }
+  std::chrono::milliseconds timeout() const override { return timeout_; }
 
 private:
   std::string cluster_name_;
   std::string runtime_key_;
   envoy::type::v3::FractionalPercent default_value_;
+  MirrorResourceLimitSharedPtr resource_limit_;
+  std::chrono::milliseconds timeout_;
 };
 
 class RouteEntryImplBase : public RouteEntry,
@@ -14,8 +14,11 @@ namespace MetaProtocolProxy {
  * All meta protocol  filter stats. @see stats_macros.h
  */
 #define ALL_META_PROTOCOL_PROXY_STATS(COUNTER, GAUGE, HISTOGRAM)                                   \
+  COUNTER(binary_access_log_dropped)                                                               \
   COUNTER(cx_destroy_local_with_active_rq)                                                         \
   COUNTER(cx_destroy_remote_with_active_rq)                                                        \
+  COUNTER(downstream_flow_control_paused_reading_total)                                            \
+  COUNTER(downstream_flow_control_resumed_reading_total)                                           \
   COUNTER(local_response_business_exception)                                                       \
   COUNTER(local_response_error)                                                                    \
   COUNTER(local_response_success)                                                                  \
@@ -23,7 +26,9 @@ namespace MetaProtocolProxy {
   COUNTER(request_decoding_error)                                                                  \
   COUNTER(request_decoding_success)                                                                \
   COUNTER(request_event)                                                                           \
+  COUNTER(request_buffer_overflow)                                                                 \
   COUNTER(request_oneway)                                                                          \
+  COUNTER(request_overload_rejected)                                                               \
   COUNTER(request_twoway)                                                                          \
   COUNTER(request_stream)                                                                          \
   COUNTER(response)                                                                                \
@@ -32,9 +37,15 @@ namespace MetaProtocolProxy {
   COUNTER(response_decoding_success)                                                               \
   COUNTER(response_error)                                                                          \
   COUNTER(response_error_caused_connection_close)                                                  \
+  COUNTER(response_server_busy)                                                                    \
   COUNTER(response_success)                                                                        \
+  COUNTER(stream_idle_timeout)                                                                     \
+  COUNTER(stream_overflow)                                                                         \
+  COUNTER(upstream_cx_overload_shed)                                                               \
   GAUGE(request_active, Accumulate)                                                                \
+  GAUGE(stream_active, Accumulate)                                                                 \
   HISTOGRAM(request_time_ms, Milliseconds)                                                         \
+  HISTOGRAM(downstream_flow_control_paused_time_ms, Milliseconds)                                  \
   COUNTER(idle_timeout)                                                                            
 
 /**
@@ -10,14 +10,27 @@ namespace NetworkFilters {
 namespace MetaProtocolProxy {
 
 Stream::Stream(uint64_t stream_id, Network::Connection& downstream_conn,
-               ConnectionManager& connection_manager, Codec& codec)
+               ConnectionManager& connection_manager, ProtocolDecoder& protocol_decoder)
     : stream_id_(stream_id), downstream_conn_(downstream_conn),
-      connection_manager_(connection_manager), codec_(codec){};
+      connection_manager_(connection_manager), protocol_decoder_(protocol_decoder) {
+  // A scaled timer, so the reduce_timeouts overload action can shorten it.
+  if (connection_manager_.config().streamIdleTimeout()) {
+    idle_timer_ = downstream_conn_.dispatcher().createScaledTimer(
+        Event::ScaledTimerType::HttpDownstreamIdleStreamTimeout, [this]() { onIdleTimeout(); });
+    resetIdleTimer();
+  }
+}
 
 void Stream::send2upstream(Buffer::Instance& data) {
+  resetIdleTimer();
+  onClientFrame(data);
   if (upstream_conn_data_ != nullptr) {
     ENVOY_LOG(debug, "meta protocol: send downstream request to stream {}", stream_id_);
     upstream_conn_data_->connection().write(data, false);
+  } else if (upstream_handler_ != nullptr && upstream_handler_->isPoolReady()) {
+    ENVOY_LOG(debug, "meta protocol: send downstream request to multiplexed stream {}",
+              stream_id_);
+    upstream_handler_->onData(data, false);
   } else {
     ENVOY_LOG(error, "meta protocol: no upstream connection for stream {}, can't send message",
               stream_id_);
@@ -26,14 +39,55 @@ void Stream::send2upstream(Buffer::Instance& data) {
 
 void Stream::send2downstream(Buffer::Instance& data, bool end_stream) {
   ENVOY_LOG(debug, "meta protocol: send upstream response to stream {}", stream_id_);
+  resetIdleTimer();
   while (data.length() > 0) {
+    // Data frames are forwarded without being decoded, only the frames which change the state of
+    // the stream go through the decoder.
+    const uint64_t frame_length = protocol_decoder_.frameLength(data);
+    if (frame_length > 0) {
+      if (data.length() < frame_length) {
+        ENVOY_LOG(debug, "meta protocol: response wait for data {}", stream_id_);
+        return;
+      }
+      onServerFrame(data);
+      if (protocol_decoder_.isStreamDataFrame(data)) {
+        // moving the slices of a frame doesn't allocate unless the frame spans many of them
+        Buffer::OwnedImpl frame;
+        frame.move(data, frame_length);
+        downstream_conn_.write(frame, end_stream);
+        if (end_stream) {
+          clear();
+          return;
+        }
+        continue;
+      }
+    }
+
     auto metadata = std::make_unique<MetadataImpl>();
     metadata->setMessageType(MessageType::Response);
-    DecodeStatus status = codec_.decode(data, *metadata);
+    DecodeStatus status = protocol_decoder_.decode(data, *metadata);
     if (status == DecodeStatus::WaitForData) {
       ENVOY_LOG(debug, "meta protocol: response wait for data {}", stream_id_);
       return;
     }
+    if (status == DecodeStatus::Error) {
+      ENVOY_LOG(error, "meta protocol: invalid response of stream {}: {}", stream_id_,
+                protocol_decoder_.errorDetail());
+      if (upstream_conn_data_ != nullptr) {
+        // don't put the connection back to the pool with the rest of the invalid data in it
+        upstream_conn_data_->connection().close(Network::ConnectionCloseType::NoFlush);
+      } else if (upstream_handler_ != nullptr) {
+        // The shared connection is out of sync with the protocol, so the other streams and
+        // requests on it can't be served either. The handler resets them when it's closed, and it
+        // must outlive the reset of this stream, which releases it.
+        UpstreamHandlerSharedPtr upstream_handler = upstream_handler_;
+        clear();
+        upstream_handler->close();
+        return;
+      }
+      clear();
+      return;
+    }
     downstream_conn_.write(metadata->originMessage(), end_stream);
     if (metadata->getMessageType() == MessageType::Stream_Close_One_Way) {
       ENVOY_LOG(debug, "meta protocol: close server side stream {}", stream_id_);
@@ -46,17 +100,123 @@ void Stream::send2downstream(Buffer::Instance& data, bool end_stream) {
     }
     // According to tRPC protocol, a server close frame means the stream is closed.
     if (end_stream || (server_closed_)) {
+      // the stream is deleted by clear
       clear();
+      return;
     }
   }
 }
 
+void Stream::onClientFrame(const Buffer::Instance& frame) {
+  const StreamFrameCredit credit = protocol_decoder_.streamFrameCredit(frame);
+  if (grantCredit(client_window_, credit)) {
+    ENVOY_LOG(debug, "meta protocol: stream {} resume reading from the server", stream_id_);
+    readDisableUpstream(false);
+  }
+  if (consumeCredit(server_window_, credit.consumed)) {
+    ENVOY_LOG(debug, "meta protocol: stream {} exhausted the window of the server", stream_id_);
+    connection_manager_.onStreamWindowExhausted();
+  }
+}
+
+void Stream::onServerFrame(const Buffer::Instance& frame) {
+  const StreamFrameCredit credit = protocol_decoder_.streamFrameCredit(frame);
+  if (grantCredit(server_window_, credit)) {
+    ENVOY_LOG(debug, "meta protocol: stream {} resume reading from the client", stream_id_);
+    connection_manager_.onStreamWindowAvailable();
+  }
+  if (consumeCredit(client_window_, credit.consumed)) {
+    ENVOY_LOG(debug, "meta protocol: stream {} exhausted the window of the client", stream_id_);
+    readDisableUpstream(true);
+  }
+}
+
+bool Stream::grantCredit(FlowControlWindow& window, const StreamFrameCredit& credit) {
+  if (credit.initial_window > 0) {
+    window.enabled = true;
+    window.available = credit.initial_window;
+  } else if (window.enabled) {
+    window.available += credit.window_increment;
+  }
+  if (window.exhausted && window.available > 0) {
+    window.exhausted = false;
+    return true;
+  }
+  return false;
+}
+
+bool Stream::consumeCredit(FlowControlWindow& window, uint32_t consumed) {
+  if (!window.enabled || consumed == 0) {
+    return false;
+  }
+  window.available -= consumed;
+  if (!window.exhausted && window.available <= 0) {
+    window.exhausted = true;
+    return true;
+  }
+  return false;
+}
+
+void Stream::readDisableUpstream(bool disable) {
+  // A multiplexed stream doesn't pause the connection it shares with other streams and requests.
+  if (disable == upstream_read_disabled_ || upstream_conn_data_ == nullptr ||
+      upstream_conn_data_->connection().state() != Network::Connection::State::Open) {
+    return;
+  }
+  upstream_read_disabled_ = disable;
+  upstream_conn_data_->connection().readDisable(disable);
+}
+
+void Stream::reset() {
+  if (closed_) {
+    return;
+  }
+  // The server may still be sending on the stream, so its connection can't go back to the pool.
+  Tcp::ConnectionPool::ConnectionDataPtr upstream_conn_data = std::move(upstream_conn_data_);
+  clear();
+  if (upstream_conn_data != nullptr) {
+    upstream_conn_data->connection().close(Network::ConnectionCloseType::NoFlush);
+  }
+}
+
+void Stream::onIdleTimeout() {
+  ENVOY_LOG(debug, "meta protocol: stream {} timed out", stream_id_);
+  connection_manager_.stats().stream_idle_timeout_.inc();
+  reset();
+}
+
+void Stream::resetIdleTimer() {
+  if (idle_timer_ != nullptr) {
+    idle_timer_->enableTimer(connection_manager_.config().streamIdleTimeout().value());
+  }
+}
+
 void Stream::clear() {
+  if (closed_) {
+    return;
+  }
+  closed_ = true;
   ENVOY_LOG(debug, "meta protocol: close the entire stream {}", stream_id_);
-  upstream_conn_data_->connection().removeConnectionCallbacks(*this);
-  // In theory, we don't have to reset the unique prt, since it will be deleted automatically after
-  // stream being deleted from the connection manager. Just do it for safety.
-  upstream_conn_data_.reset();
+  if (idle_timer_ != nullptr) {
+    idle_timer_->disableTimer();
+  }
+  // the connection goes back to the pool, and the other streams of the downstream connection must
+  // not stay paused for this one
+  readDisableUpstream(false);
+  if (server_window_.exhausted) {
+    server_window_.exhausted = false;
+    connection_manager_.onStreamWindowAvailable();
+  }
+  if (upstream_handler_ != nullptr) {
+    upstream_handler_->removeStream(stream_id_);
+    upstream_handler_.reset();
+  }
+  if (upstream_conn_data_ != nullptr) {
+    upstream_conn_data_->connection().removeConnectionCallbacks(*this);
+    // Release the connection now rather than when the stream is deleted, so the stream doesn't
+    // receive any more data.
+    upstream_conn_data_.reset();
+  }
   connection_manager_.closeStream(stream_id_);
 }
 
@@ -65,8 +225,25 @@ void Stream::setUpstreamConn(Tcp::ConnectionPool::ConnectionDataPtr upstream_con
   upstream_conn_data_->addUpstreamCallbacks(*this);
 }
 
-void Stream::onEvent(Network::ConnectionEvent) {
-  // todo clean stream resource when connection has been closed
+void Stream::setUpstreamHandler(UpstreamHandlerSharedPtr upstream_handler) {
+  upstream_handler_ = std::move(upstream_handler);
+  upstream_handler_->addStream(stream_id_, *this);
+}
+
+void Stream::onUpstreamReset() {
+  ENVOY_LOG(debug, "meta protocol: the upstream connection of stream {} is closed", stream_id_);
+  clear();
+}
+
+void Stream::onEvent(Network::ConnectionEvent event) {
+  if (event != Network::ConnectionEvent::RemoteClose &&
+      event != Network::ConnectionEvent::LocalClose) {
+    return;
+  }
+  ENVOY_LOG(debug, "meta protocol: the upstream connection of stream {} is closed", stream_id_);
+  // the server is gone, the stream can't make progress anymore
+  upstream_read_disabled_ = false;
+  clear();
 }
 
 } // namespace  MetaProtocolProxy
@@ -1,9 +1,12 @@
 #pragma once
 
+#include "envoy/event/deferred_deletable.h"
+#include "envoy/event/timer.h"
 #include "envoy/network/connection.h"
 #include "source/common/buffer/buffer_impl.h"
 #include "source/common/common/logger.h"
 #include "src/meta_protocol_proxy/route/route.h"
+#include "src/meta_protocol_proxy/upstream_handler.h"
 
 namespace Envoy {
 namespace Extensions {
@@ -14,12 +17,13 @@ class ConnectionManager;
 
 // Stream tracks a streaming RPC, multiple requests and responses can be sent inside a stream.
 class Stream : Tcp::ConnectionPool::UpstreamCallbacks,
-               Event::DeferredDeletable,
+               public UpstreamStreamCallbacks,
+               public Event::DeferredDeletable,
                Logger::Loggable<Logger::Id::filter> {
 public:
   Stream(uint64_t stream_id, Network::Connection& downstream_conn,
-         ConnectionManager& connection_manager, Codec& codec);
-  ~Stream() = default;
+         ConnectionManager& connection_manager, ProtocolDecoder& protocol_decoder);
+  ~Stream() override = default;
 
   // UpstreamCallbacks
   void onUpstreamData(Buffer::Instance& data, bool end_stream) override {
@@ -29,21 +33,63 @@ public:
   void onAboveWriteBufferHighWatermark() override {}
   void onBelowWriteBufferLowWatermark() override {}
 
+  // UpstreamStreamCallbacks
+  void onUpstreamFrame(Buffer::Instance& frame) override { send2downstream(frame, false); }
+  void onUpstreamReset() override;
+
   void send2upstream(Buffer::Instance& data);
   void send2downstream(Buffer::Instance& data, bool end_stream);
   void setUpstreamConn(Tcp::ConnectionPool::ConnectionDataPtr upstream_conn_data);
+  // Multiplex the stream on the upstream connection of the handler, which is shared with other
+  // streams and requests of the downstream connection.
+  void setUpstreamHandler(UpstreamHandlerSharedPtr upstream_handler);
   void closeClientStream() { client_closed_ = true; }
   void closeServerStream() { server_closed_ = true; }
+  // Account the credit carried by a whole frame received from the client.
+  void onClientFrame(const Buffer::Instance& frame);
+  // Close the stream and its upstream connection, e.g. when the downstream connection is closed.
+  void reset();
 
 private:
+  // The credit of one direction of the stream. It's advertised by the receiver when the stream is
+  // opened, replenished by the receiver's feedback and consumed by the sender's data. Reading from
+  // the sender is paused while it's exhausted, so the proxy doesn't buffer the data a slow receiver
+  // hasn't asked for.
+  struct FlowControlWindow {
+    // the receiver has advertised a window
+    bool enabled{false};
+    // reading from the sender is paused
+    bool exhausted{false};
+    int64_t available{0};
+  };
+
+  void onServerFrame(const Buffer::Instance& frame);
+  // @return true if the window was exhausted and has been replenished.
+  static bool grantCredit(FlowControlWindow& window, const StreamFrameCredit& credit);
+  // @return true if the window has just been exhausted.
+  static bool consumeCredit(FlowControlWindow& window, uint32_t consumed);
+  void readDisableUpstream(bool disable);
+  void onIdleTimeout();
+  void resetIdleTimer();
+  // Remove the stream from the connection manager, the stream is deleted at the end of the current
+  // event loop iteration.
   void clear();
   uint64_t stream_id_;
   Tcp::ConnectionPool::ConnectionDataPtr upstream_conn_data_;
+  // set instead of upstream_conn_data_ when the stream is multiplexed
+  UpstreamHandlerSharedPtr upstream_handler_;
   Network::Connection& downstream_conn_;
   ConnectionManager& connection_manager_;
-  Codec& codec_;
+  ProtocolDecoder& protocol_decoder_;
   bool client_closed_{false};
   bool server_closed_{false};
+  bool upstream_read_disabled_{false};
+  bool closed_{false};
+  Event::TimerPtr idle_timer_;
+  // advertised by the client, consumed by the data of the server
+  FlowControlWindow client_window_;
+  // advertised by the server, consumed by the data of the client
+  FlowControlWindow server_window_;
 };
 
 using StreamPtr = std::unique_ptr<Stream>;
@@ -0,0 +1,71 @@
+#include "src/meta_protocol_proxy/tracing/metadata_tags.h"
+
+#include "source/common/common/macros.h"
+
+#include "absl/strings/str_cat.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Tracing {
+
+namespace {
+constexpr absl::string_view RequestTagPrefix = "request metadata: ";
+constexpr absl::string_view ResponseTagPrefix = "response metadata: ";
+} // namespace
+
+MetadataTags::MetadataTags(bool allow_all, const std::vector<std::string>& allowed_keys,
+                           const std::vector<std::string>& denied_keys)
+    : allow_all_(allow_all), denied_keys_(denied_keys.begin(), denied_keys.end()) {
+  if (allow_all_) {
+    return;
+  }
+  for (const std::string& key : allowed_keys.empty() ? defaultAllowedKeys() : allowed_keys) {
+    if (denied_keys_.contains(key)) {
+      continue;
+    }
+    allowed_tags_.push_back(
+        {key, absl::StrCat(RequestTagPrefix, key), absl::StrCat(ResponseTagPrefix, key)});
+  }
+}
+
+const std::vector<std::string>& MetadataTags::defaultAllowedKeys() {
+  CONSTRUCT_ON_FIRST_USE(std::vector<std::string>, {"interface", "method", "func", "caller",
+                                                    "callee", "cmd"});
+}
+
+void MetadataTags::setRequestTags(Envoy::Tracing::Span& span, const Metadata& metadata) const {
+  setTags(span, metadata, true);
+}
+
+void MetadataTags::setResponseTags(Envoy::Tracing::Span& span, const Metadata& metadata) const {
+  setTags(span, metadata, false);
+}
+
+void MetadataTags::setTags(Envoy::Tracing::Span& span, const Metadata& metadata,
+                           bool request) const {
+  if (!allow_all_) {
+    for (const Tag& tag : allowed_tags_) {
+      const auto value = metadata.get(tag.key_);
+      if (value.has_value()) {
+        span.setTag(request ? tag.request_tag_ : tag.response_tag_, value.value());
+      }
+    }
+    return;
+  }
+
+  const absl::string_view prefix = request ? RequestTagPrefix : ResponseTagPrefix;
+  metadata.forEach([&](absl::string_view key, absl::string_view value) {
+    if (!denied_keys_.contains(key)) {
+      span.setTag(absl::StrCat(prefix, key), value);
+    }
+    return true;
+  });
+}
+
+} // namespace Tracing
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "envoy/tracing/trace_driver.h"
+
+#include "src/meta_protocol_proxy/codec/codec.h"
+
+#include "absl/container/flat_hash_set.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Tracing {
+
+/**
+ * MetadataTags sets the metadata of the requests and responses as span tags, named
+ * "request metadata: <key>" and "response metadata: <key>".
+ *
+ * Only the allowed keys are looked up, and their tag names are built once when the config is
+ * loaded. In the allow all mode, which is meant for debugging, every metadata which isn't denied is
+ * set, which builds a tag name per metadata.
+ */
+class MetadataTags {
+public:
+  /**
+   * @param allow_all set all the keys which aren't denied as tags, allowed_keys is ignored then.
+   * @param allowed_keys the keys to set as tags, the default ones if it's empty.
+   * @param denied_keys the keys never set as tags.
+   */
+  MetadataTags(bool allow_all, const std::vector<std::string>& allowed_keys,
+               const std::vector<std::string>& denied_keys);
+
+  /**
+   * @return the keys allowed when the config doesn't specify them. They identify the call in the
+   * application protocols of this repo.
+   */
+  static const std::vector<std::string>& defaultAllowedKeys();
+
+  void setRequestTags(Envoy::Tracing::Span& span, const Metadata& metadata) const;
+  void setResponseTags(Envoy::Tracing::Span& span, const Metadata& metadata) const;
+
+private:
+  struct Tag {
+    std::string key_;
+    std::string request_tag_;
+    std::string response_tag_;
+  };
+
+  void setTags(Envoy::Tracing::Span& span, const Metadata& metadata, bool request) const;
+
+  std::vector<Tag> allowed_tags_;
+  const bool allow_all_;
+  absl::flat_hash_set<std::string> denied_keys_;
+};
+
+} // namespace Tracing
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -7,6 +7,7 @@
 #include "envoy/tracing/trace_reason.h"
 
 #include "src/meta_protocol_proxy/codec/codec.h"
+#include "src/meta_protocol_proxy/tracing/metadata_tags.h"
 
 namespace Envoy {
 namespace Extensions {
@@ -14,6 +15,24 @@ namespace NetworkFilters {
 namespace MetaProtocolProxy {
 namespace Tracing {
 
+/**
+ * Configuration for tracing which is set on the MetaProtocol Proxy level.
+ * Tracing can be enabled/disabled on a per MetaProtocol Proxy basis.
+ * Here we specify some specific for MetaProtocol Proxy settings.
+ */
+class TracingConfig : public Envoy::Tracing::Config {
+public:
+  virtual ~TracingConfig() = default;
+  virtual envoy::type::v3::FractionalPercent& clientSampling() PURE;
+  virtual envoy::type::v3::FractionalPercent& randomSampling() PURE;
+  virtual envoy::type::v3::FractionalPercent& overallSampling() PURE;
+  /**
+   * @return MetadataTags& which metadata of the requests and responses are set as span tags.
+   */
+  virtual const MetadataTags& metadataTags() const PURE;
+};
+using TracingConfigPtr = std::unique_ptr<TracingConfig>;
+
 /**
  * MetaProtocolTracer is responsible for handling traces and delegate actions to the
  * corresponding drivers.
@@ -22,8 +41,8 @@ class MetaProtocolTracer {
 public:
   virtual ~MetaProtocolTracer() = default;
 
-  virtual Envoy::Tracing::SpanPtr startSpan(const Envoy::Tracing::Config& config,
-                                            Metadata& metadata, Mutation& mutation,
+  virtual Envoy::Tracing::SpanPtr startSpan(const TracingConfig& config, Metadata& metadata,
+                                            Mutation& mutation,
                                             const StreamInfo::StreamInfo& stream_info,
                                             const std::string& cluster_name,
                                             const Envoy::Tracing::Decision tracing_decision) PURE;
@@ -31,20 +50,6 @@ public:
 
 using MetaProtocolTracerSharedPtr = std::shared_ptr<MetaProtocolTracer>;
 
-/**
- * Configuration for tracing which is set on the MetaProtocol Proxy level.
- * Tracing can be enabled/disabled on a per MetaProtocol Proxy basis.
- * Here we specify some specific for MetaProtocol Proxy settings.
- */
-class TracingConfig : public Envoy::Tracing::Config {
-public:
-  virtual ~TracingConfig() = default;
-  virtual envoy::type::v3::FractionalPercent& clientSampling() PURE;
-  virtual envoy::type::v3::FractionalPercent& randomSampling() PURE;
-  virtual envoy::type::v3::FractionalPercent& overallSampling() PURE;
-};
-using TracingConfigPtr = std::unique_ptr<TracingConfig>;
-
 } // namespace Tracing
 } // namespace MetaProtocolProxy
 } // namespace NetworkFilters
@@ -113,16 +113,12 @@ static void annotateVerbose(Envoy::Tracing::Span& span, const StreamInfo::Stream
 
 void MetaProtocolTracerUtility::finalizeSpanWithResponse(
     Envoy::Tracing::Span& span, const Metadata& response_metadata,
-    const StreamInfo::StreamInfo& stream_info, const Envoy::Tracing::Config& tracing_config) {
+    const StreamInfo::StreamInfo& stream_info, const TracingConfig& tracing_config) {
   setCommonTags(span, stream_info, tracing_config);
   span.setTag(Tracing::Tags::get().ResponseSize,
               std::to_string(response_metadata.getHeaderSize() + response_metadata.getBodySize()));
-  response_metadata.forEach([&span](absl::string_view key, absl::string_view val) {
-    std::string tag_key = "response metadata: " + std::string(key.data(), key.size());
-    span.setTag(tag_key, val);
-    return true;
-  });
-  if (response_metadata.getResponseStatus() == ResponseStatus::Error) {
+  tracing_config.metadataTags().setResponseTags(span, response_metadata);
+  if (response_metadata.getResponseStatus() != ResponseStatus::Ok) {
     span.setTag(Tracing::Tags::get().Error, Tracing::Tags::get().True);
   }
   span.finishSpan();
@@ -134,7 +130,7 @@ void MetaProtocolTracerUtility::finalizeSpanWithoutResponse(
 
   setCommonTags(span, stream_info, tracing_config);
 
-  if (response_status == ResponseStatus::Error) {
+  if (response_status != ResponseStatus::Ok) {
     span.setTag(Tracing::Tags::get().Error, Tracing::Tags::get().True);
   }
   span.finishSpan();
@@ -170,7 +166,7 @@ MetaProtocolTracerImpl::MetaProtocolTracerImpl(Envoy::Tracing::DriverSharedPtr d
     : driver_(std::move(driver)), local_info_(local_info) {}
 
 Envoy::Tracing::SpanPtr
-MetaProtocolTracerImpl::startSpan(const Envoy::Tracing::Config& config, Metadata& request_metadata,
+MetaProtocolTracerImpl::startSpan(const TracingConfig& config, Metadata& request_metadata,
                                   Mutation& mutation, const StreamInfo::StreamInfo& stream_info,
                                   const std::string& cluster_name,
                                   const Envoy::Tracing::Decision tracing_decision) {
@@ -214,11 +210,7 @@ MetaProtocolTracerImpl::startSpan(const Envoy::Tracing::Config& config, Metadata
                         std::to_string(request_metadata.getRequestId()));
     active_span->setTag(Tracing::Tags::get().NodeId, local_info_.nodeName());
     active_span->setTag(Tracing::Tags::get().Zone, local_info_.zoneName());
-    request_metadata.forEach([&active_span](absl::string_view key, absl::string_view val) {
-      std::string tag_key = "request metadata: " + std::string(key.data(), key.size());
-      active_span->setTag(tag_key, val);
-      return true;
-    });
+    config.metadataTags().setRequestTags(*active_span, request_metadata);
   }
 
   return active_span;
@@ -47,7 +47,7 @@ public:
   static void finalizeSpanWithResponse(Envoy::Tracing::Span& span,
                                        const Metadata& response_metadata,
                                        const StreamInfo::StreamInfo& stream_info,
-                                       const Envoy::Tracing::Config& tracing_config);
+                                       const TracingConfig& tracing_config);
 
   /**
    * Adds information obtained from the upstream request headers as tags to the active span.
@@ -92,7 +92,7 @@ using EgressConfig = ConstSingleton<EgressConfigImpl>;
 class NullTracer : public MetaProtocolTracer {
 public:
   // Tracing::MetaProtocolTracer
-  Envoy::Tracing::SpanPtr startSpan(const Envoy::Tracing::Config&, Metadata&, Mutation&,
+  Envoy::Tracing::SpanPtr startSpan(const TracingConfig&, Metadata&, Mutation&,
                                     const StreamInfo::StreamInfo&, const std::string&,
                                     const Envoy::Tracing::Decision) override {
     return Envoy::Tracing::SpanPtr{new NullSpan()};
@@ -105,7 +105,7 @@ public:
                          const LocalInfo::LocalInfo& local_info);
 
   // Tracing::MetaProtocolTracer
-  Envoy::Tracing::SpanPtr startSpan(const Envoy::Tracing::Config& config, Metadata& metadata,
+  Envoy::Tracing::SpanPtr startSpan(const TracingConfig& config, Metadata& metadata,
                                     Mutation& mutation, const StreamInfo::StreamInfo& stream_info,
                                     const std::string& cluster_name,
                                     const Envoy::Tracing::Decision tracing_decision) override;
@@ -128,10 +128,10 @@ public:
                     envoy::type::v3::FractionalPercent client_sampling,
                     envoy::type::v3::FractionalPercent random_sampling,
                     envoy::type::v3::FractionalPercent overall_sampling, bool verbose,
-                    int32_t max_tag_length)
+                    int32_t max_tag_length, MetadataTags metadata_tags)
       : operation_name_(operation_name), client_sampling_(client_sampling),
         random_sampling_(random_sampling), overall_sampling_(overall_sampling), verbose_(verbose),
-        max_tag_length_(max_tag_length) {
+        max_tag_length_(max_tag_length), metadata_tags_(std::move(metadata_tags)) {
     custom_tags_ = std::make_unique<Envoy::Tracing::CustomTagMap>();
   }
   Envoy::Tracing::OperationName operationName() const override { return operation_name_; };
@@ -142,6 +142,7 @@ public:
   envoy::type::v3::FractionalPercent& clientSampling() override { return client_sampling_; };
   envoy::type::v3::FractionalPercent& randomSampling() override { return random_sampling_; };
   envoy::type::v3::FractionalPercent& overallSampling() override { return overall_sampling_; };
+  const MetadataTags& metadataTags() const override { return metadata_tags_; }
 
 private:
   Envoy::Tracing::OperationName operation_name_;
@@ -151,6 +152,7 @@ private:
   envoy::type::v3::FractionalPercent overall_sampling_;
   bool verbose_;
   uint32_t max_tag_length_;
+  const MetadataTags metadata_tags_;
 };
 using TracingConfigSharedPtr = std::shared_ptr<TracingConfig>;
 } // namespace Tracing
@@ -37,6 +37,20 @@ std::shared_ptr<UpstreamHandler> UpstreamHandlerManager::get(const std::string&
 
 void UpstreamHandlerManager::clear() { upstream_handlers_.clear(); }
 
+uint32_t UpstreamHandlerManager::closeIdle() {
+  // The handlers remove themselves from the map when they are closed, so collect them first.
+  std::vector<std::shared_ptr<UpstreamHandler>> idle_handlers;
+  for (const auto& [key, handler] : upstream_handlers_) {
+    if (handler->idle()) {
+      idle_handlers.push_back(handler);
+    }
+  }
+  for (auto& handler : idle_handlers) {
+    handler->close();
+  }
+  return idle_handlers.size();
+}
+
 } // namespace  MetaProtocolProxy
 } // namespace NetworkFilters
 } // namespace Extensions
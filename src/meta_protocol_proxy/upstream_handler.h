@@ -2,6 +2,7 @@
 
 #include <memory>
 #include <map>
+#include <vector>
 
 #include "envoy/tcp/conn_pool.h"
 #include "envoy/upstream/thread_local_cluster.h"
@@ -27,6 +28,19 @@ public:
 };
 
 using ResponseCallback = std::function<void(MetadataSharedPtr response_metadata)>;
+
+// The callbacks of a stream multiplexed on an upstream connection.
+class UpstreamStreamCallbacks {
+public:
+  virtual ~UpstreamStreamCallbacks() = default;
+
+  // A whole frame of the stream has been received from the server.
+  virtual void onUpstreamFrame(Buffer::Instance& frame) PURE;
+
+  // The upstream connection has been closed, the stream can't make progress anymore.
+  virtual void onUpstreamReset() PURE;
+};
+
 class UpstreamHandler {
 public:
   virtual ~UpstreamHandler() = default;
@@ -35,7 +49,26 @@ public:
 
   virtual void onData(Buffer::Instance& data, bool end_stream) PURE;
 
-  virtual void addResponseCallback(uint64_t request_id, ResponseCallback callback) PURE;
+  /**
+   * Register the callback of the response of a request.
+   * @return false if a request with the same id is already waiting for its response, the callback
+   * isn't registered then.
+   */
+  virtual bool addResponseCallback(uint64_t request_id, ResponseCallback callback) PURE;
+
+  /**
+   * Forget the callback of a request which no longer waits for its response, a late response is
+   * discarded.
+   */
+  virtual void removeResponseCallback(uint64_t request_id) PURE;
+
+  /**
+   * Register a stream multiplexed on the upstream connection, the frames of the stream received
+   * from the server are handed to the callbacks until the stream is removed.
+   */
+  virtual void addStream(uint64_t stream_id, UpstreamStreamCallbacks& callbacks) PURE;
+
+  virtual void removeStream(uint64_t stream_id) PURE;
 
   virtual bool isPoolReady() PURE;
 
@@ -43,6 +76,17 @@ public:
 
   virtual void removeUpsteamRequestCallbacks(UpstreamRequestCallbacks* callbacks) PURE;
 
+  /**
+   * @return true if the upstream connection is established and no request or stream is waiting for
+   * a response on it, so it can be closed without failing any request.
+   */
+  virtual bool idle() PURE;
+
+  /**
+   * Close the upstream connection, the handler removes itself from the UpstreamHandlerManager.
+   */
+  virtual void close() PURE;
+
   static absl::optional<Upstream::TcpPoolData>
   createTcpPoolData(Upstream::ThreadLocalCluster& thread_local_cluster,
                     Upstream::LoadBalancerContext& context);
@@ -55,6 +99,8 @@ public:
   void del(const std::string& key);
   std::shared_ptr<UpstreamHandler> get(const std::string& key);
   void clear();
+  // Close the idle upstream connections, return the number of connections closed.
+  uint32_t closeIdle();
 
 private:
   // key: clusterName or clusterName_address
@@ -20,6 +20,13 @@ void UpstreamHandlerImpl::onClose() {
 
   delete_callback_(key_);
 
+  // the streams remove themselves from the handler when they are reset
+  auto streams = std::move(streams_);
+  streams_.clear();
+  for (auto& [stream_id, callbacks] : streams) {
+    callbacks->onUpstreamReset();
+  }
+
   if (upstream_handle_) {
     ASSERT(!conn_data_);
     upstream_handle_->cancel(Tcp::ConnectionPool::CancelPolicy::Default);
@@ -51,12 +58,14 @@ void UpstreamHandlerImpl::onPoolFailure(ConnectionPool::PoolFailureReason reason
   upstream_handle_ = nullptr;
   delete_callback_(key_);
 
-  for (auto upstream_request_callbacks : upstream_request_callbacks_) {
-    if (upstream_request_callbacks) {
-      upstream_request_callbacks->onPoolFailure(reason, transport_failure_reason, host);
+  // the requests may remove their callbacks when they are notified
+  auto upstream_request_callbacks = std::move(upstream_request_callbacks_);
+  upstream_request_callbacks_.clear();
+  for (auto callbacks : upstream_request_callbacks) {
+    if (callbacks) {
+      callbacks->onPoolFailure(reason, transport_failure_reason, host);
     }
   }
-  upstream_request_callbacks_.clear();
 }
 
 void UpstreamHandlerImpl::onPoolReady(Tcp::ConnectionPool::ConnectionDataPtr&& conn_data,
@@ -70,12 +79,13 @@ void UpstreamHandlerImpl::onPoolReady(Tcp::ConnectionPool::ConnectionDataPtr&& c
 
   ENVOY_CONN_LOG(debug, "UpstreamHandlerImpl[{}]: upstream_request_callbacks_ size:{}",
                  conn_data_->connection(), key_, upstream_request_callbacks_.size());
-  for (auto upstream_request_callbacks : upstream_request_callbacks_) {
-    if (upstream_request_callbacks) {
-      upstream_request_callbacks->onPoolReady(host);
+  auto upstream_request_callbacks = std::move(upstream_request_callbacks_);
+  upstream_request_callbacks_.clear();
+  for (auto callbacks : upstream_request_callbacks) {
+    if (callbacks) {
+      callbacks->onPoolReady(host);
     }
   }
-  upstream_request_callbacks_.clear();
 }
 
 void UpstreamHandlerImpl::onData(Buffer::Instance& data, bool end_stream) {
@@ -86,16 +96,30 @@ void UpstreamHandlerImpl::onData(Buffer::Instance& data, bool end_stream) {
   conn_data_->connection().write(data, end_stream);
 }
 
-void UpstreamHandlerImpl::addResponseCallback(uint64_t request_id, ResponseCallback callback) {
+bool UpstreamHandlerImpl::addResponseCallback(uint64_t request_id, ResponseCallback callback) {
   auto it = response_callbacks_.find(request_id);
   if (it != response_callbacks_.end()) {
     // if exist
     ENVOY_LOG(error, "addResponseCallback failed, request_id:{} already exist", request_id);
-    return;
+    return false;
   }
   response_callbacks_.insert({request_id, callback});
+  return true;
+}
+
+void UpstreamHandlerImpl::removeResponseCallback(uint64_t request_id) {
+  response_callbacks_.erase(request_id);
 }
 
+void UpstreamHandlerImpl::addStream(uint64_t stream_id, UpstreamStreamCallbacks& callbacks) {
+  if (frame_decoder_ == nullptr) {
+    frame_decoder_ = codec_factory_.createDecoder();
+  }
+  streams_[stream_id] = &callbacks;
+}
+
+void UpstreamHandlerImpl::removeStream(uint64_t stream_id) { streams_.erase(stream_id); }
+
 bool UpstreamHandlerImpl::isPoolReady() { return pool_ready_; }
 
 void UpstreamHandlerImpl::addUpsteamRequestCallbacks(UpstreamRequestCallbacks* callbacks) {
@@ -108,35 +132,81 @@ void UpstreamHandlerImpl::removeUpsteamRequestCallbacks(UpstreamRequestCallbacks
                                     upstream_request_callbacks_.end());
 }
 
+bool UpstreamHandlerImpl::idle() {
+  return pool_ready_ && response_callbacks_.empty() && streams_.empty() &&
+         upstream_response_ == nullptr;
+}
+
+void UpstreamHandlerImpl::close() {
+  if (conn_data_ == nullptr) {
+    return;
+  }
+  ENVOY_CONN_LOG(debug, "UpstreamHandlerImpl[{}] close", conn_data_->connection(), key_);
+  // The close event calls onClose, which removes the handler from the manager.
+  conn_data_->connection().close(Network::ConnectionCloseType::NoFlush);
+}
+
 void UpstreamHandlerImpl::onUpstreamData(Buffer::Instance& data, bool end_stream) {
   ENVOY_LOG(debug, "UpstreamHandlerImpl[{}]: upstream callback length {} , end:{}", key_,
             data.length(), end_stream);
-  if (!upstream_response_) {
-    upstream_response_ = std::make_unique<UpstreamResponse>(config_, *this);
-    upstream_response_->startUpstreamResponse();
-  }
+  // The responses are decoded one at a time, and the frames of the streams are handed to their
+  // streams when they are at the head of the buffer.
+  while (data.length() > 0) {
+    if (upstream_response_ == nullptr && frame_decoder_ != nullptr) {
+      // A stream frame can only be told from a response once its header is complete, otherwise a
+      // stream frame split across reads would be decoded as a response. An invalid frame goes to
+      // the response decoder, which reports the error.
+      const uint64_t frame_length = frame_decoder_->frameLength(data);
+      if (frame_length > 0 && data.length() < frame_length) {
+        ENVOY_LOG(debug, "meta protocol upstream handler: frame needs more data");
+        return;
+      }
+      const absl::optional<uint64_t> stream_id =
+          frame_length > 0 ? frame_decoder_->streamId(data) : absl::nullopt;
+      if (stream_id.has_value()) {
+        dispatchStreamFrame(data, stream_id.value(), frame_length);
+        continue;
+      }
+    }
+    if (!upstream_response_) {
+      upstream_response_ = std::make_unique<UpstreamResponse>(codec_factory_, *this);
+      upstream_response_->startUpstreamResponse();
+    }
 
-  UpstreamResponseStatus status = upstream_response_->upstreamData(data);
-  switch (status) {
-  case UpstreamResponseStatus::Complete: {
-    ENVOY_LOG(debug, "meta protocol upstream handler: response complete");
-    upstream_response_.reset();
-    return;
-  }
-  case UpstreamResponseStatus::Reset: {
-    ENVOY_LOG(debug, "meta protocol upstream handler: upstream reset");
-    upstream_response_.reset();
-    return;
-  }
-  case UpstreamResponseStatus::MoreData: {
-    ENVOY_LOG(debug, "meta protocol upstream handler: need more data");
-    return;
+    UpstreamResponseStatus status = upstream_response_->upstreamData(data);
+    switch (status) {
+    case UpstreamResponseStatus::Complete: {
+      ENVOY_LOG(debug, "meta protocol upstream handler: response complete");
+      upstream_response_.reset();
+      break;
+    }
+    case UpstreamResponseStatus::Reset: {
+      ENVOY_LOG(debug, "meta protocol upstream handler: upstream reset");
+      upstream_response_.reset();
+      return;
+    }
+    case UpstreamResponseStatus::MoreData: {
+      ENVOY_LOG(debug, "meta protocol upstream handler: need more data");
+      return;
+    }
+    case UpstreamResponseStatus::Retry: {
+      ENVOY_LOG(debug, "meta protocol upstream handler: retry");
+      return;
+    }
+    }
   }
-  case UpstreamResponseStatus::Retry: {
-    ENVOY_LOG(debug, "meta protocol upstream handler: retry");
+}
+
+void UpstreamHandlerImpl::dispatchStreamFrame(Buffer::Instance& data, uint64_t stream_id,
+                                              uint64_t frame_length) {
+  Buffer::OwnedImpl frame;
+  frame.move(data, frame_length);
+  auto it = streams_.find(stream_id);
+  if (it == streams_.end()) {
+    ENVOY_LOG(debug, "UpstreamHandlerImpl[{}]: drop a frame of closed stream {}", key_, stream_id);
     return;
   }
-  }
+  it->second->onUpstreamFrame(frame);
 }
 
 void UpstreamHandlerImpl::onEvent(Envoy::Network::ConnectionEvent event) {
@@ -159,7 +229,9 @@ void UpstreamHandlerImpl::onEvent(Envoy::Network::ConnectionEvent event) {
 void UpstreamHandlerImpl::onMessageDecoded(MetadataSharedPtr metadata, MutationSharedPtr) {
   ASSERT(metadata->getMessageType() == MessageType::Response ||
          metadata->getMessageType() == MessageType::Error);
-  downstream_connection_.write(metadata->originMessage(), false);
+  if (downstream_connection_ != nullptr) {
+    downstream_connection_->write(metadata->originMessage(), false);
+  }
 
   // callback by request id
   uint64_t request_id = metadata->getRequestId();
@@ -7,6 +7,9 @@
 #include "envoy/upstream/thread_local_cluster.h"
 #include "envoy/upstream/load_balancer.h"
 #include "source/common/buffer/buffer_impl.h"
+
+#include "absl/container/flat_hash_map.h"
+
 #include "src/meta_protocol_proxy/upstream_response.h"
 #include "src/meta_protocol_proxy/upstream_handler.h"
 
@@ -21,19 +24,26 @@ class UpstreamHandlerImpl : public UpstreamHandler,
                             Logger::Loggable<Logger::Id::filter> {
 public:
   using DeleteCallbackType = std::function<void(const std::string&)>;
-  UpstreamHandlerImpl(const std::string& key, Network::Connection& connection, Config& config,
-                      DeleteCallbackType delete_callback)
-      : key_(key), downstream_connection_(connection), config_(config),
+  // The responses are written to the downstream connection, or discarded if it's nullptr, e.g. the
+  // responses of the mirrored requests.
+  UpstreamHandlerImpl(const std::string& key, Network::Connection* connection,
+                      CodecFactory& codec_factory, DeleteCallbackType delete_callback)
+      : key_(key), downstream_connection_(connection), codec_factory_(codec_factory),
         delete_callback_(delete_callback) {}
   ~UpstreamHandlerImpl() override;
 
   // UpstreamHandler
   int start(Upstream::TcpPoolData& pool_data) override;
   void onData(Buffer::Instance& data, bool end_stream) override;
-  void addResponseCallback(uint64_t request_id, ResponseCallback callback) override;
+  bool addResponseCallback(uint64_t request_id, ResponseCallback callback) override;
+  void removeResponseCallback(uint64_t request_id) override;
+  void addStream(uint64_t stream_id, UpstreamStreamCallbacks& callbacks) override;
+  void removeStream(uint64_t stream_id) override;
   bool isPoolReady() override;
   void addUpsteamRequestCallbacks(UpstreamRequestCallbacks* callbacks) override;
   void removeUpsteamRequestCallbacks(UpstreamRequestCallbacks* callbacks) override;
+  bool idle() override;
+  void close() override;
 
   // Tcp::ConnectionPool::Callbacks
   void onPoolFailure(ConnectionPool::PoolFailureReason reason,
@@ -53,11 +63,13 @@ public:
 
 private:
   void onClose();
+  // Hand the whole stream frame at the head of the buffer to its stream.
+  void dispatchStreamFrame(Buffer::Instance& data, uint64_t stream_id, uint64_t frame_length);
 
 private:
   std::string key_;
-  Network::Connection& downstream_connection_;
-  Config& config_;
+  Network::Connection* downstream_connection_;
+  CodecFactory& codec_factory_;
   DeleteCallbackType delete_callback_;
   Tcp::ConnectionPool::Cancellable* upstream_handle_{};
   Tcp::ConnectionPool::ConnectionDataPtr conn_data_;
@@ -67,6 +79,12 @@ private:
 
   // key: request id
   std::map<uint64_t, ResponseCallback> response_callbacks_;
+  // the streams multiplexed on the connection by stream id, the ids are unique as the handler is
+  // only shared by the requests of one downstream connection
+  absl::flat_hash_map<uint64_t, UpstreamStreamCallbacks*> streams_;
+  // peeks the frames of the streams, it's created with the first stream and kept afterwards to
+  // drop the late frames of the closed streams
+  ProtocolDecoderPtr frame_decoder_;
 
   UpstreamResponsePtr upstream_response_;
 
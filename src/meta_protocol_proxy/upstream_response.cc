@@ -14,7 +14,7 @@ void UpstreamHandlerResponseDecoder::onMessageDecoded(MetadataSharedPtr metadata
   ENVOY_LOG(debug,
             "meta protocol response decoder: complete processing of upstream response messages, id is {}",
             metadata->getRequestId());
-  codec_->encode(*metadata, *mutation, metadata->originMessage());
+  encoder_.encode(*metadata, *mutation, metadata->originMessage());
   handler_.onMessageDecoded(metadata, mutation);
 };
 
@@ -23,10 +23,11 @@ void UpstreamResponse::startUpstreamResponse() {
 
   ASSERT(response_decoder_ == nullptr);
 
-  CodecPtr codec = config_.createCodec();
+  ProtocolDecoderPtr protocol_decoder = codec_factory_.createDecoder();
 
   // Create a response message decoder.
-  response_decoder_ = std::make_unique<UpstreamHandlerResponseDecoder>(handler_, std::move(codec));
+  response_decoder_ = std::make_unique<UpstreamHandlerResponseDecoder>(
+      handler_, std::move(protocol_decoder), *codec_factory_.encoder());
 }
 
 UpstreamResponseStatus UpstreamResponse::upstreamData(Buffer::Instance& buffer) {
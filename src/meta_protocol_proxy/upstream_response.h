@@ -6,7 +6,6 @@
 #include "src/meta_protocol_proxy/decoder.h"
 #include "src/meta_protocol_proxy/decoder_event_handler.h"
 #include "src/meta_protocol_proxy/filters/filter.h"
-#include "src/meta_protocol_proxy/config_interface.h"
 
 namespace Envoy {
 namespace Extensions {
@@ -17,16 +16,21 @@ class UpstreamHandlerResponseDecoder : public ResponseDecoderCallbacks,
                                        public MessageHandler,
                                        Logger::Loggable<Logger::Id::filter> {
 public:
-  UpstreamHandlerResponseDecoder(MessageHandler& handler, CodecPtr codec)
-      : handler_(handler), codec_(std::move(codec)),
-        decoder_(std::make_unique<ResponseDecoder>(*codec_, *this)) {}
+  UpstreamHandlerResponseDecoder(MessageHandler& handler, ProtocolDecoderPtr protocol_decoder,
+                                 Encoder& encoder)
+      : handler_(handler), protocol_decoder_(std::move(protocol_decoder)),
+        encoder_(encoderFor(*protocol_decoder_, encoder)),
+        decoder_(std::make_unique<ResponseDecoder>(*protocol_decoder_, *this)), complete_(false) {}
 
   UpstreamResponseStatus decode(Buffer::Instance& data) {
     ENVOY_LOG(debug, "meta protocol response: the received reply data length is {}", data.length());
 
     bool underflow = false;
     try {
-      decoder_->onData(data, underflow);
+      if (!decoder_->onData(data, underflow)) {
+        ENVOY_LOG(error, "meta protocol error: {}", decoder_->errorDetail());
+        return UpstreamResponseStatus::Reset;
+      }
     } catch (const EnvoyException& ex) {
       ENVOY_LOG(error, "meta protocol error: {}", ex.what());
       return UpstreamResponseStatus::Reset;
@@ -53,7 +57,8 @@ public:
 
 private:
   MessageHandler& handler_;
-  CodecPtr codec_;
+  ProtocolDecoderPtr protocol_decoder_;
+  Encoder& encoder_;
   ResponseDecoderPtr decoder_;
   bool complete_ : 1;
 };
@@ -61,14 +66,15 @@ using UpstreamHandlerResponseDecoderPtr = std::unique_ptr<UpstreamHandlerRespons
 
 class UpstreamResponse : Logger::Loggable<Logger::Id::filter> {
 public:
-  UpstreamResponse(Config& config, MessageHandler& handler) : config_(config), handler_(handler) {}
+  UpstreamResponse(CodecFactory& codec_factory, MessageHandler& handler)
+      : codec_factory_(codec_factory), handler_(handler) {}
   ~UpstreamResponse() = default;
 
   void startUpstreamResponse();
   UpstreamResponseStatus upstreamData(Buffer::Instance& buffer);
 
 private:
-  Config& config_;
+  CodecFactory& codec_factory_;
   MessageHandler& handler_;
   UpstreamHandlerResponseDecoderPtr response_decoder_;
 };
@@ -11,4 +11,5 @@ $BASEDIR/../../bazel-bin/envoy -c $BASEDIR/test-only-global-token.yaml &
 #$BASEDIR/../../bazel-bin/envoy -c $BASEDIR/test-full-no-matched-condition.yaml &
 #$BASEDIR/../../bazel-bin/envoy -c $BASEDIR/test-no-global-bucket-match-condition.yaml &
 #$BASEDIR/../../bazel-bin/envoy -c $BASEDIR/test-no-global-bucket-no-matched-condition.yaml &
+#$BASEDIR/../../bazel-bin/envoy -c $BASEDIR/test-sharded-global-token.yaml &
 docker logs -f client